@@ -31,16 +31,71 @@
 #include "installer.h"
 #include "sfo.h"
 #include "zip_util.h"
+#include "remote_walker.h"
+#include "transfer_pool.h"
+#include "remote_copy.h"
+#include "parallel_zip.h"
+#include "archive_index.h"
+#include "extract_pipeline.h"
+#include "zip_upload.h"
+#include "progress_bus.h"
+#include "background_queue.h"
+#include "local_search.h"
 #include "sceSystemService.h"
 
 namespace Actions
 {
+    // Collects background downloads while a multi file download runs
+    static BackgroundQueue *background_queue = nullptr;
+    // Files queued as segments by QueueUpload, with the size they must end up at
+    static std::vector<std::pair<std::string, uint64_t>> segmented_uploads;
+
     static int FtpCallback(int64_t xfered, void *arg)
     {
         bytes_transfered = xfered;
         return 1;
     }
 
+    static int ConfirmOverwrite(const char *dest, bool is_remote)
+    {
+        bool exists = false;
+        if (overwrite_type != OVERWRITE_ALL)
+            exists = is_remote ? remoteclient->FileExists(dest) : FS::FileExists(dest);
+
+        if (overwrite_type == OVERWRITE_PROMPT && exists)
+        {
+            sprintf(confirm_message, "%s %s?", lang_strings[STR_OVERWRITE], dest);
+            confirm_state = CONFIRM_WAIT;
+            action_to_take = selected_action;
+            activity_inprogess = false;
+            while (confirm_state == CONFIRM_WAIT)
+            {
+                usleep(100000);
+            }
+            activity_inprogess = true;
+            selected_action = action_to_take;
+        }
+        else if (overwrite_type == OVERWRITE_NONE && exists)
+        {
+            confirm_state = CONFIRM_NO;
+        }
+        else
+        {
+            confirm_state = CONFIRM_YES;
+        }
+
+        return confirm_state;
+    }
+
+    static std::vector<DirEntry> ListRemoteDir(const std::string &path)
+    {
+        std::string inner;
+        std::shared_ptr<ArchiveIndex> index = ArchiveIndex::Find(remote_settings->site_name, path, &inner);
+        if (index != nullptr)
+            return index->ListDir(inner);
+        return remoteclient->ListDir(path);
+    }
+
     void RefreshLocalFiles(bool apply_filter)
     {
         multi_selected_local_files.clear();
@@ -84,7 +139,7 @@ namespace Actions
         remote_files.clear();
         if (strlen(remote_filter) > 0 && apply_filter)
         {
-            std::vector<DirEntry> temp_files = remoteclient->ListDir(remote_directory);
+            std::vector<DirEntry> temp_files = ListRemoteDir(remote_directory);
             std::string lower_filter = Util::ToLower(remote_filter);
             for (std::vector<DirEntry>::iterator it = temp_files.begin(); it != temp_files.end();)
             {
@@ -99,7 +154,7 @@ namespace Actions
         }
         else
         {
-            remote_files = remoteclient->ListDir(remote_directory);
+            remote_files = ListRemoteDir(remote_directory);
         }
         DirEntry::Sort(remote_files);
     }
@@ -139,7 +194,10 @@ namespace Actions
 
     void HandleChangeRemoteDirectory(const DirEntry entry)
     {
-        if (!entry.isDir)
+        // Archives open as folders, but not ones nested in another archive
+        bool open_archive = !entry.isDir && ArchiveIndex::IsArchive(entry.name) &&
+                            ArchiveIndex::Find(remote_settings->site_name, entry.path) == nullptr;
+        if (!entry.isDir && !open_archive)
             return;
 
         if (!remoteclient->Ping())
@@ -149,6 +207,13 @@ namespace Actions
             return;
         }
 
+        if (open_archive && ArchiveIndex::Open(remote_settings->site_name, remoteclient, entry) == nullptr)
+        {
+            sprintf(status_message, "%s %s", lang_strings[STR_FAILED], entry.name);
+            selected_action = ACTION_NONE;
+            return;
+        }
+
         if (strcmp(entry.name, "..") == 0)
         {
             std::string temp_path = std::string(entry.directory);
@@ -289,6 +354,46 @@ namespace Actions
         }
     }
 
+    int DeleteRemotePath(const DirEntry &src)
+    {
+        RemoteWalker walker(remote_settings, remoteclient, MIN(remote_settings->transfer_sessions, REMOTE_WALKER_MAX_SESSIONS));
+        walker.Start(src.path, src.path);
+
+        WalkItem item;
+        while (walker.Next(&item))
+        {
+            if (stop_activity)
+                return 1;
+
+            if (item.isDir)
+                continue;
+
+            snprintf(activity_message, 1024, "%s %s", lang_strings[STR_DELETING], item.path.c_str());
+            if (!remoteclient->Delete(item.path))
+            {
+                sprintf(status_message, "%s %s", lang_strings[STR_FAIL_DEL_FILE_MSG], item.path.c_str());
+                return 0;
+            }
+        }
+
+        if (stop_activity)
+            return 1;
+
+        // Folders come out parents first, so remove them in reverse
+        std::vector<std::string> dirs = walker.Directories();
+        for (int i = dirs.size() - 1; i >= 0; i--)
+        {
+            snprintf(activity_message, 1024, "%s %s", lang_strings[STR_DELETING], dirs[i].c_str());
+            if (!remoteclient->Rmdir(dirs[i], false))
+            {
+                sprintf(status_message, "%s %s", lang_strings[STR_FAIL_DEL_DIR_MSG], dirs[i].c_str());
+                return 0;
+            }
+        }
+
+        return 1;
+    }
+
     void *DeleteSelectedRemotesFilesThread(void *argp)
     {
         if (remoteclient->Ping())
@@ -302,7 +407,7 @@ namespace Actions
             for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end(); ++it)
             {
                 if (it->isDir)
-                    remoteclient->Rmdir(it->path, true);
+                    DeleteRemotePath(*it);
                 else
                 {
                     sprintf(activity_message, "%s %s", lang_strings[STR_DELETING], it->path);
@@ -334,6 +439,48 @@ namespace Actions
         }
     }
 
+    /*
+     * Splits a large upload into fixed size segments queued as ranged jobs of the pool,
+     * they are written in place over several sessions.
+     */
+    static int QueueSegments(TransferPool *pool, const char *src, const char *dest, uint64_t file_size)
+    {
+        // Start from an empty file, the segments never truncate it
+        if (remoteclient->FileExists(dest) && !remoteclient->Delete(dest))
+            return 0;
+        if (!remoteclient->PutRange(src, dest, 0, 0))
+            return 0;
+
+        for (uint64_t offset = 0; offset < file_size; offset += SEGMENTED_UPLOAD_CHUNK_SIZE)
+        {
+            pool->AddRange(src, dest, offset, MIN(SEGMENTED_UPLOAD_CHUNK_SIZE, file_size - offset));
+        }
+        return 1;
+    }
+
+    static int CheckUploadSize(const char *dest, uint64_t file_size)
+    {
+        uint64_t remote_size = 0;
+        return remoteclient->Size(dest, &remote_size) && remote_size == file_size;
+    }
+
+    /*
+     * Uploads one large file in segments, then checks the remote size against the local one.
+     */
+    static int SegmentedUpload(const char *src, const char *dest, uint64_t file_size)
+    {
+        TransferPool pool(remote_settings, remoteclient, TRANSFER_UPLOAD, remote_settings->transfer_sessions, TRANSFER_ORDER_LISTED);
+        if (!pool.Start())
+            return remoteclient->Put(src, dest);
+
+        if (!QueueSegments(&pool, src, dest, file_size))
+            return 0;
+        if (!pool.Wait() || stop_activity)
+            return 0;
+
+        return CheckUploadSize(dest, file_size);
+    }
+
     int UploadFile(const char *src, const char *dest)
     {
         int ret;
@@ -369,6 +516,9 @@ namespace Actions
         if (confirm_state == CONFIRM_YES)
         {
             prev_tick = Util::GetTick();
+            uint64_t file_size = FS::GetSize(src);
+            if (remote_settings->transfer_sessions > 1 && file_size >= SEGMENTED_UPLOAD_MIN_SIZE && remoteclient->SupportsRangeWrite())
+                return SegmentedUpload(src, dest, file_size);
             return remoteclient->Put(src, dest);
         }
 
@@ -445,6 +595,59 @@ namespace Actions
         return 1;
     }
 
+    /*
+     * Large files go in as segments when the site can write ranges, their sizes are
+     * checked once the pool is done. Everything else is one whole-file job.
+     */
+    static void QueueUploadFile(TransferPool *pool, const char *src, const std::string &dest, uint64_t file_size)
+    {
+        if (file_size >= SEGMENTED_UPLOAD_MIN_SIZE && remoteclient->SupportsRangeWrite() &&
+            QueueSegments(pool, src, dest.c_str(), file_size))
+        {
+            segmented_uploads.push_back(std::make_pair(dest, file_size));
+            return;
+        }
+        pool->Add(src, dest, file_size);
+    }
+
+    int QueueUpload(TransferPool *pool, const DirEntry &src, const char *dest)
+    {
+        if (stop_activity)
+            return 1;
+
+        if (src.isDir)
+        {
+            int err;
+            std::vector<DirEntry> entries = FS::ListDir(src.path, &err);
+            remoteclient->Mkdir(dest);
+            for (int i = 0; i < entries.size(); i++)
+            {
+                if (stop_activity)
+                    return 1;
+
+                if (strcmp(entries[i].name, "..") == 0)
+                    continue;
+
+                std::string new_path = std::string(dest) + (FS::hasEndSlash(dest) ? "" : "/") + entries[i].name;
+                if (entries[i].isDir)
+                {
+                    QueueUpload(pool, entries[i], new_path.c_str());
+                }
+                else if (ConfirmOverwrite(new_path.c_str(), true) == CONFIRM_YES)
+                {
+                    QueueUploadFile(pool, entries[i].path, new_path, entries[i].file_size);
+                }
+            }
+        }
+        else
+        {
+            std::string new_path = std::string(dest) + (FS::hasEndSlash(dest) ? "" : "/") + src.name;
+            if (ConfirmOverwrite(new_path.c_str(), true) == CONFIRM_YES)
+                QueueUploadFile(pool, src.path, new_path, src.file_size);
+        }
+        return 1;
+    }
+
     void *UploadFilesThread(void *argp)
     {
         file_transfering = true;
@@ -454,19 +657,49 @@ namespace Actions
         else
             files.push_back(selected_local_file);
 
+        TransferPool *pool = nullptr;
+        if (remote_settings->transfer_sessions > 1 && (files.size() > 1 || files[0].isDir))
+        {
+            pool = new TransferPool(remote_settings, remoteclient, TRANSFER_UPLOAD, remote_settings->transfer_sessions, transfer_order);
+            if (!pool->Start())
+            {
+                delete pool;
+                pool = nullptr;
+            }
+            prev_tick = Util::GetTick();
+        }
+
         for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end(); ++it)
         {
             if (it->isDir)
             {
                 char new_dir[512];
                 sprintf(new_dir, "%s%s%s", remote_directory, FS::hasEndSlash(remote_directory) ? "" : "/", it->name);
-                Upload(*it, new_dir);
+                if (pool != nullptr)
+                    QueueUpload(pool, *it, new_dir);
+                else
+                    Upload(*it, new_dir);
             }
             else
             {
-                Upload(*it, remote_directory);
+                if (pool != nullptr)
+                    QueueUpload(pool, *it, remote_directory);
+                else
+                    Upload(*it, remote_directory);
             }
         }
+
+        if (pool != nullptr)
+        {
+            pool->Wait();
+            delete pool;
+        }
+        for (std::vector<std::pair<std::string, uint64_t>>::iterator it = segmented_uploads.begin(); it != segmented_uploads.end(); ++it)
+        {
+            if (!stop_activity && !CheckUploadSize(it->first.c_str(), it->second))
+                sprintf(status_message, "%s %s", lang_strings[STR_FAIL_UPLOAD_MSG], it->first.c_str());
+        }
+        segmented_uploads.clear();
         activity_inprogess = false;
         file_transfering = false;
         multi_selected_local_files.clear();
@@ -489,48 +722,28 @@ namespace Actions
         }
     }
 
+    /*
+     * Hands a download to the ezremote server. While a download of several
+     * files runs, jobs collect in its queue and go out in batches.
+     */
     int BackgroundDownload(const char* src, const char *dest, uint64_t file_size)
     {
-        uint64_t id = Util::GetTick();
-        json_object *params = json_object_new_object();
-		json_object_object_add(params, "type", json_object_new_int(remote_settings->type));
-		json_object_object_add(params, "url", json_object_new_string(remote_settings->server));
-		json_object_object_add(params, "username", json_object_new_string(remote_settings->username));
-		json_object_object_add(params, "password", json_object_new_string(remote_settings->password));
-        json_object_object_add(params, "src_path", json_object_new_string(src));
-        json_object_object_add(params, "dest_path", json_object_new_string(dest));
-        json_object_object_add(params, "size", json_object_new_uint64(file_size));
-        json_object_object_add(params, "id", json_object_new_uint64(id));
-		if (remote_settings->type == CLIENT_TYPE_HTTP_SERVER)
-		{
-			json_object_object_add(params, "http_server_type", json_object_new_string(remote_settings->http_server_type));
-		}
+        if (background_queue != nullptr)
+            return background_queue->Add(src, dest, file_size);
 
-        const char *params_str = json_object_to_json_string(params);
-
-		CHTTPClient::HttpResponse res;
-		CHTTPClient::HeadersMap headers;
-		CHTTPClient tmp_client([](const std::string& log){});
-		tmp_client.InitSession(true, CHTTPClient::SettingsFlag::NO_FLAGS);
-		tmp_client.SetCertificateFile(CACERT_FILE);
-		headers["Content-Type"] = "application/json";
-
-		std::string download_url = std::string("http://localhost:") + std::to_string(http_int_server_port) + "/download_url";
-		if (tmp_client.Post(download_url, headers, params_str, res))
-		{
-			if (HTTP_SUCCESS(res.iCode))
-			{
-                Util::RichNotify(id, "%s queued for download", src);
-                return 1;
-	  		}
-			else
-			{
-                Util::RichNotify(id, "Failed to queue %s for download in background", src);
-				return 0;
-			}
-		}
+        BackgroundQueue queue(remote_settings);
+        queue.Add(src, dest, file_size);
+        return queue.Finish();
+    }
 
-        return 0;
+    /*
+     * Moves a finished file from the per-file counter into the overall one. The
+     * per-file bytes are cleared first so the overall bar never counts them twice.
+     */
+    static void FileTransfered(uint64_t size)
+    {
+        bytes_transfered = 0;
+        total_bytes_transfered += size;
     }
 
     int DownloadFile(const char *src, const char *dest)
@@ -581,52 +794,88 @@ namespace Actions
         return 1;
     }
 
+    /*
+     * Downloads a file or folder from inside a remote archive, fetching only the
+     * entries involved.
+     */
+    static int DownloadFromArchive(std::shared_ptr<ArchiveIndex> index, const DirEntry &src, const std::string &inner, const char *dest)
+    {
+        std::vector<ArchiveIndexEntry> files;
+        std::string base;
+        if (src.isDir)
+        {
+            files = index->ListFiles(inner);
+            base = inner.empty() ? "" : inner + "/";
+        }
+        else
+        {
+            ArchiveIndexEntry entry;
+            entry.name = inner;
+            entry.size = src.file_size;
+            files.push_back(entry);
+            size_t slash_pos = inner.find_last_of("/");
+            base = slash_pos == std::string::npos ? "" : inner.substr(0, slash_pos + 1);
+        }
+
+        for (int i = 0; i < files.size(); i++)
+        {
+            if (stop_activity)
+                return 1;
+
+            std::string new_path = std::string(dest) + (FS::hasEndSlash(dest) ? "" : "/") + files[i].name.substr(base.length());
+            FS::MkDirs(new_path, true);
+            snprintf(activity_message, 1024, "%s %s/%s", lang_strings[STR_DOWNLOADING], index->Path().c_str(), files[i].name.c_str());
+            total_bytes_to_transfer += files[i].size;
+            if (ConfirmOverwrite(new_path.c_str(), false) == CONFIRM_YES && !index->Extract(remoteclient, files[i].name, new_path))
+            {
+                sprintf(status_message, "%s %s/%s", lang_strings[STR_FAIL_DOWNLOAD_MSG], index->Path().c_str(), files[i].name.c_str());
+                return 0;
+            }
+            FileTransfered(files[i].size);
+        }
+        return 1;
+    }
+
     int Download(const DirEntry &src, const char *dest)
     {
         if (stop_activity)
             return 1;
 
+        std::string inner;
+        std::shared_ptr<ArchiveIndex> index = ArchiveIndex::Find(remote_settings->site_name, src.path, &inner);
+        if (index != nullptr)
+            return DownloadFromArchive(index, src, inner, dest);
+
         int ret;
         if (src.isDir)
         {
-            int err;
-            std::vector<DirEntry> entries = remoteclient->ListDir(src.path);
-            FS::MkDirs(dest);
-            for (int i = 0; i < entries.size(); i++)
+            uint64_t total_before = total_bytes_to_transfer;
+            RemoteWalker walker(remote_settings, remoteclient, MIN(remote_settings->transfer_sessions, REMOTE_WALKER_MAX_SESSIONS));
+            walker.Start(src.path, dest);
+
+            WalkItem item;
+            while (walker.Next(&item))
             {
                 if (stop_activity)
                     return 1;
 
-                int path_length = strlen(dest) + strlen(entries[i].name) + 2;
-                char *new_path = (char *)malloc(path_length);
-                snprintf(new_path, path_length, "%s%s%s", dest, FS::hasEndSlash(dest) ? "" : "/", entries[i].name);
-
-                if (entries[i].isDir)
+                if (item.isDir)
                 {
-                    if (strcmp(entries[i].name, "..") == 0)
-                        continue;
-
-                    FS::MkDirs(new_path);
-                    ret = Download(entries[i], new_path);
-                    if (ret <= 0)
-                    {
-                        free(new_path);
-                        return ret;
-                    }
+                    FS::MkDirs(item.dest);
+                    continue;
                 }
-                else
+
+                total_bytes_to_transfer = total_before + walker.TotalBytes();
+                snprintf(activity_message, 1024, "%s %s", lang_strings[STR_DOWNLOADING], item.path.c_str());
+                ret = DownloadFile(item.path.c_str(), item.dest.c_str());
+                if (ret <= 0)
                 {
-                    snprintf(activity_message, 1024, "%s %s", lang_strings[STR_DOWNLOADING], entries[i].path);
-                    ret = DownloadFile(entries[i].path, new_path);
-                    if (ret <= 0)
-                    {
-                        sprintf(status_message, "%s %s", lang_strings[STR_FAIL_DOWNLOAD_MSG], entries[i].path);
-                        free(new_path);
-                        return ret;
-                    }
+                    sprintf(status_message, "%s %s", lang_strings[STR_FAIL_DOWNLOAD_MSG], item.path.c_str());
+                    return ret;
                 }
-                free(new_path);
+                FileTransfered(item.size);
             }
+            total_bytes_to_transfer = total_before + walker.TotalBytes();
         }
         else
         {
@@ -634,6 +883,7 @@ namespace Actions
             char *new_path = (char *)malloc(path_length);
             snprintf(new_path, path_length, "%s%s%s", dest, FS::hasEndSlash(dest) ? "" : "/", src.name);
             snprintf(activity_message, 1024, "%s %s", lang_strings[STR_DOWNLOADING], src.path);
+            total_bytes_to_transfer += src.file_size;
             ret = DownloadFile(src.path, new_path);
             if (ret <= 0)
             {
@@ -641,35 +891,116 @@ namespace Actions
                 sprintf(status_message, "%s %s", lang_strings[STR_FAIL_DOWNLOAD_MSG], src.path);
                 return 0;
             }
+            FileTransfered(src.file_size);
             free(new_path);
         }
         return 1;
     }
 
+    static void QueueDownloadFile(TransferPool *pool, const std::string &src, const std::string &dest, uint64_t file_size)
+    {
+        if (ConfirmOverwrite(dest.c_str(), false) != CONFIRM_YES)
+            return;
+
+        if (enable_background_download && file_size > minimum_backgrond_file_size)
+            BackgroundDownload(src.c_str(), dest.c_str(), file_size);
+        else
+            pool->Add(src, dest, file_size);
+    }
+
+    int QueueDownload(TransferPool *pool, const DirEntry &src, const char *dest)
+    {
+        if (stop_activity)
+            return 1;
+
+        if (src.isDir)
+        {
+            RemoteWalker walker(remote_settings, remoteclient, MIN(remote_settings->transfer_sessions, REMOTE_WALKER_MAX_SESSIONS));
+            walker.Start(src.path, dest);
+
+            WalkItem item;
+            while (walker.Next(&item))
+            {
+                if (stop_activity)
+                    return 1;
+
+                if (item.isDir)
+                    FS::MkDirs(item.dest);
+                else
+                    QueueDownloadFile(pool, item.path, item.dest, item.size);
+            }
+        }
+        else
+        {
+            std::string new_path = std::string(dest) + (FS::hasEndSlash(dest) ? "" : "/") + src.name;
+            QueueDownloadFile(pool, src.path, new_path, src.file_size);
+        }
+        return 1;
+    }
+
     void *DownloadFilesThread(void *argp)
     {
         file_transfering = true;
+        total_bytes_to_transfer = 0;
+        total_bytes_transfered = 0;
         std::vector<DirEntry> files;
         if (multi_selected_remote_files.size() > 0)
             std::copy(multi_selected_remote_files.begin(), multi_selected_remote_files.end(), std::back_inserter(files));
         else
             files.push_back(selected_remote_file);
 
+        if (enable_background_download)
+            background_queue = new BackgroundQueue(remote_settings);
+
+        TransferPool *pool = nullptr;
+        if (remote_settings->transfer_sessions > 1 && (files.size() > 1 || files[0].isDir) &&
+            ArchiveIndex::Find(remote_settings->site_name, remote_directory) == nullptr)
+        {
+            pool = new TransferPool(remote_settings, remoteclient, TRANSFER_DOWNLOAD, remote_settings->transfer_sessions, transfer_order);
+            if (!pool->Start())
+            {
+                delete pool;
+                pool = nullptr;
+            }
+            prev_tick = Util::GetTick();
+        }
+
         for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end(); ++it)
         {
             if (it->isDir)
             {
                 char new_dir[512];
                 sprintf(new_dir, "%s%s%s", local_directory, FS::hasEndSlash(local_directory) ? "" : "/", it->name);
-                Download(*it, new_dir);
+                if (pool != nullptr)
+                    QueueDownload(pool, *it, new_dir);
+                else
+                    Download(*it, new_dir);
             }
             else
             {
-                Download(*it, local_directory);
+                if (pool != nullptr)
+                    QueueDownload(pool, *it, local_directory);
+                else
+                    Download(*it, local_directory);
             }
         }
 
+        if (pool != nullptr)
+        {
+            pool->Wait();
+            delete pool;
+        }
+
+        if (background_queue != nullptr)
+        {
+            background_queue->Finish();
+            delete background_queue;
+            background_queue = nullptr;
+        }
+
         file_transfering = false;
+        total_bytes_to_transfer = 0;
+        total_bytes_transfered = 0;
         activity_inprogess = false;
         multi_selected_remote_files.clear();
         Windows::SetModalMode(false);
@@ -691,6 +1022,83 @@ namespace Actions
         }
     }
 
+    /*
+     * Installs the packages of a remote zip straight from their byte range in the
+     * archive when every one of them is STORED, no local copy is written.
+     * Returns -1 when the archive has to be extracted instead.
+     */
+    static int InstallStoredArchivePkgs(const DirEntry &archive)
+    {
+        std::shared_ptr<ArchiveIndex> index = ArchiveIndex::Open(remote_settings->site_name, remoteclient, archive);
+        if (index == nullptr)
+            return -1;
+
+        std::vector<ArchiveIndexEntry> pkgs;
+        std::vector<ArchiveIndexEntry> files = index->ListFiles("");
+        for (std::vector<ArchiveIndexEntry>::iterator it = files.begin(); it != files.end(); ++it)
+        {
+            if (!Util::EndsWith(Util::ToLower(it->name), ".pkg"))
+                continue;
+            if (!index->IsStored(*it))
+                return -1;
+            pkgs.push_back(*it);
+        }
+        if (pkgs.empty())
+            return -1;
+
+        int installed = 0;
+        for (std::vector<ArchiveIndexEntry>::iterator it = pkgs.begin(); it != pkgs.end(); ++it)
+        {
+            if (stop_activity)
+                break;
+            snprintf(activity_message, 1023, "%s %s", lang_strings[STR_INSTALLING], it->name.c_str());
+
+            uint64_t data_offset;
+            if (!index->DataOffset(remoteclient, *it, &data_offset))
+                continue;
+
+            ArchivePkgInstallData *install_data = new ArchivePkgInstallData();
+
+            install_data->remote_client = INSTALLER::GetRemoteClient(remote_settings);
+            if (install_data->remote_client == nullptr)
+            {
+                delete install_data;
+                continue;
+            }
+            install_data->direct = true;
+            install_data->path = archive.path;
+            install_data->data_offset = data_offset;
+            install_data->size = it->size;
+            pthread_mutex_init(&install_data->client_lock, NULL);
+
+            if (INSTALLER::InstallArchivePkg(std::string(archive.path) + "/" + it->name, install_data))
+                installed++;
+        }
+
+        return installed;
+    }
+
+    /*
+     * Per item jobs of the install and extract loops on the ProgressBus. The bytes of
+     * the item in flight are still only published through the activity, job 0.
+     */
+    static uint32_t BeginItemJob(const char *kind, const DirEntry &item)
+    {
+        uint32_t job_id = ProgressBus::Begin(kind, item.path, item.file_size);
+        ProgressBus::Update(job_id, 0, item.file_size);
+        return job_id;
+    }
+
+    static void EndItemJob(uint32_t &job_id, uint64_t total, bool failed)
+    {
+        if (job_id == 0)
+            return;
+        if (!failed)
+            ProgressBus::Update(job_id, total, total);
+        ProgressBus::End(job_id, failed ? STATE_FAILED : STATE_SUCCESS);
+        job_id = 0;
+    }
+
     void *InstallRemotePkgsThread(void *argp)
     {
         int failed = 0;
@@ -703,11 +1111,18 @@ namespace Actions
         else
             files.push_back(selected_remote_file);
 
+        uint32_t job_id = 0;
+        uint64_t job_total = 0;
+        int failed_before = 0;
         for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end(); ++it)
         {
+            EndItemJob(job_id, job_total, failed > failed_before);
             if (stop_activity)
                 break;
             sprintf(activity_message, "%s %s", lang_strings[STR_INSTALLING], it->name);
+            job_id = BeginItemJob("install", *it);
+            job_total = it->file_size;
+            failed_before = failed;
 
             if (!it->isDir)
             {
@@ -779,6 +1194,18 @@ namespace Actions
                 else if (Util::EndsWith(path,".zip") || Util::EndsWith(path,".rar") || Util::EndsWith(path,".7z") ||
                         Util::EndsWith(path,".tar.xz") || Util::EndsWith(path,".tar.gz"))
                 {
+                    int direct = Util::EndsWith(path, ".zip") ? InstallStoredArchivePkgs(*it) : -1;
+                    if (direct > 0)
+                    {
+                        success++;
+                        continue;
+                    }
+                    else if (direct == 0)
+                    {
+                        failed++;
+                        continue;
+                    }
+
                     ArchiveEntry *entry = ZipUtil::GetPackageEntry(it->path, remoteclient);
                     if (entry != nullptr)
                     {
@@ -786,8 +1213,7 @@ namespace Actions
                         {
                             snprintf(activity_message, 1023, "%s %s", lang_strings[STR_INSTALLING], entry->filename.c_str());
 
-                            ArchivePkgInstallData *install_data = (ArchivePkgInstallData*) malloc(sizeof(ArchivePkgInstallData));
-                            memset(install_data, 0, sizeof(ArchivePkgInstallData));
+                            ArchivePkgInstallData *install_data = new ArchivePkgInstallData();
 
                             std::string install_pkg_path = std::string(temp_folder) + "/" + entry->filename;
                             SplitFile *sp = new SplitFile(install_pkg_path, INSTALL_ARCHIVE_PKG_SPLIT_SIZE);
@@ -819,6 +1245,7 @@ namespace Actions
                     lang_strings[STR_INSTALL_SUCCESS], success, lang_strings[STR_INSTALL_FAILED], failed,
                     lang_strings[STR_INSTALL_SKIPPED], skipped);
         }
+        EndItemJob(job_id, job_total, failed > failed_before || stop_activity);
     finish:
         activity_inprogess = false;
         multi_selected_remote_files.clear();
@@ -899,11 +1326,18 @@ namespace Actions
         else
             files.push_back(selected_local_file);
 
+        uint32_t job_id = 0;
+        uint64_t job_total = 0;
+        int failed_before = 0;
         for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end(); ++it)
         {
+            EndItemJob(job_id, job_total, failed > failed_before);
             if (stop_activity)
                 break;
             sprintf(activity_message, "%s %s", lang_strings[STR_INSTALLING], it->name);
+            job_id = BeginItemJob("install", *it);
+            job_total = it->file_size;
+            failed_before = failed;
 
             if (!it->isDir)
             {
@@ -948,8 +1382,7 @@ namespace Actions
                     {
                         while (entry != nullptr)
                         {
-                            ArchivePkgInstallData *install_data = (ArchivePkgInstallData*) malloc(sizeof(ArchivePkgInstallData));
-                            memset(install_data, 0, sizeof(ArchivePkgInstallData));
+                            ArchivePkgInstallData *install_data = new ArchivePkgInstallData();
 
                             std::string install_pkg_path = std::string(temp_folder) + "/" + entry->filename;
                             SplitFile *sp = new SplitFile(install_pkg_path, INSTALL_ARCHIVE_PKG_SPLIT_SIZE);
@@ -981,6 +1414,7 @@ namespace Actions
                     lang_strings[STR_INSTALL_SUCCESS], success, lang_strings[STR_INSTALL_FAILED], failed,
                     lang_strings[STR_INSTALL_SKIPPED], skipped);
         }
+        EndItemJob(job_id, job_total, failed > failed_before || stop_activity);
         activity_inprogess = false;
         multi_selected_local_files.clear();
         Windows::SetModalMode(false);
@@ -1008,20 +1442,27 @@ namespace Actions
         else
             files.push_back(selected_local_file);
 
+        ExtractPipeline::ResetTotals();
+        bool failed = false;
         for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end(); ++it)
         {
             if (stop_activity)
                 break;
             if (!it->isDir)
             {
+                uint32_t job_id = BeginItemJob("extract", *it);
                 int ret = ZipUtil::Extract(*it, extract_zip_folder);
+                EndItemJob(job_id, it->file_size, ret == 0);
                 if (ret == 0)
                 {
                     sprintf(status_message, "%s %s", lang_strings[STR_FAILED_TO_EXTRACT], it->name);
+                    failed = true;
                     usleep(100000);
                 }
             }
         }
+        if (!failed)
+            snprintf(status_message, 1024, "%s", ExtractPipeline::Summary().c_str());
         activity_inprogess = false;
         multi_selected_local_files.clear();
         Windows::SetModalMode(false);
@@ -1051,20 +1492,28 @@ namespace Actions
         else
             files.push_back(selected_remote_file);
 
+        ArchivePrefetch::ResetTotals();
+        ExtractPipeline::ResetTotals();
+        bool failed = false;
         for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end(); ++it)
         {
             if (stop_activity)
                 break;
             if (!it->isDir)
             {
+                uint32_t job_id = BeginItemJob("extract", *it);
                 int ret = ZipUtil::Extract(*it, extract_zip_folder, remoteclient);
+                EndItemJob(job_id, it->file_size, ret == 0);
                 if (ret == 0)
                 {
                     sprintf(status_message, "%s %s", lang_strings[STR_FAILED_TO_EXTRACT], it->name);
+                    failed = true;
                     usleep(100000);
                 }
             }
         }
+        if (!failed)
+            snprintf(status_message, 1024, "%s, %s", ArchivePrefetch::Summary().c_str(), ExtractPipeline::Summary().c_str());
         activity_inprogess = false;
         multi_selected_remote_files.clear();
         Windows::SetModalMode(false);
@@ -1096,17 +1545,22 @@ namespace Actions
             else
                 files.push_back(selected_local_file);
 
+            ParallelZip pz(zf, Z_DEFAULT_COMPRESSION);
             for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end(); ++it)
             {
                 if (stop_activity)
                     break;
-                int res = ZipUtil::ZipAddPath(zf, it->path, strlen(local_directory) + 1, Z_DEFAULT_COMPRESSION);
+                int res = pz.AddPath(it->path, strlen(local_directory) + 1);
                 if (res <= 0)
                 {
                     sprintf(status_message, "%s", lang_strings[STR_ERROR_CREATE_ZIP]);
                     usleep(1000000);
                 }
             }
+            if (!pz.Finish())
+                sprintf(status_message, "%s", lang_strings[STR_ERROR_CREATE_ZIP]);
+            else if (strlen(status_message) == 0)
+                snprintf(status_message, 1024, "%s", pz.Summary().c_str());
             zipClose(zf, NULL);
         }
         else
@@ -1133,6 +1587,103 @@ namespace Actions
         }
     }
 
+    static std::string local_search_pattern;
+    static std::vector<DirEntry> local_search_results;
+
+    /*
+     * Searches names and contents of the files under the local folder, the
+     * matching files are shown in place of the folder once it is done.
+     */
+    void *SearchLocalFilesThread(void *argp)
+    {
+        SearchQuery query;
+        query.root = local_directory;
+        query.pattern = local_search_pattern;
+        query.contents = true;
+        query.ignore_case = true;
+        query.limit = LOCAL_SEARCH_DEFAULT_LIMIT;
+
+        std::string prefix = std::string(local_directory) + (FS::hasEndSlash(local_directory) ? "" : "/");
+        std::set<std::string> seen;
+        std::vector<DirEntry> results;
+        LocalSearch search(query);
+        if (search.Start())
+        {
+            SearchMatch match;
+            int ret;
+            while ((ret = search.Next(match, 100)) != 0)
+            {
+                if (stop_activity)
+                    search.Stop();
+                if (ret < 0 || !seen.insert(match.path).second)
+                    continue;
+
+                DirEntry entry;
+                memset(&entry, 0, sizeof(DirEntry));
+                snprintf(entry.directory, 512, "%s", local_directory);
+                std::string name = match.path.compare(0, prefix.length(), prefix) == 0 ? match.path.substr(prefix.length()) : match.path;
+                snprintf(entry.name, 256, "%s", name.c_str());
+                snprintf(entry.path, 768, "%s", match.path.c_str());
+                entry.isDir = match.is_dir;
+                entry.file_size = match.size;
+                entry.selectable = true;
+                struct tm tm;
+                localtime_r(&match.modified, &tm);
+                entry.modified.day = tm.tm_mday;
+                entry.modified.month = tm.tm_mon + 1;
+                entry.modified.year = tm.tm_year + 1900;
+                entry.modified.hours = tm.tm_hour;
+                entry.modified.minutes = tm.tm_min;
+                entry.modified.seconds = tm.tm_sec;
+                if (entry.isDir)
+                    sprintf(entry.display_size, "%s", lang_strings[STR_FOLDER]);
+                else
+                    DirEntry::SetDisplaySize(&entry);
+                results.push_back(entry);
+
+                snprintf(activity_message, 1024, "%s %s (%lu)", lang_strings[STR_SEARCHING], local_search_pattern.c_str(), results.size());
+            }
+        }
+
+        if (results.size() > 0)
+            DirEntry::Sort(results);
+
+        // The same way up as the listing of the folder searched
+        DirEntry up;
+        memset(&up, 0, sizeof(DirEntry));
+        snprintf(up.directory, 512, "%s", local_directory);
+        sprintf(up.name, "..");
+        sprintf(up.display_size, "%s", lang_strings[STR_FOLDER]);
+        snprintf(up.path, 768, "%s", local_directory);
+        up.file_size = 0;
+        up.isDir = true;
+        up.selectable = false;
+        results.insert(results.begin(), up);
+        local_search_results = results;
+        activity_inprogess = false;
+        Windows::SetModalMode(false);
+        selected_action = ACTION_SHOW_LOCAL_SEARCH_RESULTS;
+        return NULL;
+    }
+
+    void SearchLocalFiles(const char *pattern)
+    {
+        local_search_pattern = pattern;
+        int res = pthread_create(&bk_activity_thid, NULL, SearchLocalFilesThread, NULL);
+        if (res != 0)
+        {
+            activity_inprogess = false;
+            Windows::SetModalMode(false);
+        }
+    }
+
+    void ShowLocalSearchResults()
+    {
+        multi_selected_local_files.clear();
+        local_files = local_search_results;
+        local_search_results.clear();
+    }
+
     void *InstallLocalUrlPkgThread(void *argp)
     {
         bytes_transfered = 0;
@@ -1562,6 +2113,56 @@ namespace Actions
         return 1;
     }
 
+    void *UploadZipThread(void *argp)
+    {
+        file_transfering = true;
+        std::vector<DirEntry> files;
+        if (multi_selected_local_files.size() > 0)
+            std::copy(multi_selected_local_files.begin(), multi_selected_local_files.end(), std::back_inserter(files));
+        else
+            files.push_back(selected_local_file);
+
+        ZipUpload upload(remoteclient);
+        bool added = true;
+        for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end(); ++it)
+        {
+            if (upload.AddPath(it->path, strlen(local_directory) + 1) <= 0)
+            {
+                sprintf(status_message, "%s", lang_strings[STR_ERROR_CREATE_ZIP]);
+                added = false;
+                break;
+            }
+        }
+
+        if (added && !stop_activity)
+        {
+            snprintf(activity_message, 1023, "%s %s", lang_strings[STR_UPLOADING], zip_file_path);
+            if (!upload.Upload(zip_file_path))
+                snprintf(status_message, 1024, "%s %s", lang_strings[STR_FAILED], zip_file_path);
+        }
+
+        activity_inprogess = false;
+        file_transfering = false;
+        multi_selected_local_files.clear();
+        Windows::SetModalMode(false);
+        selected_action = ACTION_REFRESH_REMOTE_FILES;
+        return NULL;
+    }
+
+    void UploadZip()
+    {
+        sprintf(status_message, "%s", "");
+        int res = pthread_create(&bk_activity_thid, NULL, UploadZipThread, NULL);
+        if (res != 0)
+        {
+            activity_inprogess = false;
+            file_transfering = false;
+            multi_selected_local_files.clear();
+            Windows::SetModalMode(false);
+            selected_action = ACTION_REFRESH_REMOTE_FILES;
+        }
+    }
+
     void *MoveLocalFilesThread(void *argp)
     {
         file_transfering = true;
@@ -1658,7 +2259,9 @@ namespace Actions
         }
     }
 
-    int CopyOrMoveRemoteFile(const std::string &src, const std::string &dest, bool isCopy)
+    static RemoteCopy *remote_copy = nullptr;
+
+    int CopyOrMoveRemoteFile(const std::string &src, const std::string &dest, bool isCopy, uint64_t size)
     {
         int ret;
         if (overwrite_type == OVERWRITE_PROMPT && remoteclient->FileExists(dest))
@@ -1687,7 +2290,7 @@ namespace Actions
         {
             prev_tick = Util::GetTick();
             if (isCopy)
-                return remoteclient->Copy(src, dest);
+                return remote_copy != nullptr ? remote_copy->Copy(src, dest, size) : remoteclient->Copy(src, dest);
             else
                 return remoteclient->Move(src, dest);
         }
@@ -1718,7 +2321,7 @@ namespace Actions
             }
 
             snprintf(activity_message, 1024, "%s %s", lang_strings[STR_MOVING], it->path);
-            int res = CopyOrMoveRemoteFile(it->path, new_path, false);
+            int res = CopyOrMoveRemoteFile(it->path, new_path, false, it->file_size);
             if (res == 0)
                 sprintf(status_message, "%s - %s", it->name, lang_strings[STR_FAIL_COPY_MSG]);
         }
@@ -1751,46 +2354,31 @@ namespace Actions
         int ret;
         if (src.isDir)
         {
-            int err;
-            std::vector<DirEntry> entries = remoteclient->ListDir(src.path);
-            remoteclient->Mkdir(dest);
-            for (int i = 0; i < entries.size(); i++)
+            RemoteWalker walker(remote_settings, remoteclient, MIN(remote_settings->transfer_sessions, REMOTE_WALKER_MAX_SESSIONS));
+            walker.Start(src.path, dest);
+
+            WalkItem item;
+            while (walker.Next(&item))
             {
                 if (stop_activity)
                     return 1;
 
-                int path_length = strlen(dest) + strlen(entries[i].name) + 2;
-                char *new_path = (char *)malloc(path_length);
-                snprintf(new_path, path_length, "%s%s%s", dest, FS::hasEndSlash(dest) ? "" : "/", entries[i].name);
-
-                if (entries[i].isDir)
+                if (item.isDir)
                 {
-                    if (strcmp(entries[i].name, "..") == 0)
-                        continue;
-
-                    remoteclient->Mkdir(new_path);
-                    ret = CopyRemotePath(entries[i], new_path);
-                    if (ret <= 0)
-                    {
-                        free(new_path);
-                        return ret;
-                    }
+                    remoteclient->Mkdir(item.dest);
+                    continue;
                 }
-                else
+
+                snprintf(activity_message, 1024, "%s %s", lang_strings[STR_COPYING], item.path.c_str());
+                bytes_to_download = item.size;
+                bytes_transfered = 0;
+                prev_tick = Util::GetTick();
+                ret = CopyOrMoveRemoteFile(item.path, item.dest, true, item.size);
+                if (ret <= 0)
                 {
-                    snprintf(activity_message, 1024, "%s %s", lang_strings[STR_COPYING], entries[i].path);
-                    bytes_to_download = entries[i].file_size;
-                    bytes_transfered = 0;
-                    prev_tick = Util::GetTick();
-                    ret = CopyOrMoveRemoteFile(entries[i].path, new_path, true);
-                    if (ret <= 0)
-                    {
-                        sprintf(status_message, "%s %s", lang_strings[STR_FAIL_COPY_MSG], entries[i].path);
-                        free(new_path);
-                        return ret;
-                    }
+                    sprintf(status_message, "%s %s", lang_strings[STR_FAIL_COPY_MSG], item.path.c_str());
+                    return ret;
                 }
-                free(new_path);
             }
         }
         else
@@ -1799,7 +2387,10 @@ namespace Actions
             char *new_path = (char *)malloc(path_length);
             snprintf(new_path, path_length, "%s%s%s", dest, FS::hasEndSlash(dest) ? "" : "/", src.name);
             snprintf(activity_message, 1024, "%s %s", lang_strings[STR_COPYING], src.name);
-            ret = CopyOrMoveRemoteFile(src.path, new_path, true);
+            bytes_to_download = src.file_size;
+            bytes_transfered = 0;
+            prev_tick = Util::GetTick();
+            ret = CopyOrMoveRemoteFile(src.path, new_path, true, src.file_size);
             if (ret <= 0)
             {
                 free(new_path);
@@ -1813,7 +2404,8 @@ namespace Actions
 
     void *CopyRemoteFilesThread(void *argp)
     {
-        file_transfering = false;
+        file_transfering = true;
+        remote_copy = new RemoteCopy(remote_settings, remoteclient);
         for (std::vector<DirEntry>::iterator it = remote_paste_files.begin(); it != remote_paste_files.end(); ++it)
         {
             if (stop_activity)
@@ -1842,6 +2434,8 @@ namespace Actions
                     sprintf(status_message, "%s - %s", it->name, lang_strings[STR_FAIL_COPY_MSG]);
             }
         }
+        delete remote_copy;
+        remote_copy = nullptr;
         activity_inprogess = false;
         file_transfering = false;
         remote_paste_files.clear();
@@ -1863,6 +2457,94 @@ namespace Actions
         }
     }
 
+    /*
+     * Streams the selected remote files into the default folder of the site named in
+     * send_to_site, reading on sessions of the current site and writing on sessions of
+     * the other one. Nothing is staged on the local disk.
+     */
+    void *SendToSiteThread(void *argp)
+    {
+        file_transfering = true;
+        RemoteSettings *dest_settings = &site_settings[send_to_site];
+        std::vector<DirEntry> files;
+        if (multi_selected_remote_files.size() > 0)
+            std::copy(multi_selected_remote_files.begin(), multi_selected_remote_files.end(), std::back_inserter(files));
+        else
+            files.push_back(selected_remote_file);
+
+        RemoteClient *dest_client = INSTALLER::GetRemoteClient(dest_settings);
+        TransferPool *pool = nullptr;
+        if (dest_client != nullptr && dest_client->IsConnected())
+        {
+            pool = new TransferPool(remote_settings, remoteclient, TRANSFER_SITE_TO_SITE, remote_settings->transfer_sessions, transfer_order, dest_settings);
+            if (!pool->Start())
+            {
+                delete pool;
+                pool = nullptr;
+            }
+        }
+
+        if (pool == nullptr)
+        {
+            sprintf(status_message, "%s %s", lang_strings[STR_FAILED], send_to_site);
+        }
+        else
+        {
+            const char *dest_dir = strlen(dest_settings->default_directory) > 0 ? dest_settings->default_directory : "/";
+            prev_tick = Util::GetTick();
+            for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end() && !stop_activity; ++it)
+            {
+                std::string new_path = std::string(dest_dir) + (FS::hasEndSlash(dest_dir) ? "" : "/") + it->name;
+                if (!it->isDir)
+                {
+                    pool->Add(it->path, new_path, it->file_size);
+                    continue;
+                }
+
+                RemoteWalker walker(remote_settings, remoteclient, MIN(remote_settings->transfer_sessions, REMOTE_WALKER_MAX_SESSIONS));
+                walker.Start(it->path, new_path);
+
+                WalkItem item;
+                while (walker.Next(&item))
+                {
+                    if (stop_activity)
+                        break;
+
+                    if (item.isDir)
+                        dest_client->Mkdir(item.dest);
+                    else
+                        pool->Add(item.path, item.dest, item.size);
+                }
+            }
+            pool->Wait();
+            delete pool;
+        }
+
+        if (dest_client != nullptr)
+        {
+            dest_client->Quit();
+            delete dest_client;
+        }
+        activity_inprogess = false;
+        file_transfering = false;
+        multi_selected_remote_files.clear();
+        Windows::SetModalMode(false);
+        return NULL;
+    }
+
+    void SendToSite()
+    {
+        sprintf(status_message, "%s", "");
+        int res = pthread_create(&bk_activity_thid, NULL, SendToSiteThread, NULL);
+        if (res != 0)
+        {
+            file_transfering = false;
+            activity_inprogess = false;
+            multi_selected_remote_files.clear();
+            Windows::SetModalMode(false);
+        }
+    }
+
     int DownloadAndInstallPkg(const std::string &filename, pkg_header *header)
     {
         char local_file[2000];
@@ -1945,44 +2627,25 @@ namespace Actions
 
     void GetBackgroundDownloadProgress()
     {
-        CHTTPClient::HttpResponse res;
-        CHTTPClient::HeadersMap headers;
-        CHTTPClient tmp_client([](const std::string& log){});
-        tmp_client.InitSession(true, CHTTPClient::SettingsFlag::NO_FLAGS);
-        tmp_client.SetCertificateFile(CACERT_FILE);
-        tmp_client.SetTimeout(1);
+        std::vector<ProgressEvent> events;
 
-        if (tmp_client.Get("http://localhost:" + std::to_string(http_int_server_port) + "/get_download_state", headers, res))
-        {
-			if (HTTP_SUCCESS(res.iCode))
-			{
-                bg_download_progress.clear();
-                
-                json_object *jobj = json_tokener_parse(res.strBody.data());
-                if (jobj != nullptr)
-                {
-                    struct array_list *progress_list = json_object_get_array(jobj);
+        // The bus mirrors the ezremote server's list, one poller for every viewer
+        ProgressBus::KeepBackgroundBridge();
+        ProgressBus::Snapshot(events);
 
-                    for (size_t idx = 0; idx < progress_list->length; ++idx)
-                    {
-                        DownloadProgress progress;
-
-                        json_object *progress_obj = (json_object *)array_list_get_idx(progress_list, idx);
-                        progress.path = json_object_get_string(json_object_object_get(progress_obj, "path"));
-                        progress.bytes_transfered = json_object_get_uint64(json_object_object_get(progress_obj, "bytes_transfered"));
-                        progress.file_size = json_object_get_uint64(json_object_object_get(progress_obj, "file_size"));
-                        progress.state = state_strings[json_object_get_int(json_object_object_get(progress_obj, "state"))];
-                        progress.timestamp = json_object_get_uint64(json_object_object_get(progress_obj, "timestamp"));
+        bg_download_progress.clear();
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            if (events[i].kind != "background")
+                continue;
 
-                        bg_download_progress.push_back(progress);
-                    }
-                    json_object_put(jobj);
-                }
-            }
-			else
-			{
-                snprintf(status_message, 1024, "Failed to get the download progress from ezRemote Server");
-			}
+            DownloadProgress progress;
+            progress.path = events[i].name;
+            progress.bytes_transfered = events[i].bytes;
+            progress.file_size = events[i].total;
+            progress.state = state_strings[events[i].state];
+            progress.timestamp = events[i].timestamp;
+            bg_download_progress.push_back(progress);
         }
     }
 }
@@ -4,6 +4,7 @@
 #include <pthread.h>
 #include "common.h"
 #include "installer.h"
+#include "transfer_pool.h"
 
 #define CONFIRM_NONE -1
 #define CONFIRM_WAIT 0
@@ -58,6 +59,10 @@ enum ACTIONS
     ACTION_VIEW_LOCAL_PKG,
     ACTION_VIEW_REMOTE_PKG,
     ACTION_EXTRACT_REMOTE_ZIP,
+    ACTION_SEND_TO_SITE,
+    ACTION_UPLOAD_ZIP,
+    ACTION_SEARCH_LOCAL_FILES,
+    ACTION_SHOW_LOCAL_SEARCH_RESULTS,
 };
 
 enum OverWriteType
@@ -85,10 +90,13 @@ namespace Actions
     void RenameRemoteFolder(const char *old_path, const char *new_path);
     void *DeleteSelectedLocalFilesThread(void *argp);
     void DeleteSelectedLocalFiles();
+    int DeleteRemotePath(const DirEntry &src);
     void *DeleteSelectedRemotesFilesThread(void *argp);
     void DeleteSelectedRemotesFiles();
+    int QueueUpload(TransferPool *pool, const DirEntry &src, const char *dest);
     void *UploadFilesThread(void *argp);
     void UploadFiles();
+    int QueueDownload(TransferPool *pool, const DirEntry &src, const char *dest);
     void *DownloadFilesThread(void *argp);
     void DownloadFiles();
     void Connect();
@@ -109,6 +117,11 @@ namespace Actions
     void ExtractRemoteZips();
     void *MakeZipThread(void *argp);
     void MakeLocalZip();
+    void *SearchLocalFilesThread(void *argp);
+    void SearchLocalFiles(const char *pattern);
+    void ShowLocalSearchResults();
+    void *UploadZipThread(void *argp);
+    void UploadZip();
     void *MoveLocalFilesThread(void *argp);
     void MoveLocalFiles();
     void *CopyLocalFilesThread(void *argp);
@@ -117,6 +130,8 @@ namespace Actions
     void MoveRemoteFiles();
     void *CopyRemoteFilesThread(void *argp);
     void CopyRemoteFiles();
+    void *SendToSiteThread(void *argp);
+    void SendToSite();
     int DownloadAndInstallPkg(const std::string &filename, pkg_header *header);
     void CreateLocalFile(char *filename);
     void CreateRemoteFile(char *filename);
@@ -0,0 +1,449 @@
+#include <string.h>
+#include <list>
+#include <set>
+#include <mutex>
+#include <zlib.h>
+#include "fs.h"
+#include "lang.h"
+#include "util.h"
+#include "windows.h"
+#include "zip_util.h"
+#include "archive_index.h"
+
+#define ZIP_LOCAL_HEADER_SIG 0x04034b50
+#define ZIP_CENTRAL_HEADER_SIG 0x02014b50
+#define ZIP64_LOCATOR_SIG 0x07064b50
+#define ZIP64_END_SIG 0x06064b50
+#define ZIP_END_SIG 0x06054b50
+
+static std::mutex cache_mutex;
+static std::list<std::shared_ptr<ArchiveIndex>> cache;
+
+static uint16_t Get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t Get32(const uint8_t *p)
+{
+    return Get16(p) | ((uint32_t)Get16(p + 2) << 16);
+}
+
+static uint64_t Get64(const uint8_t *p)
+{
+    return Get32(p) | ((uint64_t)Get32(p + 4) << 32);
+}
+
+bool ArchiveIndex::IsArchive(const std::string &name)
+{
+    std::string lower = Util::ToLower(name);
+    return Util::EndsWith(lower, ".zip") || Util::EndsWith(lower, ".7z") || Util::EndsWith(lower, ".rar");
+}
+
+std::shared_ptr<ArchiveIndex> ArchiveIndex::Open(const std::string &site, RemoteClient *client, const DirEntry &archive)
+{
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        for (std::list<std::shared_ptr<ArchiveIndex>>::iterator it = cache.begin(); it != cache.end(); ++it)
+        {
+            if ((*it)->site != site || (*it)->path.compare(archive.path) != 0)
+                continue;
+
+            if ((*it)->size == archive.file_size && memcmp(&(*it)->modified, &archive.modified, sizeof(DateTime)) == 0)
+            {
+                cache.splice(cache.begin(), cache, it);
+                return cache.front();
+            }
+
+            // Archive changed on the server since it was indexed
+            cache.erase(it);
+            break;
+        }
+    }
+
+    std::shared_ptr<ArchiveIndex> index = std::make_shared<ArchiveIndex>();
+    index->site = site;
+    index->path = archive.path;
+    index->size = archive.file_size;
+    index->modified = archive.modified;
+    if (!index->Load(client))
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cache.push_front(index);
+    while (cache.size() > ARCHIVE_INDEX_CACHE_SIZE)
+    {
+        cache.pop_back();
+    }
+    return index;
+}
+
+/*
+ * Returns the opened archive holding path, with the path inside the archive in
+ * inner, or nullptr when path isn't below an archive.
+ */
+std::shared_ptr<ArchiveIndex> ArchiveIndex::Find(const std::string &site, const std::string &path, std::string *inner)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    for (std::list<std::shared_ptr<ArchiveIndex>>::iterator it = cache.begin(); it != cache.end(); ++it)
+    {
+        const std::string &archive_path = (*it)->path;
+        if ((*it)->site != site || path.compare(0, archive_path.length(), archive_path) != 0)
+            continue;
+        if (path.length() > archive_path.length() && path[archive_path.length()] != '/')
+            continue;
+
+        if (inner != nullptr)
+        {
+            *inner = path.substr(MIN(path.length(), archive_path.length() + 1));
+            while (inner->length() > 0 && (*inner)[inner->length() - 1] == '/')
+                inner->pop_back();
+        }
+        return *it;
+    }
+    return nullptr;
+}
+
+std::string ArchiveIndex::Path()
+{
+    return this->path;
+}
+
+int ArchiveIndex::Load(RemoteClient *client)
+{
+    this->is_zip = Util::EndsWith(Util::ToLower(this->path), ".zip");
+    if (this->is_zip)
+    {
+        if (LoadZip(client))
+            return 1;
+
+        // Not a zip libarchive can't read as well, e.g. a self extracting one
+        this->is_zip = false;
+        this->entries.clear();
+    }
+
+    return ZipUtil::ListArchive(this->path, client, this->entries);
+}
+
+/*
+ * Reads the end of central directory record from the tail of the file, then the
+ * central directory it points to, two ranged requests in all.
+ */
+int ArchiveIndex::LoadZip(RemoteClient *client)
+{
+    if (this->size < 22)
+        return 0;
+
+    uint64_t tail_size = MIN(this->size, ARCHIVE_INDEX_TAIL_SIZE);
+    uint64_t tail_offset = this->size - tail_size;
+    std::vector<uint8_t> tail(tail_size);
+    if (!client->GetRange(this->path, tail.data(), tail_size, tail_offset))
+        return 0;
+
+    int64_t end_pos = -1;
+    for (int64_t i = tail_size - 22; i >= 0; i--)
+    {
+        if (Get32(&tail[i]) == ZIP_END_SIG)
+        {
+            end_pos = i;
+            break;
+        }
+    }
+    if (end_pos < 0)
+        return 0;
+
+    uint64_t count = Get16(&tail[end_pos + 10]);
+    uint64_t central_size = Get32(&tail[end_pos + 12]);
+    uint64_t central_offset = Get32(&tail[end_pos + 16]);
+    if (count == 0xFFFF || central_size == 0xFFFFFFFF || central_offset == 0xFFFFFFFF)
+    {
+        if (end_pos < 20 || Get32(&tail[end_pos - 20]) != ZIP64_LOCATOR_SIG)
+            return 0;
+
+        uint8_t end64[56];
+        uint64_t end64_offset = Get64(&tail[end_pos - 20 + 8]);
+        if (end64_offset + sizeof(end64) > this->size || !client->GetRange(this->path, end64, sizeof(end64), end64_offset))
+            return 0;
+        if (Get32(end64) != ZIP64_END_SIG)
+            return 0;
+
+        count = Get64(end64 + 32);
+        central_size = Get64(end64 + 40);
+        central_offset = Get64(end64 + 48);
+    }
+
+    if (central_offset + central_size > this->size)
+        return 0;
+
+    std::vector<uint8_t> central(central_size);
+    if (central_size > 0 && !client->GetRange(this->path, central.data(), central_size, central_offset))
+        return 0;
+
+    size_t pos = 0;
+    this->entries.reserve(count);
+    while (pos + 46 <= central.size() && Get32(&central[pos]) == ZIP_CENTRAL_HEADER_SIG)
+    {
+        const uint8_t *h = &central[pos];
+        uint16_t name_len = Get16(h + 28);
+        uint16_t extra_len = Get16(h + 30);
+        uint16_t comment_len = Get16(h + 32);
+        if (pos + 46 + name_len + extra_len + comment_len > central.size())
+            return 0;
+
+        ArchiveIndexEntry entry;
+        entry.flags = Get16(h + 8);
+        entry.method = Get16(h + 10);
+        entry.crc = Get32(h + 16);
+        entry.compressed = Get32(h + 20);
+        entry.size = Get32(h + 24);
+        entry.header_offset = Get32(h + 42);
+        entry.name = std::string((const char *)h + 46, name_len);
+        entry.is_dir = name_len > 0 && entry.name[name_len - 1] == '/';
+        while (entry.name.length() > 0 && entry.name[entry.name.length() - 1] == '/')
+            entry.name.pop_back();
+
+        uint16_t dos_time = Get16(h + 12);
+        uint16_t dos_date = Get16(h + 14);
+        memset(&entry.modified, 0, sizeof(DateTime));
+        entry.modified.year = (dos_date >> 9) + 1980;
+        entry.modified.month = (dos_date >> 5) & 0x0F;
+        entry.modified.day = dos_date & 0x1F;
+        entry.modified.hours = dos_time >> 11;
+        entry.modified.minutes = (dos_time >> 5) & 0x3F;
+        entry.modified.seconds = (dos_time & 0x1F) * 2;
+
+        // zip64 extra holds the fields that didn't fit, in this order
+        const uint8_t *extra = h + 46 + name_len;
+        size_t extra_pos = 0;
+        while (extra_pos + 4 <= extra_len)
+        {
+            uint16_t id = Get16(extra + extra_pos);
+            uint16_t len = Get16(extra + extra_pos + 2);
+            if (extra_pos + 4 + len > extra_len)
+                break;
+            if (id == 0x0001)
+            {
+                const uint8_t *field = extra + extra_pos + 4;
+                const uint8_t *field_end = field + len;
+                if (entry.size == 0xFFFFFFFF && field + 8 <= field_end)
+                {
+                    entry.size = Get64(field);
+                    field += 8;
+                }
+                if (entry.compressed == 0xFFFFFFFF && field + 8 <= field_end)
+                {
+                    entry.compressed = Get64(field);
+                    field += 8;
+                }
+                if (entry.header_offset == 0xFFFFFFFF && field + 8 <= field_end)
+                    entry.header_offset = Get64(field);
+            }
+            extra_pos += 4 + len;
+        }
+
+        if (!entry.name.empty())
+            this->entries.push_back(entry);
+        pos += 46 + name_len + extra_len + comment_len;
+    }
+
+    return 1;
+}
+
+std::vector<DirEntry> ArchiveIndex::ListDir(const std::string &inner)
+{
+    std::string dir_path = this->path + (inner.empty() ? "" : "/" + inner);
+    std::string prefix = inner.empty() ? "" : inner + "/";
+
+    std::vector<DirEntry> out;
+    DirEntry up;
+    Util::SetupPreviousFolder(dir_path, &up);
+    out.push_back(up);
+
+    std::set<std::string> folders;
+    for (int i = 0; i < this->entries.size(); i++)
+    {
+        const ArchiveIndexEntry &item = this->entries[i];
+        if (item.name.compare(0, prefix.length(), prefix) != 0 || item.name.length() <= prefix.length())
+            continue;
+
+        std::string rest = item.name.substr(prefix.length());
+        size_t slash_pos = rest.find("/");
+        bool is_dir = item.is_dir || slash_pos != std::string::npos;
+        std::string name = rest.substr(0, slash_pos);
+        if (is_dir && !folders.insert(name).second)
+            continue;
+
+        DirEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.selectable = true;
+        snprintf(entry.name, sizeof(entry.name), "%s", name.c_str());
+        snprintf(entry.directory, sizeof(entry.directory), "%s", dir_path.c_str());
+        snprintf(entry.path, sizeof(entry.path), "%s/%s", dir_path.c_str(), name.c_str());
+        entry.isDir = is_dir;
+        if (is_dir)
+        {
+            sprintf(entry.display_size, "%s", lang_strings[STR_FOLDER]);
+        }
+        else
+        {
+            entry.file_size = item.size;
+            DirEntry::SetDisplaySize(&entry);
+        }
+        if (slash_pos == std::string::npos)
+            entry.modified = item.modified;
+        out.push_back(entry);
+    }
+
+    return out;
+}
+
+/*
+ * Every file below the folder inner, for downloading a folder out of the archive.
+ */
+std::vector<ArchiveIndexEntry> ArchiveIndex::ListFiles(const std::string &inner)
+{
+    std::string prefix = inner.empty() ? "" : inner + "/";
+    std::vector<ArchiveIndexEntry> out;
+    for (int i = 0; i < this->entries.size(); i++)
+    {
+        if (!this->entries[i].is_dir && this->entries[i].name.compare(0, prefix.length(), prefix) == 0)
+            out.push_back(this->entries[i]);
+    }
+    return out;
+}
+
+int ArchiveIndex::Extract(RemoteClient *client, const std::string &inner, const std::string &dest)
+{
+    for (int i = 0; i < this->entries.size(); i++)
+    {
+        const ArchiveIndexEntry &entry = this->entries[i];
+        if (entry.is_dir || entry.name.compare(inner) != 0)
+            continue;
+
+        bytes_transfered = 0;
+        bytes_to_download = entry.size;
+        prev_tick = Util::GetTick();
+
+        // Encrypted entries and methods other than store/deflate go through libarchive
+        if (this->is_zip && (entry.method == 0 || entry.method == Z_DEFLATED) && !(entry.flags & 0x0001))
+            return ExtractZipEntry(client, entry, dest);
+        return ZipUtil::ExtractEntry(this->path, client, entry.name, dest);
+    }
+
+    return 0;
+}
+
+/*
+ * True for zip entries whose bytes sit in the archive as they are, which can be
+ * read at any offset straight from the remote file.
+ */
+bool ArchiveIndex::IsStored(const ArchiveIndexEntry &entry)
+{
+    return this->is_zip && !entry.is_dir && entry.method == 0 && !(entry.flags & 0x0001) && entry.compressed == entry.size;
+}
+
+/*
+ * Where the data of a zip entry starts, past its local header whose name and
+ * extra field lengths can differ from the central directory's.
+ */
+int ArchiveIndex::DataOffset(RemoteClient *client, const ArchiveIndexEntry &entry, uint64_t *offset)
+{
+    uint8_t local_header[30];
+    if (!client->GetRange(this->path, local_header, sizeof(local_header), entry.header_offset) ||
+        Get32(local_header) != ZIP_LOCAL_HEADER_SIG)
+        return 0;
+
+    *offset = entry.header_offset + sizeof(local_header) + Get16(local_header + 26) + Get16(local_header + 28);
+    return 1;
+}
+
+/*
+ * Fetches only the byte range of the entry, inflating it on the way to disk when
+ * deflated, and checks the crc.
+ */
+int ArchiveIndex::ExtractZipEntry(RemoteClient *client, const ArchiveIndexEntry &entry, const std::string &dest)
+{
+    uint64_t data_offset;
+    if (!DataOffset(client, entry, &data_offset))
+        return 0;
+
+    FILE *out = FS::Create(dest);
+    if (out == NULL)
+        return 0;
+
+    bool deflated = entry.method == Z_DEFLATED;
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (deflated && inflateInit2(&strm, -MAX_WBITS) != Z_OK)
+    {
+        FS::Close(out);
+        return 0;
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    uint64_t written = 0;
+    bool failed = false;
+    std::vector<uint8_t> buf(ARCHIVE_INDEX_COPY_SIZE);
+
+    DataSink sink;
+    sink.write = [&](const char *data, size_t len) -> bool
+    {
+        if (stop_activity)
+            return false;
+
+        if (!deflated)
+        {
+            if (FS::Write(out, data, len) != len)
+            {
+                failed = true;
+                return false;
+            }
+            crc = crc32(crc, (const Bytef *)data, len);
+            written += len;
+            bytes_transfered = written;
+            return true;
+        }
+
+        // A full output buffer can leave inflated data pending after the input is used up
+        strm.next_in = (Bytef *)data;
+        strm.avail_in = len;
+        do
+        {
+            strm.next_out = buf.data();
+            strm.avail_out = buf.size();
+            int ret = inflate(&strm, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+            {
+                failed = true;
+                return false;
+            }
+            size_t have = buf.size() - strm.avail_out;
+            if (have > 0 && FS::Write(out, buf.data(), have) != have)
+            {
+                failed = true;
+                return false;
+            }
+            crc = crc32(crc, buf.data(), have);
+            written += have;
+            bytes_transfered = written;
+            if (ret == Z_STREAM_END || (ret == Z_BUF_ERROR && have == 0))
+                break;
+        } while (strm.avail_in > 0 || strm.avail_out == 0);
+        return true;
+    };
+
+    int ret = 1;
+    if (entry.compressed > 0)
+        ret = client->GetRange(this->path, sink, entry.compressed, data_offset);
+
+    if (deflated)
+        inflateEnd(&strm);
+    FS::Close(out);
+
+    if (!ret || failed || written != entry.size || crc != entry.crc)
+    {
+        FS::Rm(dest);
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,62 @@
+#ifndef EZ_ARCHIVE_INDEX_H
+#define EZ_ARCHIVE_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "clients/remote_client.h"
+#include "common.h"
+
+#define ARCHIVE_INDEX_CACHE_SIZE 8
+#define ARCHIVE_INDEX_TAIL_SIZE 65557
+#define ARCHIVE_INDEX_COPY_SIZE 262144
+
+struct ArchiveIndexEntry
+{
+    std::string name;
+    uint64_t size;
+    uint64_t compressed;
+    uint64_t header_offset;
+    uint32_t crc;
+    uint16_t method;
+    uint16_t flags;
+    bool is_dir;
+    DateTime modified;
+};
+
+/*
+ * Table of contents of a remote archive, so it can be browsed as a folder in the
+ * remote pane. For zip only the end of central directory and the central directory
+ * are fetched, and an entry is extracted from its own byte range. Other formats are
+ * listed and extracted through libarchive over the prefetching reader.
+ * Indexes are cached per site, path, size and modification time, paths below an
+ * opened archive are looked up with Find().
+ */
+class ArchiveIndex
+{
+public:
+    static bool IsArchive(const std::string &name);
+    static std::shared_ptr<ArchiveIndex> Open(const std::string &site, RemoteClient *client, const DirEntry &archive);
+    static std::shared_ptr<ArchiveIndex> Find(const std::string &site, const std::string &path, std::string *inner = nullptr);
+
+    std::vector<DirEntry> ListDir(const std::string &inner);
+    std::vector<ArchiveIndexEntry> ListFiles(const std::string &inner);
+    int Extract(RemoteClient *client, const std::string &inner, const std::string &dest);
+    bool IsStored(const ArchiveIndexEntry &entry);
+    int DataOffset(RemoteClient *client, const ArchiveIndexEntry &entry, uint64_t *offset);
+    std::string Path();
+
+private:
+    std::string site;
+    std::string path;
+    uint64_t size;
+    DateTime modified;
+    bool is_zip;
+    std::vector<ArchiveIndexEntry> entries;
+
+    int Load(RemoteClient *client);
+    int LoadZip(RemoteClient *client);
+    int ExtractZipEntry(RemoteClient *client, const ArchiveIndexEntry &entry, const std::string &dest);
+};
+
+#endif
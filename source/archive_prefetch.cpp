@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <chrono>
+#include "common.h"
+#include "lang.h"
+#include "archive_prefetch.h"
+
+static std::mutex pool_mutex;
+// Free window buffers and their capacity
+static std::vector<std::pair<uint8_t *, uint64_t>> pool;
+static std::atomic<uint64_t> total_fetched(0);
+static std::atomic<uint64_t> total_consumed(0);
+
+ArchivePrefetch::ArchivePrefetch(RemoteClient *client, const std::string &path, void *fp, uint64_t size)
+{
+    this->client = client;
+    this->path = path;
+    this->fp = fp;
+    this->size = size;
+    this->stopping = false;
+    this->active = false;
+    this->sequential = false;
+    this->generation = 0;
+    this->next_offset = 0;
+    this->stream_offset = 0;
+    this->expected_offset = 0;
+    this->fetched_bytes = 0;
+    this->consumed_bytes = 0;
+    this->window_size = ARCHIVE_PREFETCH_MIN_WINDOW;
+    this->window_count = ARCHIVE_PREFETCH_MIN_WINDOWS;
+    this->current.buf = nullptr;
+    this->current.capacity = 0;
+    this->thread_started = (pthread_create(&this->thread, NULL, FetchThread, this) == 0);
+}
+
+ArchivePrefetch::~ArchivePrefetch()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->stopping = true;
+    }
+    this->fetch_cv.notify_all();
+    this->ready_cv.notify_all();
+    if (this->thread_started)
+        pthread_join(this->thread, NULL);
+
+    for (int i = 0; i < this->ready.size(); i++)
+    {
+        Release(this->ready[i].buf, this->ready[i].capacity);
+    }
+    this->ready.clear();
+    Release(this->current.buf, this->current.capacity);
+}
+
+/*
+ * The smallest pooled buffer that holds len, or a new one of len bytes.
+ */
+uint8_t *ArchivePrefetch::Acquire(uint64_t len, uint64_t *capacity)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        int best = -1;
+        for (int i = 0; i < pool.size(); i++)
+        {
+            if (pool[i].second >= len && (best < 0 || pool[i].second < pool[best].second))
+                best = i;
+        }
+        if (best >= 0)
+        {
+            uint8_t *buf = pool[best].first;
+            *capacity = pool[best].second;
+            pool.erase(pool.begin() + best);
+            return buf;
+        }
+    }
+
+    *capacity = len;
+    return (uint8_t *)malloc(len);
+}
+
+/*
+ * Keeps the buffer for later windows. A full pool gives up its smallest
+ * buffer for a larger one, windows only grow while throughput holds.
+ */
+void ArchivePrefetch::Release(uint8_t *buf, uint64_t capacity)
+{
+    if (buf == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (pool.size() < ARCHIVE_PREFETCH_POOL_KEEP)
+    {
+        pool.push_back(std::make_pair(buf, capacity));
+        return;
+    }
+
+    int smallest = 0;
+    for (int i = 1; i < pool.size(); i++)
+    {
+        if (pool[i].second < pool[smallest].second)
+            smallest = i;
+    }
+    if (pool[smallest].second < capacity)
+    {
+        free(pool[smallest].first);
+        pool[smallest] = std::make_pair(buf, capacity);
+    }
+    else
+    {
+        free(buf);
+    }
+}
+
+uint64_t ArchivePrefetch::FetchedBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->fetched_bytes;
+}
+
+uint64_t ArchivePrefetch::ConsumedBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->consumed_bytes;
+}
+
+void ArchivePrefetch::ResetTotals()
+{
+    total_fetched = 0;
+    total_consumed = 0;
+}
+
+/*
+ * Bytes fetched from the server against bytes handed to libarchive, over every
+ * archive read since ResetTotals().
+ */
+std::string ArchivePrefetch::Summary()
+{
+    DirEntry fetched;
+    fetched.file_size = total_fetched;
+    DirEntry::SetDisplaySize(&fetched);
+    DirEntry consumed;
+    consumed.file_size = total_consumed;
+    DirEntry::SetDisplaySize(&consumed);
+
+    char summary[256];
+    snprintf(summary, sizeof(summary), "%s: %s, %s: %s", lang_strings[STR_FETCHED], fetched.display_size,
+             lang_strings[STR_READ], consumed.display_size);
+    return std::string(summary);
+}
+
+int ArchivePrefetch::GetRange(uint8_t *buf, uint64_t len, uint64_t offset)
+{
+    std::lock_guard<std::mutex> lock(client_mutex);
+    if (this->fp != nullptr)
+        return this->client->GetRange(this->fp, buf, len, offset);
+    return this->client->GetRange(this->path, buf, len, offset);
+}
+
+void *ArchivePrefetch::FetchThread(void *argp)
+{
+    ArchivePrefetch *prefetch = (ArchivePrefetch *)argp;
+    prefetch->Fetch();
+    return NULL;
+}
+
+void ArchivePrefetch::Fetch()
+{
+    while (true)
+    {
+        uint32_t generation;
+        uint64_t offset;
+        uint64_t len;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!this->stopping &&
+                   (!this->active || this->next_offset >= this->size ||
+                    this->ready.size() >= (this->sequential ? this->window_count : 1)))
+            {
+                this->fetch_cv.wait(lock);
+            }
+
+            if (this->stopping)
+                break;
+
+            generation = this->generation;
+            offset = this->next_offset;
+            len = MIN(this->window_size, this->size - offset);
+            this->next_offset += len;
+        }
+
+        uint64_t capacity;
+        uint8_t *buf = Acquire(len, &capacity);
+        auto start = std::chrono::steady_clock::now();
+        int ret = 0;
+        if (buf != nullptr)
+            ret = GetRange(buf, len, offset);
+        auto usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ret)
+        {
+            this->fetched_bytes += len;
+            total_fetched += len;
+        }
+        if (generation != this->generation)
+        {
+            // Reader moved elsewhere while this was in flight
+            Release(buf, capacity);
+            continue;
+        }
+
+        PrefetchWindow window;
+        window.buf = buf;
+        window.capacity = capacity;
+        window.offset = offset;
+        window.len = ret ? len : -1;
+        window.generation = generation;
+        this->ready.push_back(window);
+        if (!ret)
+            this->active = false;
+
+        // Only full windows say something about the throughput
+        if (ret && len == this->window_size && usec > 0)
+        {
+            uint64_t target = (uint64_t)((double)len * ARCHIVE_PREFETCH_WINDOW_MSEC * 1000 / usec);
+            target = target - (target % ARCHIVE_PREFETCH_MIN_WINDOW);
+            this->window_size = MAX(ARCHIVE_PREFETCH_MIN_WINDOW, MIN(target, ARCHIVE_PREFETCH_MAX_WINDOW));
+        }
+        this->ready_cv.notify_all();
+    }
+
+    return;
+}
+
+void ArchivePrefetch::Restart(uint64_t offset)
+{
+    this->generation++;
+    for (int i = 0; i < this->ready.size(); i++)
+    {
+        Release(this->ready[i].buf, this->ready[i].capacity);
+    }
+    this->ready.clear();
+    this->next_offset = offset;
+    this->stream_offset = offset;
+    this->active = true;
+    this->sequential = false;
+    this->fetch_cv.notify_all();
+}
+
+ssize_t ArchivePrefetch::ReadCached(uint64_t offset, const void **buff)
+{
+    for (std::list<CacheBlock>::iterator it = this->cache.begin(); it != this->cache.end(); ++it)
+    {
+        if (offset >= it->offset && offset < it->offset + it->data.size())
+        {
+            this->cache.splice(this->cache.begin(), this->cache, it);
+            *buff = it->data.data() + (offset - it->offset);
+            return it->data.size() - (offset - it->offset);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Fetches the aligned block holding offset into the cache, dropping the least
+ * recently used one when full.
+ */
+ssize_t ArchivePrefetch::ReadBlock(uint64_t offset, const void **buff, std::unique_lock<std::mutex> &lock)
+{
+    CacheBlock block;
+    block.offset = offset - (offset % ARCHIVE_CACHE_BLOCK_SIZE);
+    block.data.resize(MIN(ARCHIVE_CACHE_BLOCK_SIZE, this->size - block.offset));
+
+    lock.unlock();
+    int ret = GetRange(block.data.data(), block.data.size(), block.offset);
+    lock.lock();
+    if (!ret)
+        return -1;
+
+    this->fetched_bytes += block.data.size();
+    total_fetched += block.data.size();
+    this->cache.push_front(std::move(block));
+    while (this->cache.size() > ARCHIVE_CACHE_BLOCKS)
+    {
+        this->cache.pop_back();
+    }
+
+    return ReadCached(offset, buff);
+}
+
+/*
+ * Returns data starting at offset. The buffer stays valid until the next call,
+ * as libarchive expects of a read callback.
+ */
+ssize_t ArchivePrefetch::Read(uint64_t offset, const void **buff)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Release(this->current.buf, this->current.capacity);
+    this->current.buf = nullptr;
+
+    if (offset >= this->size)
+        return 0;
+
+    ssize_t read = ReadCached(offset, buff);
+    if (read == 0)
+    {
+        if (this->active && offset == this->stream_offset)
+        {
+            if (this->sequential && this->ready.empty())
+                this->window_count = MIN(this->window_count + 1, ARCHIVE_PREFETCH_MAX_WINDOWS);
+            else if (this->sequential && this->ready.size() >= this->window_count)
+                this->window_count = MAX(this->window_count - 1, ARCHIVE_PREFETCH_MIN_WINDOWS);
+            this->sequential = true;
+            this->fetch_cv.notify_all();
+        }
+        else if (offset == this->expected_offset)
+        {
+            // Reading carries on from where the last read ended, stream from here
+            Restart(offset);
+        }
+        else
+        {
+            read = ReadBlock(offset, buff, lock);
+            if (read < 0)
+                return -1;
+        }
+    }
+
+    if (read == 0)
+    {
+        while (this->ready.empty() && !this->stopping && this->thread_started)
+        {
+            this->ready_cv.wait(lock);
+        }
+        if (this->ready.empty())
+            return -1;
+
+        PrefetchWindow window = this->ready.front();
+        this->ready.pop_front();
+        this->fetch_cv.notify_all();
+
+        if (window.len < 0)
+        {
+            Release(window.buf, window.capacity);
+            return -1;
+        }
+
+        this->stream_offset = window.offset + window.len;
+        this->current = window;
+        *buff = window.buf;
+        read = window.len;
+    }
+
+    this->expected_offset = offset + read;
+    this->consumed_bytes += read;
+    total_consumed += read;
+    return read;
+}
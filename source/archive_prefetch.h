@@ -0,0 +1,98 @@
+#ifndef EZ_ARCHIVE_PREFETCH_H
+#define EZ_ARCHIVE_PREFETCH_H
+
+#include <string>
+#include <deque>
+#include <list>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <pthread.h>
+#include "clients/remote_client.h"
+
+#define ARCHIVE_PREFETCH_MIN_WINDOW 1048576
+#define ARCHIVE_PREFETCH_MAX_WINDOW 20971520
+#define ARCHIVE_PREFETCH_MIN_WINDOWS 2
+#define ARCHIVE_PREFETCH_MAX_WINDOWS 4
+#define ARCHIVE_PREFETCH_WINDOW_MSEC 250
+#define ARCHIVE_PREFETCH_POOL_KEEP 4
+#define ARCHIVE_CACHE_BLOCK_SIZE 65536
+#define ARCHIVE_CACHE_BLOCKS 32
+
+struct PrefetchWindow
+{
+    uint8_t *buf;
+    uint64_t capacity;
+    uint64_t offset;
+    ssize_t len;
+    uint32_t generation;
+};
+
+struct CacheBlock
+{
+    uint64_t offset;
+    std::vector<uint8_t> data;
+};
+
+/*
+ * Reads a remote archive ahead of libarchive. A background thread keeps the next
+ * windows of the file in flight while the current one is decompressed, so network
+ * and decompression overlap instead of taking turns.
+ * A window is sized to about ARCHIVE_PREFETCH_WINDOW_MSEC of the measured
+ * throughput, and more windows are kept ahead when the reader finds none ready.
+ * Reads that jump elsewhere, like the end of archive headers of zip and 7z, are
+ * served from small blocks kept in an LRU cache and leave the windows alone. Only
+ * when reading carries on from such a block is the stream moved there, fetching a
+ * single window ahead until reads are sequential again.
+ * Window buffers are sized to the window and come from a pool shared by all
+ * archives, a pooled buffer is reused when it is large enough.
+ */
+class ArchivePrefetch
+{
+public:
+    ArchivePrefetch(RemoteClient *client, const std::string &path, void *fp, uint64_t size);
+    ~ArchivePrefetch();
+    ssize_t Read(uint64_t offset, const void **buff);
+    uint64_t FetchedBytes();
+    uint64_t ConsumedBytes();
+    static void ResetTotals();
+    static std::string Summary();
+
+private:
+    RemoteClient *client;
+    std::string path;
+    void *fp;
+    uint64_t size;
+    pthread_t thread;
+    bool thread_started;
+    bool stopping;
+    bool active;
+    bool sequential;
+    uint32_t generation;
+    uint64_t next_offset;
+    uint64_t stream_offset;
+    uint64_t expected_offset;
+    uint64_t fetched_bytes;
+    uint64_t consumed_bytes;
+    uint64_t window_size;
+    int window_count;
+    PrefetchWindow current;
+    std::deque<PrefetchWindow> ready;
+    std::list<CacheBlock> cache;
+    std::mutex mutex_;
+    std::mutex client_mutex;
+    std::condition_variable ready_cv;
+    std::condition_variable fetch_cv;
+
+    static void *FetchThread(void *argp);
+    void Fetch();
+    void Restart(uint64_t offset);
+    int GetRange(uint8_t *buf, uint64_t len, uint64_t offset);
+    ssize_t ReadCached(uint64_t offset, const void **buff);
+    ssize_t ReadBlock(uint64_t offset, const void **buff, std::unique_lock<std::mutex> &lock);
+    static uint8_t *Acquire(uint64_t len, uint64_t *capacity);
+    static void Release(uint8_t *buf, uint64_t capacity);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "server/http_server.h"
+#include "util.h"
+#include "background_queue.h"
+
+bool BackgroundQueue::batch_unsupported = false;
+
+BackgroundQueue::BackgroundQueue(RemoteSettings *settings)
+{
+    this->settings = settings;
+    this->client = nullptr;
+    this->next_id = Util::GetTick();
+    this->queued = 0;
+    this->failed = 0;
+}
+
+BackgroundQueue::~BackgroundQueue()
+{
+    if (this->client != nullptr)
+    {
+        this->client->CleanupSession();
+        delete this->client;
+    }
+}
+
+int BackgroundQueue::Add(const std::string &src, const std::string &dest, uint64_t size)
+{
+    BackgroundJob job;
+    job.src = src;
+    job.dest = dest;
+    job.size = size;
+    job.id = this->next_id++;
+    this->jobs.push_back(job);
+    this->last_src = src;
+
+    if (this->jobs.size() >= BACKGROUND_QUEUE_BATCH_SIZE)
+        return Flush();
+    return 1;
+}
+
+void BackgroundQueue::AddSettings(json_object *params)
+{
+    json_object_object_add(params, "type", json_object_new_int(this->settings->type));
+    json_object_object_add(params, "url", json_object_new_string(this->settings->server));
+    json_object_object_add(params, "username", json_object_new_string(this->settings->username));
+    json_object_object_add(params, "password", json_object_new_string(this->settings->password));
+    if (this->settings->type == CLIENT_TYPE_HTTP_SERVER)
+    {
+        json_object_object_add(params, "http_server_type", json_object_new_string(this->settings->http_server_type));
+    }
+}
+
+/*
+ * Sends the pending jobs. Returns 0 when some of them were not queued.
+ */
+int BackgroundQueue::Flush()
+{
+    if (this->jobs.empty())
+        return 1;
+
+    if (this->client == nullptr)
+    {
+        this->client = new CHTTPClient([](const std::string &log) {});
+        this->client->InitSession(true, CHTTPClient::SettingsFlag::NO_FLAGS);
+        this->client->SetCertificateFile(CACERT_FILE);
+    }
+
+    int failed_before = this->failed;
+    if (batch_unsupported || !PostBatch())
+    {
+        for (std::vector<BackgroundJob>::iterator it = this->jobs.begin(); it != this->jobs.end(); ++it)
+        {
+            if (PostJob(*it))
+                this->queued++;
+            else
+                this->failed++;
+        }
+    }
+    this->jobs.clear();
+    return this->failed == failed_before;
+}
+
+/*
+ * Posts the pending jobs in one request. Returns 0 when the server has no
+ * batch endpoint so they are sent one by one instead, a batch the server
+ * took but rejected counts as failed.
+ */
+int BackgroundQueue::PostBatch()
+{
+    json_object *params = json_object_new_object();
+    AddSettings(params);
+    json_object *jobs_obj = json_object_new_array();
+    for (std::vector<BackgroundJob>::iterator it = this->jobs.begin(); it != this->jobs.end(); ++it)
+    {
+        json_object *job = json_object_new_object();
+        json_object_object_add(job, "src_path", json_object_new_string(it->src.c_str()));
+        json_object_object_add(job, "dest_path", json_object_new_string(it->dest.c_str()));
+        json_object_object_add(job, "size", json_object_new_uint64(it->size));
+        json_object_object_add(job, "id", json_object_new_uint64(it->id));
+        json_object_array_add(jobs_obj, job);
+    }
+    json_object_object_add(params, "jobs", jobs_obj);
+
+    CHTTPClient::HttpResponse res;
+    CHTTPClient::HeadersMap headers;
+    headers["Content-Type"] = "application/json";
+    std::string url = std::string("http://localhost:") + std::to_string(http_int_server_port) + "/download_urls";
+    bool posted = this->client->Post(url, headers, json_object_to_json_string(params), res);
+    json_object_put(params);
+
+    if (posted && (res.iCode == 404 || res.iCode == 405))
+    {
+        batch_unsupported = true;
+        return 0;
+    }
+    if (posted && HTTP_SUCCESS(res.iCode))
+        this->queued += this->jobs.size();
+    else
+        this->failed += this->jobs.size();
+    return 1;
+}
+
+int BackgroundQueue::PostJob(const BackgroundJob &job)
+{
+    json_object *params = json_object_new_object();
+    AddSettings(params);
+    json_object_object_add(params, "src_path", json_object_new_string(job.src.c_str()));
+    json_object_object_add(params, "dest_path", json_object_new_string(job.dest.c_str()));
+    json_object_object_add(params, "size", json_object_new_uint64(job.size));
+    json_object_object_add(params, "id", json_object_new_uint64(job.id));
+
+    CHTTPClient::HttpResponse res;
+    CHTTPClient::HeadersMap headers;
+    headers["Content-Type"] = "application/json";
+    std::string url = std::string("http://localhost:") + std::to_string(http_int_server_port) + "/download_url";
+    bool posted = this->client->Post(url, headers, json_object_to_json_string(params), res);
+    json_object_put(params);
+
+    return posted && HTTP_SUCCESS(res.iCode);
+}
+
+int BackgroundQueue::Finish()
+{
+    Flush();
+
+    uint64_t id = Util::GetTick();
+    if (this->queued == 1 && this->failed == 0)
+        Util::RichNotify(id, "%s queued for download", this->last_src.c_str());
+    else if (this->queued > 0 && this->failed == 0)
+        Util::RichNotify(id, "%d files queued for download", this->queued);
+    else if (this->failed == 1 && this->queued == 0)
+        Util::RichNotify(id, "Failed to queue %s for download in background", this->last_src.c_str());
+    else if (this->failed > 0)
+        Util::RichNotify(id, "%d files queued for download, failed to queue %d in background", this->queued, this->failed);
+
+    int ret = (this->failed == 0);
+    this->queued = 0;
+    this->failed = 0;
+    return ret;
+}
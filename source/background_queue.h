@@ -0,0 +1,54 @@
+#ifndef EZ_BACKGROUND_QUEUE_H
+#define EZ_BACKGROUND_QUEUE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <json-c/json.h>
+#include "httpclient/HTTPClient.h"
+#include "config.h"
+
+#define BACKGROUND_QUEUE_BATCH_SIZE 512
+
+struct BackgroundJob
+{
+    std::string src;
+    std::string dest;
+    uint64_t size;
+    uint64_t id;
+};
+
+/*
+ * Hands downloads over to the ezremote server in batches. Jobs share the
+ * connection and credentials of the site, sent once per batch to
+ * /download_urls over one client kept open for the whole queue. Servers
+ * without the batch endpoint get the jobs one by one on /download_url, still
+ * on the same connection. One notification sums up the queue when it is
+ * finished instead of one per file.
+ */
+class BackgroundQueue
+{
+public:
+    BackgroundQueue(RemoteSettings *settings);
+    ~BackgroundQueue();
+    int Add(const std::string &src, const std::string &dest, uint64_t size);
+    // Sends what is left and notifies, returns 0 if any job was not queued
+    int Finish();
+
+private:
+    RemoteSettings *settings;
+    CHTTPClient *client;
+    std::vector<BackgroundJob> jobs;
+    std::string last_src;
+    uint64_t next_id;
+    int queued;
+    int failed;
+
+    int Flush();
+    int PostBatch();
+    int PostJob(const BackgroundJob &job);
+    void AddSettings(json_object *params);
+    static bool batch_unsupported;
+};
+
+#endif
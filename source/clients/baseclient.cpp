@@ -40,16 +40,16 @@ int BaseClient::NothingCallback(void* ptr, double dTotalToDownload, double dNowD
 int BaseClient::DownloadProgressCallback(void* ptr, double dTotalToDownload, double dNowDownloaded, double dTotalToUpload, double dNowUploaded)
 {
     CHTTPClient::ProgressFnStruct *progress_data = (CHTTPClient::ProgressFnStruct*) ptr;
-    int64_t *bytes_transfered = (int64_t *) progress_data->pOwner;
-	*bytes_transfered = dNowDownloaded;
+    std::atomic<uint64_t> *bytes_transfered = (std::atomic<uint64_t> *) progress_data->pOwner;
+	*bytes_transfered = (uint64_t)dNowDownloaded;
     return 0;
 }
 
 int BaseClient::UploadProgressCallback(void* ptr, double dTotalToDownload, double dNowDownloaded, double dTotalToUpload, double dNowUploaded)
 {
     CHTTPClient::ProgressFnStruct *progress_data = (CHTTPClient::ProgressFnStruct*) ptr;
-    int64_t *bytes_transfered = (int64_t *) progress_data->pOwner;
-    *bytes_transfered = dNowUploaded;
+    std::atomic<uint64_t> *bytes_transfered = (std::atomic<uint64_t> *) progress_data->pOwner;
+    *bytes_transfered = (uint64_t)dNowUploaded;
     return 0;
 }
 
@@ -182,17 +182,17 @@ int BaseClient::Size(const std::string &path, uint64_t *size)
 int BaseClient::Get(const std::string &outputfile, const std::string &path, uint64_t offset)
 {
     long status;
-    bytes_transfered = 0;
+    *xfer_transfered = 0;
     prev_tick = Util::GetTick();
     CHTTPClient::HeadersMap headers;
 
-    if (!Size(path, &bytes_to_download))
+    if (!Size(path, xfer_to_download))
     {
         sprintf(this->response, "%s", lang_strings[STR_FAIL_DOWNLOAD_MSG]);
         return 0;
     }
 
-    client->SetProgressFnCallback(&bytes_transfered, DownloadProgressCallback);
+    client->SetProgressFnCallback(xfer_transfered, DownloadProgressCallback);
     std::string encoded_url = this->host_url + CHTTPClient::EncodeUrl(GetFullPath(path));
     if (client->DownloadFile(outputfile, encoded_url, status))
     {
@@ -363,6 +363,11 @@ std::string BaseClient::GetFullPath(std::string ppath1)
     return path1;
 }
 
+std::string BaseClient::GetUrl(const std::string &path)
+{
+    return this->host_url + CHTTPClient::EncodeUrl(GetFullPath(path));
+}
+
 bool BaseClient::IsConnected()
 {
     return this->connected;
@@ -33,6 +33,7 @@ public:
     std::vector<DirEntry> ListDir(const std::string &path);
     std::string GetPath(std::string path1, std::string path2);
     std::string GetFullPath(std::string path1);
+    std::string GetUrl(const std::string &path);
     void *Open(const std::string &path, int flags);
     void Close(void *fp);
     bool IsConnected();
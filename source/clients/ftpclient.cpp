@@ -1809,7 +1809,7 @@ ClientType FtpClient::clientType()
 
 uint32_t FtpClient::SupportedActions()
 {
-	return REMOTE_ACTION_ALL ^ REMOTE_ACTION_CUT ^ REMOTE_ACTION_COPY ^ REMOTE_ACTION_PASTE ^ REMOTE_ACTION_RAW_READ;
+	return REMOTE_ACTION_ALL ^ REMOTE_ACTION_RAW_READ;
 }
 
 std::string FtpClient::GetPath(std::string ppath1, std::string ppath2)
@@ -1822,16 +1822,25 @@ std::string FtpClient::GetPath(std::string ppath1, std::string ppath2)
 	return path1;
 }
 
+/*
+ * Server side copy through the SITE CPFR/CPTO extension (proftpd mod_copy).
+ * Servers without it reject CPFR and callers fall back to streaming between sessions.
+ */
 int FtpClient::Copy(const std::string &from, const std::string &to)
 {
-	sprintf(mp_ftphandle->response, "%s", lang_strings[STR_UNSUPPORTED_OPERATION_MSG]);
-	return 0;
+	std::string cmd = "SITE CPFR " + from;
+	if (!FtpSendCmd(cmd, "3", mp_ftphandle))
+		return 0;
+	cmd = "SITE CPTO " + to;
+	if (!FtpSendCmd(cmd, "2", mp_ftphandle))
+		return 0;
+
+	return 1;
 }
 
 int FtpClient::Move(const std::string &from, const std::string &to)
 {
-	sprintf(mp_ftphandle->response, "%s", lang_strings[STR_UNSUPPORTED_OPERATION_MSG]);
-	return 0;
+	return Rename(from, to);
 }
 
 int FtpClient::Head(const std::string &path, void *buffer, uint64_t len)
@@ -1859,6 +1868,34 @@ void FtpClient::Close(void *fp)
 {
 }
 
+void *FtpClient::OpenWrite(const std::string &path, uint64_t offset)
+{
+	// STOR always starts over, APPE continues a partial file
+	ftphandle *nData;
+	if (!FtpAccess(path, offset > 0 ? FtpClient::filewriteappend : FtpClient::filewrite, FtpClient::transfermode::image, mp_ftphandle, &nData))
+		return nullptr;
+	return nData;
+}
+
+int FtpClient::Write(void *fp, const void *buffer, uint64_t size)
+{
+	char *ptr = (char *)buffer;
+	while (size > 0)
+	{
+		int count = FtpWrite(ptr, MIN(size, FTP_CLIENT_BUFSIZ), (ftphandle *)fp);
+		if (count <= 0)
+			return 0;
+		ptr += count;
+		size -= count;
+	}
+	return 1;
+}
+
+int FtpClient::CloseWrite(void *fp)
+{
+	return FtpClose((ftphandle *)fp);
+}
+
 int FtpClient::GetRange(void *fp, DataSink &sink, uint64_t size, uint64_t offset)
 {
 	return -1;
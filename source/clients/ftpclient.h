@@ -90,6 +90,9 @@ public:
     int Move(const std::string &from, const std::string &to);
 	int Head(const std::string &path, void *buffer, uint64_t len);
     void *Open(const std::string &path, int flags);
+	void *OpenWrite(const std::string &path, uint64_t offset = 0);
+	int Write(void *fp, const void *buffer, uint64_t size);
+	int CloseWrite(void *fp);
     void Close(void *fp);
 	std::vector<DirEntry> ListDir(const std::string &path);
 	void SetCallbackXferFunction(FtpCallbackXfer pointer);
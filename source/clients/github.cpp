@@ -159,17 +159,17 @@ int GithubClient::Get(const std::string &outputfile, const std::string &path, ui
     }
 
     long status;
-    bytes_transfered = 0;
+    *xfer_transfered = 0;
     prev_tick = Util::GetTick();
     CHTTPClient::HeadersMap headers;
 
-    if (!Size(path, &bytes_to_download))
+    if (!Size(path, xfer_to_download))
     {
         sprintf(this->response, "%s", lang_strings[STR_FAIL_DOWNLOAD_MSG]);
         return 0;
     }
 
-    client->SetProgressFnCallback(&bytes_transfered, DownloadProgressCallback);
+    client->SetProgressFnCallback(xfer_transfered, DownloadProgressCallback);
     std::string encoded_url = this->m_download_url + CHTTPClient::EncodeUrl(m_assets[path_parts[0]][path_parts[1]].url);
     if (client->DownloadFile(outputfile, encoded_url, status))
     {
@@ -290,7 +290,7 @@ bool GithubClient::ParseReleases()
     if (!releases_parsed)
     {
         std::string encoded_url = this->host_url + this->base_path + "?per_page=100&page=1";
-        client->SetProgressFnCallback(&bytes_transfered, DownloadProgressCallback);
+        client->SetProgressFnCallback(xfer_transfered, DownloadProgressCallback);
         if (client->Get(encoded_url, headers, res))
         {
             if (HTTP_SUCCESS(res.iCode))
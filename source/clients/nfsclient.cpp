@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <errno.h>
 #include "clients/nfsclient.h"
@@ -189,7 +190,7 @@ int NfsClient::Rmdir(const std::string &path, bool recursive)
 
 int NfsClient::Get(const std::string &outputfile, const std::string &ppath, uint64_t offset)
 {
-	if (!Size(ppath.c_str(), &bytes_to_download))
+	if (!Size(ppath.c_str(), xfer_to_download))
 	{
 		sprintf(response, "%s", nfs_get_error(nfs));
 		return 0;
@@ -212,7 +213,7 @@ int NfsClient::Get(const std::string &outputfile, const std::string &ppath, uint
 
 	void *buff = malloc(BUF_SIZE);
 	int count = 0;
-	bytes_transfered = 0;
+	*xfer_transfered = 0;
 	prev_tick = Util::GetTick();
 	while ((count = nfs_read(nfs, nfsfh, BUF_SIZE, buff)) > 0)
 	{
@@ -225,7 +226,7 @@ int NfsClient::Get(const std::string &outputfile, const std::string &ppath, uint
 			return 0;
 		}
 		FS::Write(out, buff, count);
-		bytes_transfered += count;
+		*xfer_transfered += count;
 	}
 	FS::Close(out);
 	nfs_close(nfs, nfsfh);
@@ -375,14 +376,14 @@ int NfsClient::GetRange(void *fp, void *buffer, uint64_t size, uint64_t offset)
 
 int NfsClient::Copy(const std::string &ffrom, const std::string &tto)
 {
+	// libnfs only speaks NFSv3 here so there is no COPY, callers fall back to streaming between sessions
 	sprintf(response, "%s", lang_strings[STR_UNSUPPORTED_OPERATION_MSG]);
 	return 0;
 }
 
 int NfsClient::Move(const std::string &ffrom, const std::string &tto)
 {
-	sprintf(response, "%s", lang_strings[STR_UNSUPPORTED_OPERATION_MSG]);
-	return 0;
+	return Rename(ffrom, tto);
 }
 
 bool NfsClient::FileExists(const std::string &ppath)
@@ -404,8 +405,8 @@ bool NfsClient::FileExists(const std::string &ppath)
  */
 int NfsClient::Put(const std::string &inputfile, const std::string &ppath, uint64_t offset)
 {
-	bytes_to_download = FS::GetSize(inputfile);
-	if (bytes_to_download < 0)
+	*xfer_to_download = FS::GetSize(inputfile);
+	if (*xfer_to_download < 0)
 	{
 		sprintf(response, "%s", lang_strings[STR_FAILED]);
 		return 0;
@@ -435,7 +436,7 @@ int NfsClient::Put(const std::string &inputfile, const std::string &ppath, uint6
 
 	void* buff = malloc(BUF_SIZE);
 	int count = 0;
-	bytes_transfered = 0;
+	*xfer_transfered = 0;
 	prev_tick = Util::GetTick();
 	while ((count = FS::Read(in, buff, BUF_SIZE)) != 0)
 	{
@@ -457,7 +458,7 @@ int NfsClient::Put(const std::string &inputfile, const std::string &ppath, uint6
 			free(buff);
 			return 0;
 		}
-		bytes_transfered += count;
+		*xfer_transfered += count;
 	}
 	FS::Close(in);
 	nfs_close(nfs, nfsfh);
@@ -466,6 +467,64 @@ int NfsClient::Put(const std::string &inputfile, const std::string &ppath, uint6
 	return 1;
 }
 
+/*
+ * Writes size bytes of inputfile starting at offset to the same offset of the remote file.
+ * The remote file is created when missing but never truncated, a zero size just creates it.
+ */
+int NfsClient::PutRange(const std::string &inputfile, const std::string &ppath, uint64_t offset, uint64_t size)
+{
+	FILE* in = FS::OpenRead(inputfile);
+	if (in == NULL)
+	{
+		sprintf(response, "%s", lang_strings[STR_FAILED]);
+		return 0;
+	}
+
+	struct nfsfh *nfsfh = nullptr;
+	int ret;
+	if (!FileExists(ppath))
+		ret = nfs_creat(nfs, ppath.c_str(), 0660, &nfsfh);
+	else
+		ret = nfs_open(nfs, ppath.c_str(), O_WRONLY, &nfsfh);
+
+	if (ret != 0)
+	{
+		sprintf(response, "%s", nfs_get_error(nfs));
+		FS::Close(in);
+		return 0;
+	}
+
+	void* buff = malloc(BUF_SIZE);
+	FS::Seek(in, offset);
+	uint64_t remaining = size;
+	*xfer_transfered = 0;
+	while (remaining > 0)
+	{
+		int count = FS::Read(in, buff, MIN(remaining, BUF_SIZE));
+		if (count <= 0)
+			break;
+		ret = nfs_pwrite(nfs, nfsfh, offset, count, buff);
+		if (ret < 0)
+		{
+			sprintf(response, "%s", nfs_get_error(nfs));
+			break;
+		}
+		offset += count;
+		remaining -= count;
+		*xfer_transfered += count;
+	}
+	FS::Close(in);
+	nfs_close(nfs, nfsfh);
+	free(buff);
+
+	return remaining == 0;
+}
+
+bool NfsClient::SupportsRangeWrite()
+{
+	return true;
+}
+
 int NfsClient::Rename(const std::string &src, const std::string &dst)
 {
 	int ret = nfs_rename(nfs, src.c_str(), dst.c_str());
@@ -615,7 +674,7 @@ ClientType NfsClient::clientType()
 
 uint32_t NfsClient::SupportedActions()
 {
-	return REMOTE_ACTION_ALL ^ REMOTE_ACTION_CUT ^ REMOTE_ACTION_COPY ^ REMOTE_ACTION_PASTE;
+	return REMOTE_ACTION_ALL;
 }
 
 void *NfsClient::Open(const std::string &path, int flags)
@@ -634,3 +693,47 @@ void NfsClient::Close(void *fp)
 {
 	nfs_close(nfs, (struct nfsfh *)fp);
 }
+
+void *NfsClient::OpenWrite(const std::string &path, uint64_t offset)
+{
+	struct nfsfh *nfsfh = nullptr;
+	int ret;
+	if (!FileExists(path))
+		ret = nfs_creat(nfs, path.c_str(), 0660, &nfsfh);
+	else
+		ret = nfs_open(nfs, path.c_str(), O_WRONLY | (offset == 0 ? O_TRUNC : 0), &nfsfh);
+
+	if (ret != 0)
+	{
+		sprintf(response, "%s", nfs_get_error(nfs));
+		return nullptr;
+	}
+	if (offset > 0)
+	{
+		uint64_t current_offset;
+		nfs_lseek(nfs, nfsfh, offset, SEEK_SET, &current_offset);
+	}
+	return nfsfh;
+}
+
+int NfsClient::Write(void *fp, const void *buffer, uint64_t size)
+{
+	const char *ptr = (const char *)buffer;
+	while (size > 0)
+	{
+		int ret = nfs_write(nfs, (struct nfsfh *)fp, MIN(size, BUF_SIZE), (void *)ptr);
+		if (ret < 0)
+		{
+			sprintf(response, "%s", nfs_get_error(nfs));
+			return 0;
+		}
+		ptr += ret;
+		size -= ret;
+	}
+	return 1;
+}
+
+int NfsClient::CloseWrite(void *fp)
+{
+	return nfs_close(nfs, (struct nfsfh *)fp) == 0;
+}
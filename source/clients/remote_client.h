@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
 #include "common.h"
 #include "http/httplib.h"
 #include "split_file.h"
@@ -40,6 +41,9 @@ enum ClientType
 
 using namespace httplib;
 
+extern std::atomic<uint64_t> bytes_transfered;
+extern uint64_t bytes_to_download;
+
 class RemoteClient
 {
 public:
@@ -72,6 +76,27 @@ public:
     virtual int Quit() = 0;
     virtual ClientType clientType() = 0;
     virtual uint32_t SupportedActions() = 0;
+
+    // Backends that can write at arbitrary offsets override these for segmented uploads
+    virtual bool SupportsRangeWrite() { return false; }
+    virtual int PutRange(const std::string &inputfile, const std::string &path, uint64_t offset, uint64_t size) { return 0; }
+
+    // Streaming writes, used to pipe a file from another session without staging it locally
+    virtual void *OpenWrite(const std::string &path, uint64_t offset = 0) { return nullptr; }
+    virtual int Write(void *fp, const void *buffer, uint64_t size) { return 0; }
+    virtual int CloseWrite(void *fp) { return 0; }
+
+    void SetProgressCounters(std::atomic<uint64_t> *transfered, uint64_t *to_download)
+    {
+        this->xfer_transfered = transfered;
+        this->xfer_to_download = to_download;
+    }
+
+protected:
+    // Transfers report into the global status counters unless a worker gives the session its own,
+    // the bytes done are read by the UI thread while the transfer runs
+    std::atomic<uint64_t> *xfer_transfered = &bytes_transfered;
+    uint64_t *xfer_to_download = &bytes_to_download;
 };
 
 #endif
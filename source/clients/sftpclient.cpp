@@ -262,7 +262,7 @@ int SFTPClient::Size(const std::string &path, uint64_t *size)
 
 int SFTPClient::Get(const std::string &outputfile, const std::string &path, uint64_t offset)
 {
-    if (!Size(path, &bytes_to_download))
+    if (!Size(path, xfer_to_download))
     {
         return 0;
     }
@@ -283,7 +283,7 @@ int SFTPClient::Get(const std::string &outputfile, const std::string &path, uint
 
     char *buff = (char *)malloc(FTP_CLIENT_BUFSIZ);
     int rc, count = 0;
-    bytes_transfered = 0;
+    *xfer_transfered = 0;
     prev_tick = Util::GetTick();
 
     do
@@ -291,7 +291,7 @@ int SFTPClient::Get(const std::string &outputfile, const std::string &path, uint
         rc = libssh2_sftp_read(sftp_handle, buff, FTP_CLIENT_BUFSIZ);
         if (rc > 0)
         {
-            bytes_transfered += rc;
+            *xfer_transfered += rc;
             FS::Write(out, buff, rc);
         }
         else
@@ -446,8 +446,8 @@ int SFTPClient::Put(const std::string &inputfile, const std::string &path, uint6
     char *ptr, *buff;
     int rc;
 
-    bytes_to_download = FS::GetSize(inputfile);
-    if (bytes_to_download < 0)
+    *xfer_to_download = FS::GetSize(inputfile);
+    if (*xfer_to_download < 0)
     {
         sprintf(response, "%s", lang_strings[STR_FAILED]);
         return 0;
@@ -473,7 +473,7 @@ int SFTPClient::Put(const std::string &inputfile, const std::string &path, uint6
 
     buff = (char *)malloc(FTP_CLIENT_BUFSIZ);
     int nread, count = 0;
-    bytes_transfered = 0;
+    *xfer_transfered = 0;
     prev_tick = Util::GetTick();
 
     do
@@ -495,7 +495,7 @@ int SFTPClient::Put(const std::string &inputfile, const std::string &path, uint6
                 break;
             ptr += rc;
             nread -= rc;
-            bytes_transfered += rc;
+            *xfer_transfered += rc;
         } while (nread);
     } while (rc > 0);
 
@@ -505,6 +505,73 @@ int SFTPClient::Put(const std::string &inputfile, const std::string &path, uint6
     return 1;
 }
 
+/*
+ * Writes size bytes of inputfile starting at offset to the same offset of the remote file.
+ * The remote file is created when missing but never truncated, a zero size just creates it.
+ */
+int SFTPClient::PutRange(const std::string &inputfile, const std::string &path, uint64_t offset, uint64_t size)
+{
+    char *ptr, *buff;
+    int rc = 0;
+
+    FILE *in = FS::OpenRead(inputfile);
+    if (in == NULL)
+    {
+        sprintf(response, "%s", lang_strings[STR_FAILED]);
+        return 0;
+    }
+
+    LIBSSH2_SFTP_HANDLE *sftp_handle = libssh2_sftp_open(sftp_session, path.c_str(),
+                                                         LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT,
+                                                         LIBSSH2_SFTP_S_IRUSR | LIBSSH2_SFTP_S_IWUSR |
+                                                             LIBSSH2_SFTP_S_IRGRP | LIBSSH2_SFTP_S_IROTH);
+    if (!sftp_handle)
+    {
+        sprintf(response, "%s", "Unable to open file with SFTP");
+        FS::Close(in);
+        return 0;
+    }
+
+    FS::Seek(in, offset);
+    libssh2_sftp_seek64(sftp_handle, offset);
+
+    buff = (char *)malloc(FTP_CLIENT_BUFSIZ);
+    uint64_t remaining = size;
+    *xfer_transfered = 0;
+
+    while (remaining > 0)
+    {
+        int nread = FS::Read(in, buff, MIN(remaining, FTP_CLIENT_BUFSIZ));
+        if (nread <= 0)
+            break;
+        remaining -= nread;
+        ptr = buff;
+
+        do
+        {
+            rc = libssh2_sftp_write(sftp_handle, ptr, nread);
+            if (rc < 0)
+                break;
+            ptr += rc;
+            nread -= rc;
+            *xfer_transfered += rc;
+        } while (nread);
+
+        if (rc < 0)
+            break;
+    }
+
+    libssh2_sftp_close(sftp_handle);
+    FS::Close(in);
+    free(buff);
+    return rc >= 0 && remaining == 0;
+}
+
+bool SFTPClient::SupportsRangeWrite()
+{
+    return true;
+}
+
 int SFTPClient::Rename(const std::string &src, const std::string &dst)
 {
     int rc = libssh2_sftp_rename_ex(sftp_session, src.c_str(), src.length(),
@@ -528,19 +595,19 @@ int SFTPClient::Delete(const std::string &path)
 
 int SFTPClient::Copy(const std::string &from, const std::string &to)
 {
+    // libssh2 has no copy-data extension, callers fall back to streaming between sessions
     sprintf(this->response, "%s", lang_strings[STR_UNSUPPORTED_OPERATION_MSG]);
     return 0;
 }
 
 int SFTPClient::Move(const std::string &from, const std::string &to)
 {
-    sprintf(this->response, "%s", lang_strings[STR_UNSUPPORTED_OPERATION_MSG]);
-    return 0;
+    return Rename(from, to);
 }
 
 int SFTPClient::Head(const std::string &path, void *buffer, uint64_t len)
 {
-    if (!Size(path.c_str(), &bytes_to_download))
+    if (!Size(path.c_str(), xfer_to_download))
     {
         return 0;
     }
@@ -715,6 +782,36 @@ void SFTPClient::Close(void *fp)
     libssh2_sftp_close((LIBSSH2_SFTP_HANDLE *)fp);
 }
 
+void *SFTPClient::OpenWrite(const std::string &path, uint64_t offset)
+{
+    LIBSSH2_SFTP_HANDLE *sftp_handle = libssh2_sftp_open(sftp_session, path.c_str(),
+                                                         LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT | (offset == 0 ? LIBSSH2_FXF_TRUNC : 0),
+                                                         LIBSSH2_SFTP_S_IRUSR | LIBSSH2_SFTP_S_IWUSR |
+                                                             LIBSSH2_SFTP_S_IRGRP | LIBSSH2_SFTP_S_IROTH);
+    if (sftp_handle && offset > 0)
+        libssh2_sftp_seek64(sftp_handle, offset);
+    return sftp_handle;
+}
+
+int SFTPClient::Write(void *fp, const void *buffer, uint64_t size)
+{
+    const char *ptr = (const char *)buffer;
+    while (size > 0)
+    {
+        int rc = libssh2_sftp_write((LIBSSH2_SFTP_HANDLE *)fp, ptr, size);
+        if (rc < 0)
+            return 0;
+        ptr += rc;
+        size -= rc;
+    }
+    return 1;
+}
+
+int SFTPClient::CloseWrite(void *fp)
+{
+    return libssh2_sftp_close((LIBSSH2_SFTP_HANDLE *)fp) == 0;
+}
+
 ClientType SFTPClient::clientType()
 {
     return CLIENT_TYPE_SFTP;
@@ -722,5 +819,5 @@ ClientType SFTPClient::clientType()
 
 uint32_t SFTPClient::SupportedActions()
 {
-    return REMOTE_ACTION_ALL ^ REMOTE_ACTION_CUT ^ REMOTE_ACTION_COPY ^ REMOTE_ACTION_PASTE;
+    return REMOTE_ACTION_ALL;
 }
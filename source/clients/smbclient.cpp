@@ -200,7 +200,7 @@ int SmbClient::Get(const std::string &outputfile, const std::string &ppath, uint
 {
 	std::string path = std::string(ppath);
 	path = Util::Trim(path, "/");
-	if (!Size(path.c_str(), &bytes_to_download))
+	if (!Size(path.c_str(), xfer_to_download))
 	{
 		snprintf(response, sizeof(response), "%s", smb2_get_error(smb2));
 		return 0;
@@ -230,7 +230,7 @@ int SmbClient::Get(const std::string &outputfile, const std::string &ppath, uint
 		return 0;
 	}
 	int count = 0;
-	bytes_transfered = 0;
+	*xfer_transfered = 0;
 	prev_tick = Util::GetTick();
 	while ((count = smb2_read(smb2, in, buff, max_read_size)) != 0)
 	{
@@ -243,7 +243,7 @@ int SmbClient::Get(const std::string &outputfile, const std::string &ppath, uint
 			return 0;
 		}
 		FS::Write(out, buff, count);
-		bytes_transfered += count;
+		*xfer_transfered += count;
 	}
 	FS::Close(out);
 	smb2_close(smb2, in);
@@ -398,14 +398,14 @@ int SmbClient::GetRange(void *fp, void *buffer, uint64_t size, uint64_t offset)
 
 int SmbClient::Copy(const std::string &ffrom, const std::string &tto)
 {
+	// libsmb2 does not expose FSCTL_SRV_COPYCHUNK, callers fall back to streaming between sessions
 	sprintf(response, "%s", lang_strings[STR_UNSUPPORTED_OPERATION_MSG]);
 	return 0;
 }
 
 int SmbClient::Move(const std::string &ffrom, const std::string &tto)
 {
-	sprintf(response, "%s", lang_strings[STR_UNSUPPORTED_OPERATION_MSG]);
-	return 0;
+	return Rename(ffrom, tto);
 }
 
 bool SmbClient::FileExists(const std::string &ppath)
@@ -433,8 +433,8 @@ int SmbClient::Put(const std::string &inputfile, const std::string &ppath, uint6
 	std::string path = std::string(ppath);
 	path = Util::Trim(path, "/");
 
-	bytes_to_download = FS::GetSize(inputfile);
-	if (bytes_to_download < 0)
+	*xfer_to_download = FS::GetSize(inputfile);
+	if (*xfer_to_download < 0)
 	{
 		sprintf(response, "%s", lang_strings[STR_FAILED]);
 		return 0;
@@ -464,7 +464,7 @@ int SmbClient::Put(const std::string &inputfile, const std::string &ppath, uint6
 		return 0;
 	}
 	int count = 0;
-	bytes_transfered = 0;
+	*xfer_transfered = 0;
 	prev_tick = Util::GetTick();
 	while ((count = FS::Read(in, buff, max_write_size)) > 0)
 	{
@@ -484,7 +484,7 @@ int SmbClient::Put(const std::string &inputfile, const std::string &ppath, uint6
 			free(buff);
 			return 0;
 		}
-		bytes_transfered += count;
+		*xfer_transfered += count;
 	}
 	FS::Close(in);
 	smb2_close(smb2, out);
@@ -494,6 +494,68 @@ int SmbClient::Put(const std::string &inputfile, const std::string &ppath, uint6
 
 }
 
+/*
+ * Writes size bytes of inputfile starting at offset to the same offset of the remote file.
+ * The remote file is created when missing but never truncated, a zero size just creates it.
+ */
+int SmbClient::PutRange(const std::string &inputfile, const std::string &ppath, uint64_t offset, uint64_t size)
+{
+	std::string path = std::string(ppath);
+	path = Util::Trim(path, "/");
+
+	FILE* in = FS::OpenRead(inputfile);
+	if (in == NULL)
+	{
+		snprintf(response, sizeof(response), "%s", lang_strings[STR_FAILED]);
+		return 0;
+	}
+
+	struct smb2fh* out = smb2_open(smb2, path.c_str(), O_WRONLY | O_CREAT);
+	if (out == NULL)
+	{
+		snprintf(response, sizeof(response), "%s", smb2_get_error(smb2));
+		FS::Close(in);
+		return 0;
+	}
+
+	uint8_t* buff = (uint8_t*)malloc(max_write_size);
+	if (buff == NULL)
+	{
+		snprintf(response, sizeof(response), "%s", lang_strings[STR_FAILED]);
+		FS::Close(in);
+		smb2_close(smb2, out);
+		return 0;
+	}
+
+	FS::Seek(in, offset);
+	uint64_t remaining = size;
+	*xfer_transfered = 0;
+	while (remaining > 0)
+	{
+		int count = FS::Read(in, buff, MIN(remaining, max_write_size));
+		if (count <= 0)
+			break;
+		if (smb2_pwrite(smb2, out, buff, count, offset) < 0)
+		{
+			snprintf(response, sizeof(response), "%s", smb2_get_error(smb2));
+			break;
+		}
+		offset += count;
+		remaining -= count;
+		*xfer_transfered += count;
+	}
+	FS::Close(in);
+	smb2_close(smb2, out);
+	free(buff);
+
+	return remaining == 0;
+}
+
+bool SmbClient::SupportsRangeWrite()
+{
+	return true;
+}
+
 int SmbClient::Rename(const std::string &src, const std::string &dst)
 {
 	std::string path1 = std::string(src);
@@ -621,7 +683,7 @@ int SmbClient::Head(const std::string &ppath, void *buffer, uint64_t len)
 {
 	std::string path = std::string(ppath);
 	path = Util::Trim(path, "/");
-	if (!Size(path.c_str(), &bytes_to_download))
+	if (!Size(path.c_str(), xfer_to_download))
 	{
 		return 0;
 	}
@@ -647,7 +709,7 @@ ClientType SmbClient::clientType()
 
 uint32_t SmbClient::SupportedActions()
 {
-	return REMOTE_ACTION_ALL ^ REMOTE_ACTION_CUT ^ REMOTE_ACTION_COPY ^ REMOTE_ACTION_PASTE;
+	return REMOTE_ACTION_ALL;
 }
 
 void *SmbClient::Open(const std::string &ppath, int flags)
@@ -663,3 +725,41 @@ void SmbClient::Close(void *fp)
 {
 	smb2_close(smb2, (struct smb2fh *)fp);
 }
+
+void *SmbClient::OpenWrite(const std::string &ppath, uint64_t offset)
+{
+	std::string path = std::string(ppath);
+	path = Util::Trim(path, "/");
+
+	struct smb2fh *out = smb2_open(smb2, path.c_str(), O_WRONLY | O_CREAT | (offset == 0 ? O_TRUNC : 0));
+	if (out == NULL)
+	{
+		snprintf(response, sizeof(response), "%s", smb2_get_error(smb2));
+		return NULL;
+	}
+	if (offset > 0)
+		smb2_lseek(smb2, out, offset, SEEK_SET, NULL);
+	return out;
+}
+
+int SmbClient::Write(void *fp, const void *buffer, uint64_t size)
+{
+	const uint8_t *ptr = (const uint8_t *)buffer;
+	while (size > 0)
+	{
+		int count = smb2_write(smb2, (struct smb2fh *)fp, ptr, MIN(size, max_write_size));
+		if (count < 0)
+		{
+			snprintf(response, sizeof(response), "%s", smb2_get_error(smb2));
+			return 0;
+		}
+		ptr += count;
+		size -= count;
+	}
+	return 1;
+}
+
+int SmbClient::CloseWrite(void *fp)
+{
+	return smb2_close(smb2, (struct smb2fh *)fp) == 0;
+}
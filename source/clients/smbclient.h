@@ -29,6 +29,8 @@ public:
 	int GetRange(void *fp, void *buffer, uint64_t size, uint64_t offset);
 	int GetRange(void *fp, DataSink &sink, uint64_t size, uint64_t offset);
 	int Put(const std::string &inputfile, const std::string &path, uint64_t offset=0);
+	int PutRange(const std::string &inputfile, const std::string &path, uint64_t offset, uint64_t size);
+	bool SupportsRangeWrite();
 	int Rename(const std::string &src, const std::string &dst);
 	int Delete(const std::string &path);
 	bool FileExists(const std::string &path);
@@ -37,6 +39,9 @@ public:
 	int CopyToSocket(const std::string &path, int socket_fd);
 	std::vector<DirEntry> ListDir(const std::string &path);
 	void *Open(const std::string &path, int flags);
+	void *OpenWrite(const std::string &path, uint64_t offset = 0);
+	int Write(void *fp, const void *buffer, uint64_t size);
+	int CloseWrite(void *fp);
 	void Close(void *fp);
 	bool IsConnected();
 	bool Ping();
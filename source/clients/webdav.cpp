@@ -175,10 +175,10 @@ std::vector<DirEntry> WebDAVClient::ListDir(const std::string &path)
 int WebDAVClient::Put(const std::string &inputfile, const std::string &path, uint64_t offset)
 {
     size_t bytes_remaining = FS::GetSize(inputfile);
-    bytes_transfered = 0;
+    *xfer_transfered = 0;
     prev_tick = Util::GetTick();
 
-    client->SetProgressFnCallback(&bytes_transfered, UploadProgressCallback);
+    client->SetProgressFnCallback(xfer_transfered, UploadProgressCallback);
     std::string encode_url = this->host_url + CHTTPClient::EncodeUrl(GetFullPath(path));
     long status;
 
@@ -7,11 +7,13 @@
 #include <regex>
 #include <stdlib.h>
 #include "server/http_server.h"
+#include "server/request_scheduler.h"
 #include "config.h"
 #include "fs.h"
 #include "lang.h"
 #include "crypt.h"
 #include "base64.h"
+#include "transfer_pool.h"
 
 extern "C"
 {
@@ -31,6 +33,7 @@ std::vector<std::string> sites;
 std::vector<std::string> http_servers;
 std::set<std::string> text_file_extensions;
 std::set<std::string> image_file_extensions;
+std::set<std::string> compressed_file_extensions;
 std::map<std::string, RemoteSettings> site_settings;
 PackageUrlInfo install_pkg_url;
 char favorite_urls[MAX_FAVORITE_URLS][512];
@@ -43,6 +46,7 @@ char temp_folder[256];
 std::string ezremote_server_version;
 bool enable_background_download;
 uint64_t minimum_backgrond_file_size;
+int transfer_order;
 
 unsigned char cipher_key[32] = {'s', '5', 'v', '8', 'y', '/', 'B', '?', 'E', '(', 'H', '+', 'M', 'b', 'Q', 'e', 'T', 'h', 'W', 'm', 'Z', 'q', '4', 't', '7', 'w', '9', 'z', '$', 'C', '&', 'F'};
 unsigned char cipher_iv[16] = {'Y', 'p', '3', 's', '6', 'v', '9', 'y', '$', 'B', '&', 'E', ')', 'H', '@', 'M'};
@@ -136,6 +140,8 @@ namespace CONFIG
         http_servers = {HTTP_SERVER_APACHE, HTTP_SERVER_MS_IIS, HTTP_SERVER_NGINX, HTTP_SERVER_NPX_SERVE, HTTP_SERVER_RCLONE, HTTP_SERVER_ARCHIVEORG, HTTP_SERVER_MYRIENT, HTTP_SERVER_GITHUB};
         text_file_extensions = { ".txt", ".ini", ".log", ".json", ".xml", ".html", ".xhtml", ".conf", ".config" };
         image_file_extensions = { ".bmp", ".jpg", ".jpeg", ".png", ".webp" };
+        compressed_file_extensions = { ".pkg", ".jpg", ".jpeg", ".png", ".webp", ".gif", ".mp4", ".mkv", ".mov", ".webm", ".avi",
+                                       ".mp3", ".aac", ".ogg", ".flac", ".zip", ".7z", ".rar", ".gz", ".bz2", ".xz", ".zst", ".lz4" };
 
         OpenIniFile(CONFIG_INI_FILE);
 
@@ -172,6 +178,10 @@ namespace CONFIG
         minimum_backgrond_file_size = ReadLong(CONFIG_GLOBAL, CONFIG_BG_DOWNLOAD_SIZE, 1024*1024*1024);
         WriteLong(CONFIG_GLOBAL, CONFIG_BG_DOWNLOAD_SIZE, minimum_backgrond_file_size);
 
+        transfer_order = ReadInt(CONFIG_GLOBAL, CONFIG_TRANSFER_ORDER, TRANSFER_ORDER_LISTED);
+        transfer_order = MAX(TRANSFER_ORDER_LISTED, MIN(transfer_order, TRANSFER_ORDER_SMALLEST_FIRST));
+        WriteInt(CONFIG_GLOBAL, CONFIG_TRANSFER_ORDER, transfer_order);
+
         if (!FS::FolderExists(temp_folder))
         {
             FS::MkDirs(temp_folder);
@@ -218,6 +228,33 @@ namespace CONFIG
         web_server_enabled = ReadBool(CONFIG_HTTP_SERVER, CONFIG_HTTP_SERVER_ENABLED, true);
         WriteBool(CONFIG_HTTP_SERVER, CONFIG_HTTP_SERVER_ENABLED, web_server_enabled);
 
+        http_server_workers = ReadInt(CONFIG_HTTP_SERVER, CONFIG_HTTP_SERVER_WORKERS, 16);
+        http_server_workers = MAX(1, MIN(http_server_workers, HTTP_SERVER_MAX_WORKERS));
+        WriteInt(CONFIG_HTTP_SERVER, CONFIG_HTTP_SERVER_WORKERS, http_server_workers);
+
+        const char *request_class_keys[REQUEST_CLASS_COUNT] = {CONFIG_HTTP_SERVER_INSTALL_CLASS, CONFIG_HTTP_SERVER_INTERACTIVE_CLASS,
+                                                                CONFIG_HTTP_SERVER_BULK_CLASS, CONFIG_HTTP_SERVER_STREAM_CLASS};
+        for (int i = 0; i < REQUEST_CLASS_COUNT; i++)
+        {
+            RequestClassConfig *class_config = &RequestScheduler::class_config[i];
+            char default_value[64];
+            snprintf(default_value, sizeof(default_value), "%d,%d,%llu", class_config->weight, class_config->max_workers,
+                     (unsigned long long)(class_config->contended_rate / 1024));
+
+            int weight, max_workers;
+            unsigned long long rate_kb;
+            if (sscanf(ReadString(CONFIG_HTTP_SERVER, request_class_keys[i], default_value), "%d,%d,%llu", &weight, &max_workers, &rate_kb) == 3 &&
+                weight > 0 && max_workers > 0)
+            {
+                class_config->weight = weight;
+                class_config->max_workers = max_workers;
+                class_config->contended_rate = rate_kb * 1024;
+            }
+            snprintf(default_value, sizeof(default_value), "%d,%d,%llu", class_config->weight, class_config->max_workers,
+                     (unsigned long long)(class_config->contended_rate / 1024));
+            WriteString(CONFIG_HTTP_SERVER, request_class_keys[i], default_value);
+        }
+
         for (int i = 0; i < sites.size(); i++)
         {
             RemoteSettings setting;
@@ -258,6 +295,10 @@ namespace CONFIG
             setting.enable_disk_cache = ReadBool(sites[i].c_str(), CONFIG_REMOTE_ENABLE_DISK_CACHE, false);
             WriteBool(sites[i].c_str(), CONFIG_REMOTE_ENABLE_DISK_CACHE, setting.enable_disk_cache);
 
+            setting.transfer_sessions = ReadInt(sites[i].c_str(), CONFIG_REMOTE_TRANSFER_SESSIONS, TRANSFER_DEFAULT_SESSIONS);
+            setting.transfer_sessions = MAX(1, MIN(setting.transfer_sessions, TRANSFER_MAX_SESSIONS));
+            WriteInt(sites[i].c_str(), CONFIG_REMOTE_TRANSFER_SESSIONS, setting.transfer_sessions);
+
             sprintf(setting.http_server_type, "%s", ReadString(sites[i].c_str(), CONFIG_REMOTE_HTTP_SERVER_TYPE, HTTP_SERVER_APACHE));
             WriteString(sites[i].c_str(), CONFIG_REMOTE_HTTP_SERVER_TYPE, setting.http_server_type);
 
@@ -298,6 +339,7 @@ namespace CONFIG
         WriteString(last_site, CONFIG_REMOTE_SERVER_PASSWORD, encrypted_text.c_str());
         WriteBool(last_site, CONFIG_ENABLE_RPI, remote_settings->enable_rpi);
         WriteBool(last_site, CONFIG_REMOTE_ENABLE_DISK_CACHE, remote_settings->enable_disk_cache);
+        WriteInt(last_site, CONFIG_REMOTE_TRANSFER_SESSIONS, remote_settings->transfer_sessions);
         WriteString(last_site, CONFIG_REMOTE_HTTP_SERVER_TYPE, remote_settings->http_server_type);
         WriteString(last_site, CONFIG_REMOTE_DEFAULT_DIRECTORY, remote_settings->default_directory);
         WriteString(CONFIG_GLOBAL, CONFIG_LAST_SITE, last_site);
@@ -332,6 +374,7 @@ namespace CONFIG
         WriteBool(CONFIG_HTTP_SERVER, CONFIG_HTTP_SERVER_ENABLED, web_server_enabled);
         WriteBool(CONFIG_GLOBAL, CONFIG_ENABLE_BG_DOWNLOAD, enable_background_download);
         WriteLong(CONFIG_GLOBAL, CONFIG_BG_DOWNLOAD_SIZE, minimum_backgrond_file_size);
+        WriteInt(CONFIG_GLOBAL, CONFIG_TRANSFER_ORDER, transfer_order);
 
         WriteIniFile(CONFIG_INI_FILE);
         CloseIniFile();
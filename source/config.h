@@ -18,6 +18,7 @@
 #define TMP_SFO_PATH DATA_PATH "/tmp_pkg.sfo"
 #define TMP_ICON_PATH DATA_PATH "/tmp_icon.png"
 #define TMP_FOLDER_PATH DATA_PATH "/tmp"
+#define EXTRACT_CHECKPOINT_PATH DATA_PATH "/checkpoints"
 #define CACERT_FILE DATA_PATH "/assets/certs/cacert.pem"
 #define DPI_ELF_PATH DATA_PATH "/ezremote-dpi.elf"
 #define SERVER_ELF_PATH DATA_PATH "/ezremote-server.elf"
@@ -35,6 +36,12 @@
 #define CONFIG_HTTP_SERVER_ENABLED "http_server_enabled"
 #define CONFIG_HTTP_SERVER_COMPRESSED_FILE_PATH "compressed_files_path"
 #define CONFIG_DEFAULT_COMPRESSED_FILE_PATH DATA_PATH "/compressed_files"
+#define CONFIG_HTTP_SERVER_WORKERS "http_server_workers"
+// weight,max_workers,contended_rate_kb of each request class
+#define CONFIG_HTTP_SERVER_INSTALL_CLASS "install_requests"
+#define CONFIG_HTTP_SERVER_INTERACTIVE_CLASS "interactive_requests"
+#define CONFIG_HTTP_SERVER_BULK_CLASS "bulk_requests"
+#define CONFIG_HTTP_SERVER_STREAM_CLASS "stream_requests"
 
 #define CONFIG_REMOTE_SERVER_NAME "remote_server_name"
 #define CONFIG_REMOTE_SERVER_URL "remote_server_url"
@@ -45,6 +52,7 @@
 #define CONFIG_REMOTE_HTTP_SERVER_TYPE "remote_server_http_server_type"
 #define CONFIG_REMOTE_DEFAULT_DIRECTORY "remote_server_default_directory"
 #define CONFIG_REMOTE_ENABLE_DISK_CACHE "remote_server_enable_disk_cache"
+#define CONFIG_REMOTE_TRANSFER_SESSIONS "remote_server_transfer_sessions"
 
 #define CONFIG_ALLDEBRID_API_KEY "alldebrid_api_key"
 #define CONFIG_REALDEBRID_API_KEY "realdebrid_api_key"
@@ -69,6 +77,8 @@
 #define CONFIG_ENABLE_BG_DOWNLOAD "enable_background_download"
 #define CONFIG_BG_DOWNLOAD_SIZE "minimum_backgrond_file_size"
 
+#define CONFIG_TRANSFER_ORDER "transfer_order"
+
 #define HTTP_SERVER_APACHE "Apache"
 #define HTTP_SERVER_MS_IIS "Microsoft IIS"
 #define HTTP_SERVER_NGINX "Nginx"
@@ -94,6 +104,7 @@ struct RemoteSettings
     char http_server_type[24];
     char default_directory[256];
     bool enable_disk_cache;
+    int transfer_sessions;
     RemoteClient *client;
 };
 
@@ -112,6 +123,7 @@ extern std::vector<std::string> sites;
 extern std::vector<std::string> http_servers;
 extern std::set<std::string> text_file_extensions;
 extern std::set<std::string> image_file_extensions;
+extern std::set<std::string> compressed_file_extensions;
 extern std::map<std::string, RemoteSettings> site_settings;
 extern char local_directory[255];
 extern char remote_directory[255];
@@ -135,6 +147,7 @@ extern char temp_folder[256];
 extern std::string ezremote_server_version;
 extern bool enable_background_download;
 extern uint64_t minimum_backgrond_file_size;
+extern int transfer_order;
 
 namespace CONFIG
 {
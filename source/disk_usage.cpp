@@ -0,0 +1,272 @@
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "util.h"
+#include "disk_usage.h"
+
+std::mutex DiskUsage::cache_mutex;
+std::unordered_map<std::string, CachedDirUsage> DiskUsage::cache;
+std::mutex DiskUsage::scans_mutex;
+std::map<std::string, std::shared_ptr<DiskUsage>> DiskUsage::scans;
+
+static std::string JoinPath(const std::string &dir, const char *name)
+{
+    if (!dir.empty() && dir.back() == '/')
+        return dir + name;
+    return dir + "/" + name;
+}
+
+DiskUsage::DiskUsage(const std::string &path)
+{
+    this->path = path;
+    while (this->path.size() > 1 && this->path.back() == '/')
+        this->path.pop_back();
+    this->thread_count = 0;
+    this->running = 0;
+    this->busy = 0;
+    this->dirs = 0;
+    this->finished_at = 0;
+    this->stopped = false;
+}
+
+DiskUsage::~DiskUsage()
+{
+    Stop();
+    for (int i = 0; i < this->thread_count; i++)
+        pthread_join(this->threads[i], NULL);
+}
+
+const std::string &DiskUsage::Path()
+{
+    return this->path;
+}
+
+/*
+ * Lists the folder itself, its entries are the items the sizes add up to,
+ * then starts the walk of its subfolders.
+ */
+int DiskUsage::Start()
+{
+    DIR *fd = opendir(this->path.c_str());
+    if (fd == NULL)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    struct dirent *dirent;
+    while ((dirent = readdir(fd)) != NULL)
+    {
+        if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0)
+            continue;
+
+        DiskUsageItem item;
+        item.name = dirent->d_name;
+        item.path = JoinPath(this->path, dirent->d_name);
+        struct stat file_stat;
+        if (lstat(item.path.c_str(), &file_stat) != 0)
+            continue;
+        item.is_dir = S_ISDIR(file_stat.st_mode);
+        item.size = item.is_dir ? 0 : file_stat.st_size;
+        item.files = item.is_dir ? 0 : 1;
+        if (item.is_dir)
+        {
+            DiskUsageWork dir_work;
+            dir_work.path = item.path;
+            dir_work.item = this->items.size();
+            this->work.push_back(dir_work);
+        }
+        this->items.push_back(item);
+    }
+    closedir(fd);
+    this->dirs = 1;
+
+    if (this->work.empty())
+    {
+        this->finished_at = Util::GetTick();
+        return 1;
+    }
+
+    for (int i = 0; i < DISK_USAGE_THREADS; i++)
+    {
+        if (pthread_create(&this->threads[this->thread_count], NULL, WorkerThread, this) == 0)
+        {
+            this->thread_count++;
+            this->running++;
+        }
+    }
+    return this->thread_count > 0;
+}
+
+void DiskUsage::Stop()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    this->stopped = true;
+    this->work_cond.notify_all();
+}
+
+void DiskUsage::Snapshot(std::vector<DiskUsageItem> &items, DiskUsageStatus &status)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        items = this->items;
+        status.dirs = this->dirs;
+        status.done = (this->finished_at != 0);
+    }
+
+    status.size = 0;
+    status.files = 0;
+    for (std::vector<DiskUsageItem>::iterator it = items.begin(); it != items.end(); ++it)
+    {
+        status.size += it->size;
+        status.files += it->files;
+    }
+    std::sort(items.begin(), items.end(), [](const DiskUsageItem &a, const DiskUsageItem &b) {
+        if (a.size != b.size)
+            return a.size > b.size;
+        return strcasecmp(a.name.c_str(), b.name.c_str()) < 0;
+    });
+}
+
+void *DiskUsage::WorkerThread(void *argp)
+{
+    DiskUsage *usage = (DiskUsage *)argp;
+    usage->Work();
+    return NULL;
+}
+
+void DiskUsage::Work()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        this->work_cond.wait(lock, [this] { return this->stopped || !this->work.empty() || this->busy == 0; });
+        if (this->stopped || this->work.empty())
+            break;
+
+        DiskUsageWork item = this->work.front();
+        this->work.pop_front();
+        this->busy++;
+        lock.unlock();
+        ScanDir(item);
+        lock.lock();
+        this->busy--;
+        if (this->busy == 0 && this->work.empty())
+            this->work_cond.notify_all();
+    }
+
+    this->running--;
+    if (this->running == 0 && this->finished_at == 0)
+        this->finished_at = Util::GetTick();
+}
+
+void DiskUsage::ScanDir(const DiskUsageWork &item)
+{
+    CachedDirUsage usage;
+    if (!ReadDir(item.path, usage))
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    this->items[item.item].size += usage.files_size;
+    this->items[item.item].files += usage.files;
+    this->dirs++;
+    for (std::vector<std::string>::iterator it = usage.subdirs.begin(); it != usage.subdirs.end(); ++it)
+    {
+        DiskUsageWork dir_work;
+        dir_work.path = JoinPath(item.path, it->c_str());
+        dir_work.item = item.item;
+        this->work.push_back(dir_work);
+    }
+    if (!usage.subdirs.empty())
+        this->work_cond.notify_all();
+}
+
+/*
+ * Size of the files directly in a folder and the names of its subfolders,
+ * from the cache while the folder mtime is the same. Links are counted as
+ * files and never followed.
+ */
+bool DiskUsage::ReadDir(const std::string &path, CachedDirUsage &usage)
+{
+    struct stat dir_stat;
+    if (lstat(path.c_str(), &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode))
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        std::unordered_map<std::string, CachedDirUsage>::iterator it = cache.find(path);
+        if (it != cache.end() && it->second.modified == dir_stat.st_mtime)
+        {
+            usage = it->second;
+            return true;
+        }
+    }
+
+    DIR *fd = opendir(path.c_str());
+    if (fd == NULL)
+        return false;
+
+    usage.modified = dir_stat.st_mtime;
+    usage.files_size = 0;
+    usage.files = 0;
+    usage.subdirs.clear();
+    struct dirent *dirent;
+    while ((dirent = readdir(fd)) != NULL)
+    {
+        if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0)
+            continue;
+
+        struct stat file_stat;
+        if (lstat(JoinPath(path, dirent->d_name).c_str(), &file_stat) != 0)
+            continue;
+        if (S_ISDIR(file_stat.st_mode))
+        {
+            usage.subdirs.push_back(dirent->d_name);
+        }
+        else
+        {
+            usage.files_size += file_stat.st_size;
+            usage.files++;
+        }
+    }
+    closedir(fd);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (cache.size() >= DISK_USAGE_CACHE_MAX)
+        cache.clear();
+    cache[path] = usage;
+    return true;
+}
+
+std::shared_ptr<DiskUsage> DiskUsage::Get(const std::string &path)
+{
+    std::shared_ptr<DiskUsage> usage = std::make_shared<DiskUsage>(path);
+    uint64_t now = Util::GetTick();
+
+    std::lock_guard<std::mutex> lock(scans_mutex);
+    std::map<std::string, std::shared_ptr<DiskUsage>>::iterator it = scans.find(usage->Path());
+    if (it != scans.end())
+    {
+        std::lock_guard<std::mutex> scan_lock(it->second->mutex_);
+        if (it->second->finished_at == 0 || now - it->second->finished_at < DISK_USAGE_RESULT_KEEP)
+            return it->second;
+    }
+
+    // Only finished scans are dropped, their threads are already done
+    for (it = scans.begin(); it != scans.end();)
+    {
+        bool finished;
+        {
+            std::lock_guard<std::mutex> scan_lock(it->second->mutex_);
+            finished = (it->second->finished_at != 0);
+        }
+        if (finished && (scans.size() >= DISK_USAGE_MAX_SCANS || it->first == usage->Path()))
+            it = scans.erase(it);
+        else
+            it++;
+    }
+
+    if (!usage->Start())
+        return nullptr;
+    scans[usage->Path()] = usage;
+    return usage;
+}
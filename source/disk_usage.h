@@ -0,0 +1,100 @@
+#ifndef EZ_DISK_USAGE_H
+#define EZ_DISK_USAGE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#define DISK_USAGE_THREADS 4
+#define DISK_USAGE_CACHE_MAX 65536
+#define DISK_USAGE_RESULT_KEEP 5000000
+#define DISK_USAGE_MAX_SCANS 4
+
+struct DiskUsageItem
+{
+    std::string name;
+    std::string path;
+    bool is_dir;
+    uint64_t size;
+    uint64_t files;
+};
+
+struct DiskUsageStatus
+{
+    uint64_t size;
+    uint64_t files;
+    uint64_t dirs;
+    bool done;
+};
+
+struct CachedDirUsage
+{
+    time_t modified;
+    uint64_t files_size;
+    uint64_t files;
+    std::vector<std::string> subdirs;
+};
+
+struct DiskUsageWork
+{
+    std::string path;
+    size_t item;
+};
+
+/*
+ * Recursive size of everything under a local folder, split by its direct
+ * entries so the largest ones can be shown while the walk is still going.
+ * Folders are walked by a few threads sharing a queue. The files and
+ * subfolders of every folder are cached keyed by the folder mtime, a later
+ * scan only reads folders that changed and stats the others. A file that
+ * grows in place doesn't change its folder mtime and is not seen until the
+ * folder changes.
+ */
+class DiskUsage
+{
+public:
+    DiskUsage(const std::string &path);
+    ~DiskUsage();
+    int Start();
+    void Stop();
+    // Direct entries of the folder, largest first
+    void Snapshot(std::vector<DiskUsageItem> &items, DiskUsageStatus &status);
+    const std::string &Path();
+
+    // The scan of a folder, a new one unless one is running or just ended
+    static std::shared_ptr<DiskUsage> Get(const std::string &path);
+
+private:
+    std::string path;
+    std::mutex mutex_;
+    std::condition_variable work_cond;
+    std::deque<DiskUsageWork> work;
+    std::vector<DiskUsageItem> items;
+    pthread_t threads[DISK_USAGE_THREADS];
+    int thread_count;
+    int running;
+    int busy;
+    uint64_t dirs;
+    uint64_t finished_at;
+    bool stopped;
+
+    static void *WorkerThread(void *argp);
+    void Work();
+    void ScanDir(const DiskUsageWork &item);
+
+    static bool ReadDir(const std::string &path, CachedDirUsage &usage);
+    static std::mutex cache_mutex;
+    static std::unordered_map<std::string, CachedDirUsage> cache;
+    static std::mutex scans_mutex;
+    static std::map<std::string, std::shared_ptr<DiskUsage>> scans;
+};
+
+#endif
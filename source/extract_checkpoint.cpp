@@ -0,0 +1,107 @@
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <functional>
+#include "config.h"
+#include "fs.h"
+#include "extract_checkpoint.h"
+
+ExtractCheckpoint::ExtractCheckpoint(const std::string &archive, uint64_t archive_size, const std::string &dest)
+{
+    char name[32];
+    std::string key = archive + "|" + std::to_string(archive_size) + "|" + dest;
+    snprintf(name, sizeof(name), "%016llx.txt", (unsigned long long)std::hash<std::string>()(key));
+    this->path = std::string(EXTRACT_CHECKPOINT_PATH) + "/" + name;
+
+    FILE *in = fopen(this->path.c_str(), "r");
+    if (in != nullptr)
+    {
+        char line[1024];
+        while (fgets(line, sizeof(line), in) != nullptr)
+        {
+            // A line cut short by a crash is ignored
+            size_t len = strlen(line);
+            if (len == 0 || line[len - 1] != '\n')
+                continue;
+            line[len - 1] = 0;
+
+            unsigned long long size;
+            unsigned int crc;
+            int name_start = 0;
+            if (sscanf(line, "%llu %x %n", &size, &crc, &name_start) < 2 || name_start == 0)
+                continue;
+
+            CheckpointRecord record;
+            record.size = size;
+            record.crc = crc;
+            this->records[std::string(line + name_start)] = record;
+        }
+        fclose(in);
+    }
+
+    FS::MkDirs(EXTRACT_CHECKPOINT_PATH);
+    this->fp = fopen(this->path.c_str(), "a");
+}
+
+ExtractCheckpoint::~ExtractCheckpoint()
+{
+    if (this->fp != nullptr)
+        fclose(this->fp);
+}
+
+bool ExtractCheckpoint::HasRecords()
+{
+    return !this->records.empty();
+}
+
+void ExtractCheckpoint::SetExpectedCrc(const std::string &name, uint32_t crc)
+{
+    this->expected_crc[name] = crc;
+}
+
+bool ExtractCheckpoint::IsDone(const std::string &name, uint64_t size, const std::string &path)
+{
+    std::map<std::string, CheckpointRecord>::iterator record = this->records.find(name);
+    if (record == this->records.end() || record->second.size != size)
+        return false;
+
+    std::map<std::string, uint32_t>::iterator crc = this->expected_crc.find(name);
+    if (crc != this->expected_crc.end() && crc->second != record->second.crc)
+        return false;
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size != size)
+        return false;
+
+    return true;
+}
+
+/*
+ * Called by the writer once the file of an entry is closed.
+ */
+void ExtractCheckpoint::Add(const std::string &name, uint64_t size, uint32_t crc)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (this->fp != nullptr && name.find('\n') == std::string::npos)
+        fprintf(this->fp, "%llu %08x %s\n", (unsigned long long)size, crc, name.c_str());
+}
+
+void ExtractCheckpoint::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (this->fp != nullptr)
+        fflush(this->fp);
+}
+
+void ExtractCheckpoint::Remove()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (this->fp != nullptr)
+    {
+        fclose(this->fp);
+        this->fp = nullptr;
+    }
+    unlink(this->path.c_str());
+    this->records.clear();
+}
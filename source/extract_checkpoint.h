@@ -0,0 +1,45 @@
+#ifndef EZ_EXTRACT_CHECKPOINT_H
+#define EZ_EXTRACT_CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <mutex>
+
+struct CheckpointRecord
+{
+    uint64_t size;
+    uint32_t crc;
+};
+
+/*
+ * Entries of an archive already extracted to a folder, kept in a file under
+ * EXTRACT_CHECKPOINT_PATH named after the archive, its size and the folder.
+ * Each entry is appended as "size crc name" once its file is closed, so when an
+ * extraction is cancelled or fails, running it again skips what is done. An entry
+ * counts as done when its size matches the record and the file on disk, and the
+ * crc matches the zip central directory when that is known.
+ * The file is removed when the extraction completes.
+ */
+class ExtractCheckpoint
+{
+public:
+    ExtractCheckpoint(const std::string &archive, uint64_t archive_size, const std::string &dest);
+    ~ExtractCheckpoint();
+    bool HasRecords();
+    void SetExpectedCrc(const std::string &name, uint32_t crc);
+    bool IsDone(const std::string &name, uint64_t size, const std::string &path);
+    void Add(const std::string &name, uint64_t size, uint32_t crc);
+    void Flush();
+    void Remove();
+
+private:
+    std::string path;
+    FILE *fp;
+    std::map<std::string, CheckpointRecord> records;
+    std::map<std::string, uint32_t> expected_crc;
+    std::mutex mutex_;
+};
+
+#endif
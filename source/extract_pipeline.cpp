@@ -0,0 +1,459 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <atomic>
+#include <zlib.h>
+#include "common.h"
+#include "lang.h"
+#include "util.h"
+#include "windows.h"
+#include "extract_pipeline.h"
+
+static std::atomic<uint64_t> total_read_usec(0);
+static std::atomic<uint64_t> total_write_usec(0);
+static std::atomic<uint64_t> total_files(0);
+static std::atomic<uint64_t> total_skipped(0);
+
+static uint64_t ElapsedUsec(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+ExtractPipeline::ExtractPipeline(const std::string &base_dir, ExtractCheckpoint *checkpoint)
+{
+    this->checkpoint = checkpoint;
+    this->written = 0;
+    this->closed = false;
+    this->failed = false;
+    this->batch = nullptr;
+    this->fd = -1;
+    this->dirs.insert(base_dir);
+    this->writer_started = (pthread_create(&this->writer_thread, NULL, WriterThread, this) == 0);
+    this->failed = !this->writer_started;
+}
+
+ExtractPipeline::~ExtractPipeline()
+{
+    Finish();
+    for (int i = 0; i < this->spare.size(); i++)
+    {
+        delete this->spare[i];
+    }
+    this->spare.clear();
+}
+
+ExtractChunk *ExtractPipeline::Acquire()
+{
+    ExtractChunk *chunk = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!this->spare.empty())
+        {
+            chunk = this->spare.back();
+            this->spare.pop_back();
+        }
+    }
+    if (chunk == nullptr)
+        chunk = new ExtractChunk();
+
+    chunk->files.clear();
+    chunk->name.clear();
+    chunk->path.clear();
+    chunk->crc = 0;
+    chunk->data.clear();
+    chunk->first = false;
+    chunk->last = false;
+    chunk->error = false;
+    return chunk;
+}
+
+void ExtractPipeline::Release(ExtractChunk *chunk)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (this->spare.size() < EXTRACT_PIPELINE_MAX_PENDING)
+        this->spare.push_back(chunk);
+    else
+        delete chunk;
+}
+
+int ExtractPipeline::Submit(ExtractChunk *chunk)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (this->pending.size() >= EXTRACT_PIPELINE_MAX_PENDING && !this->failed)
+        {
+            this->space_cv.wait(lock);
+        }
+        if (!this->failed)
+        {
+            this->pending.push_back(chunk);
+            chunk = nullptr;
+        }
+    }
+
+    if (chunk != nullptr)
+    {
+        Release(chunk);
+        return 0;
+    }
+    this->pending_cv.notify_all();
+    return 1;
+}
+
+int ExtractPipeline::FlushBatch()
+{
+    if (this->batch == nullptr)
+        return 1;
+
+    ExtractChunk *chunk = this->batch;
+    this->batch = nullptr;
+    return Submit(chunk);
+}
+
+/*
+ * Fills the chunk with up to len bytes of the current entry, less only at the end
+ * of the entry.
+ */
+ssize_t ExtractPipeline::ReadData(struct archive *a, ExtractChunk *chunk, size_t len, uint32_t *crc)
+{
+    size_t filled = chunk->data.size();
+    chunk->data.resize(filled + len);
+
+    auto start = std::chrono::steady_clock::now();
+    ssize_t read = 0;
+    while (read < len)
+    {
+        ssize_t ret = archive_read_data(a, chunk->data.data() + filled + read, len - read);
+        if (ret < 0)
+        {
+            read = -1;
+            break;
+        }
+        if (ret == 0)
+            break;
+        *crc = crc32(*crc, chunk->data.data() + filled + read, ret);
+        read += ret;
+        bytes_transfered += ret;
+    }
+    total_read_usec += ElapsedUsec(start);
+
+    chunk->data.resize(filled + MAX(read, 0));
+    return read;
+}
+
+/*
+ * Queues the data of a file or symlink entry to be written to path.
+ * Returns 0 once the writer has failed, the extraction can't go on then.
+ */
+int ExtractPipeline::AddEntry(struct archive *a, struct archive_entry *e, const std::string &name, const std::string &path)
+{
+    if (!this->writer_started)
+        return 0;
+
+    if (this->checkpoint != nullptr && archive_entry_size_is_set(e) &&
+        this->checkpoint->IsDone(name, archive_entry_size(e), path))
+    {
+        // Written by an earlier run, libarchive skips or seeks past the data
+        archive_read_data_skip(a);
+        total_skipped++;
+        return 1;
+    }
+
+    const char *linkname = archive_entry_symlink(e);
+    if (linkname != NULL)
+    {
+        if (this->batch == nullptr)
+            this->batch = Acquire();
+        ExtractFile file;
+        file.name = name;
+        file.path = path;
+        file.link = linkname;
+        file.crc = 0;
+        file.offset = this->batch->data.size();
+        file.len = 0;
+        this->batch->files.push_back(file);
+        archive_read_data_skip(a);
+        return this->batch->files.size() >= EXTRACT_PIPELINE_BATCH_FILES ? FlushBatch() : 1;
+    }
+
+    bytes_to_download = archive_entry_size(e);
+    bytes_transfered = 0;
+    prev_tick = Util::GetTick();
+
+    uint32_t crc = crc32(0L, Z_NULL, 0);
+    ExtractChunk *chunk = Acquire();
+    chunk->name = name;
+    chunk->path = path;
+    chunk->first = true;
+    while (true)
+    {
+        ssize_t read = ReadData(a, chunk, EXTRACT_PIPELINE_CHUNK_SIZE, &crc);
+        if (read < 0)
+        {
+            snprintf(status_message, 1024, "error archive_read_data('%s')", path.c_str());
+            chunk->error = true;
+        }
+        bool eof = (read < EXTRACT_PIPELINE_CHUNK_SIZE);
+
+        if (eof && read >= 0 && chunk->first && chunk->data.size() <= EXTRACT_PIPELINE_SMALL_FILE)
+        {
+            // Whole small file, goes out with the next batch
+            if (this->batch == nullptr)
+                this->batch = Acquire();
+            ExtractFile file;
+            file.name = name;
+            file.path = path;
+            file.crc = crc;
+            file.offset = this->batch->data.size();
+            file.len = chunk->data.size();
+            this->batch->data.insert(this->batch->data.end(), chunk->data.begin(), chunk->data.end());
+            this->batch->files.push_back(file);
+            Release(chunk);
+
+            if (this->batch->files.size() >= EXTRACT_PIPELINE_BATCH_FILES ||
+                this->batch->data.size() >= EXTRACT_PIPELINE_CHUNK_SIZE)
+                return FlushBatch();
+            return 1;
+        }
+
+        // Files queued earlier must not be written after this one
+        if (chunk->first && !FlushBatch())
+        {
+            Release(chunk);
+            return 0;
+        }
+
+        chunk->last = eof;
+        chunk->crc = crc;
+        if (!Submit(chunk))
+            return 0;
+        if (eof)
+            return 1;
+
+        chunk = Acquire();
+        chunk->name = name;
+        chunk->path = path;
+    }
+
+    return 1;
+}
+
+/*
+ * Waits for the writer to drain the queue. Returns 0 if any write failed.
+ */
+int ExtractPipeline::Finish()
+{
+    if (this->writer_started)
+    {
+        FlushBatch();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            this->closed = true;
+        }
+        this->pending_cv.notify_all();
+        pthread_join(this->writer_thread, NULL);
+        this->writer_started = false;
+    }
+    if (this->batch != nullptr)
+    {
+        Release(this->batch);
+        this->batch = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !this->failed;
+}
+
+void *ExtractPipeline::WriterThread(void *argp)
+{
+    ExtractPipeline *pipeline = (ExtractPipeline *)argp;
+    pipeline->Write();
+    return NULL;
+}
+
+void ExtractPipeline::Write()
+{
+    bool failed = false;
+    while (true)
+    {
+        ExtractChunk *chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (this->pending.empty() && !this->closed)
+            {
+                this->pending_cv.wait(lock);
+            }
+            if (this->pending.empty())
+                break;
+            chunk = this->pending.front();
+            this->pending.pop_front();
+        }
+        this->space_cv.notify_all();
+
+        // After a failure the queue is only drained, so the reader never blocks
+        if (!failed)
+        {
+            auto start = std::chrono::steady_clock::now();
+            failed = !WriteChunk(chunk);
+            if (this->checkpoint != nullptr)
+                this->checkpoint->Flush();
+            total_write_usec += ElapsedUsec(start);
+            if (failed)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                this->failed = true;
+            }
+            this->space_cv.notify_all();
+        }
+        Release(chunk);
+    }
+
+    if (this->fd >= 0)
+    {
+        close(this->fd);
+        this->fd = -1;
+    }
+}
+
+int ExtractPipeline::WriteChunk(ExtractChunk *chunk)
+{
+    if (!chunk->files.empty())
+    {
+        for (std::vector<ExtractFile>::iterator it = chunk->files.begin(); it != chunk->files.end(); ++it)
+        {
+            MakeParent(it->path);
+            if (!it->link.empty())
+            {
+                unlink(it->path.c_str());
+                if (symlink(it->link.c_str(), it->path.c_str()) != 0)
+                    snprintf(status_message, 1024, "error symlink('%s')", it->path.c_str());
+                else
+                    total_files++;
+                continue;
+            }
+            int ret = WriteFile(it->path, chunk->data.data() + it->offset, it->len);
+            if (ret == 0)
+                return 0;
+            if (ret > 0 && this->checkpoint != nullptr)
+                this->checkpoint->Add(it->name, it->len, it->crc);
+        }
+        return 1;
+    }
+
+    if (chunk->first)
+    {
+        this->written = 0;
+        MakeParent(chunk->path);
+        this->fd = open(chunk->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0777);
+        if (this->fd < 0)
+        {
+            // Replaces a symlink or whatever else is in the way
+            unlink(chunk->path.c_str());
+            this->fd = open(chunk->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0777);
+        }
+        if (this->fd < 0)
+            snprintf(status_message, 1024, "error open('%s')", chunk->path.c_str());
+    }
+
+    // A file that couldn't be opened is skipped, like before
+    if (this->fd < 0)
+        return 1;
+
+    if (write(this->fd, chunk->data.data(), chunk->data.size()) != chunk->data.size())
+    {
+        snprintf(status_message, 1024, "error write('%s')", chunk->path.c_str());
+        close(this->fd);
+        this->fd = -1;
+        return 0;
+    }
+    this->written += chunk->data.size();
+
+    if (chunk->last)
+    {
+        close(this->fd);
+        this->fd = -1;
+        total_files++;
+        if (!chunk->error && this->checkpoint != nullptr)
+            this->checkpoint->Add(chunk->name, this->written, chunk->crc);
+    }
+    return 1;
+}
+
+/*
+ * Returns 0 when the write failed and -1 when the file couldn't be opened, it is
+ * skipped then.
+ */
+
+int ExtractPipeline::WriteFile(const std::string &path, const uint8_t *data, size_t len)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0777);
+    if (fd < 0)
+    {
+        unlink(path.c_str());
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0777);
+    }
+    if (fd < 0)
+    {
+        snprintf(status_message, 1024, "error open('%s')", path.c_str());
+        return -1;
+    }
+
+    if (len > 0 && write(fd, data, len) != len)
+    {
+        snprintf(status_message, 1024, "error write('%s')", path.c_str());
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    total_files++;
+    return 1;
+}
+
+/*
+ * Creates the missing parents of path. Folders made or found before are
+ * remembered, so a folder costs one mkdir for all the files in it.
+ */
+int ExtractPipeline::MakeParent(const std::string &path)
+{
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos || slash == 0)
+        return 1;
+
+    std::string dir = path.substr(0, slash);
+    if (this->dirs.find(dir) != this->dirs.end())
+        return 1;
+
+    if (!MakeParent(dir))
+        return 0;
+    if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST)
+        return 0;
+    this->dirs.insert(dir);
+    return 1;
+}
+
+void ExtractPipeline::ResetTotals()
+{
+    total_read_usec = 0;
+    total_write_usec = 0;
+    total_files = 0;
+    total_skipped = 0;
+}
+
+/*
+ * Time spent decompressing against time spent writing, and the entries skipped
+ * thanks to a checkpoint, over every archive extracted since ResetTotals().
+ */
+std::string ExtractPipeline::Summary()
+{
+    char summary[256];
+    int len = snprintf(summary, sizeof(summary), "%s: %.1fs, %s: %.1fs, %s: %llu", lang_strings[STR_DECOMPRESS],
+                       total_read_usec / 1000000.0, lang_strings[STR_WRITE], total_write_usec / 1000000.0,
+                       lang_strings[STR_FILES], (unsigned long long)total_files);
+    if (total_skipped > 0 && len < sizeof(summary))
+        snprintf(summary + len, sizeof(summary) - len, ", %s: %llu", lang_strings[STR_SKIPPED],
+                 (unsigned long long)total_skipped);
+    return std::string(summary);
+}
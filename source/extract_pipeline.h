@@ -0,0 +1,93 @@
+#ifndef EZ_EXTRACT_PIPELINE_H
+#define EZ_EXTRACT_PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+#include <archive.h>
+#include <archive_entry.h>
+#include "extract_checkpoint.h"
+
+#define EXTRACT_PIPELINE_CHUNK_SIZE 1048576
+#define EXTRACT_PIPELINE_MAX_PENDING 8
+#define EXTRACT_PIPELINE_SMALL_FILE 65536
+#define EXTRACT_PIPELINE_BATCH_FILES 256
+
+struct ExtractFile
+{
+    std::string name;
+    std::string path;
+    std::string link;
+    uint32_t crc;
+    size_t offset;
+    size_t len;
+};
+
+struct ExtractChunk
+{
+    // Whole small files and symlinks, their data packed one after the other
+    std::vector<ExtractFile> files;
+    // Otherwise a piece of one large file, crc is set on the last piece
+    std::string name;
+    std::string path;
+    uint32_t crc;
+    bool first;
+    bool last;
+    bool error;
+    std::vector<uint8_t> data;
+};
+
+/*
+ * Extracts archive entries with decompression and disk writes on separate threads.
+ * The caller's thread runs libarchive and hands the data over a bounded queue to a
+ * writer thread, so one stage works while the other waits on its syscalls.
+ * Small files are read whole and queued in batches, large files are queued in
+ * chunks. The writer remembers the directories it created, so parents are made
+ * once per folder instead of a stat of every path component per file.
+ * With a checkpoint, entries it has as done are skipped and every file written is
+ * recorded in it.
+ * Time spent in each stage is added to totals reported by Summary().
+ */
+class ExtractPipeline
+{
+public:
+    ExtractPipeline(const std::string &base_dir, ExtractCheckpoint *checkpoint = nullptr);
+    ~ExtractPipeline();
+    int AddEntry(struct archive *a, struct archive_entry *e, const std::string &name, const std::string &path);
+    int Finish();
+    static void ResetTotals();
+    static std::string Summary();
+
+private:
+    pthread_t writer_thread;
+    bool writer_started;
+    bool closed;
+    bool failed;
+    std::deque<ExtractChunk *> pending;
+    std::vector<ExtractChunk *> spare;
+    ExtractChunk *batch;
+    std::unordered_set<std::string> dirs;
+    int fd;
+    uint64_t written;
+    ExtractCheckpoint *checkpoint;
+    std::mutex mutex_;
+    std::condition_variable pending_cv;
+    std::condition_variable space_cv;
+
+    ExtractChunk *Acquire();
+    void Release(ExtractChunk *chunk);
+    int Submit(ExtractChunk *chunk);
+    int FlushBatch();
+    ssize_t ReadData(struct archive *a, ExtractChunk *chunk, size_t len, uint32_t *crc);
+    static void *WriterThread(void *argp);
+    void Write();
+    int WriteChunk(ExtractChunk *chunk);
+    int WriteFile(const std::string &path, const uint8_t *data, size_t len);
+    int MakeParent(const std::string &path);
+};
+
+#endif
@@ -1,4 +1,13 @@
 #include "httplib.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#else
+#include <sys/uio.h>
+#endif
+#endif
 namespace httplib {
 
 /*
@@ -550,6 +559,17 @@ public:
   void get_remote_ip_and_port(std::string &ip, int &port) const override;
   void get_local_ip_and_port(std::string &ip, int &port) const override;
   socket_t socket() const override;
+  bool can_send_file() const override;
+  ssize_t send_file(int fd, size_t offset, size_t length) override;
+
+  void set_write_throttle(const WriteThrottle &throttle) {
+    write_throttle_ = throttle;
+  }
+
+  // Bytes already read from the socket but not handed out yet
+  bool has_buffered_data() const {
+    return read_buff_off_ < read_buff_content_size_;
+  }
 
 private:
   socket_t sock_;
@@ -563,6 +583,8 @@ private:
   size_t read_buff_content_size_ = 0;
 
   static const size_t read_buff_size_ = 1024 * 512;
+
+  WriteThrottle write_throttle_;
 };
 
 #ifdef CPPHTTPLIB_OPENSSL_SUPPORT
@@ -1761,6 +1783,22 @@ bool write_content(Stream &strm, const ContentProvider &content_provider,
     return ok;
   };
 
+  if (strm.can_send_file()) {
+    data_sink.send_file = [&](int fd, size_t off, size_t l) -> bool {
+      while (ok && l > 0) {
+        auto n = strm.send_file(fd, off, l);
+        if (n <= 0) {
+          ok = false;
+        } else {
+          offset += static_cast<size_t>(n);
+          off += static_cast<size_t>(n);
+          l -= static_cast<size_t>(n);
+        }
+      }
+      return ok;
+    };
+  }
+
   while (offset < end_offset && !is_shutting_down()) {
     if (!strm.is_writable()) {
       error = Error::Write;
@@ -3015,6 +3053,68 @@ void Response::set_chunked_content_provider(
   is_chunked_content_provider_ = true;
 }
 
+bool Response::set_file_content(const std::string &path,
+                                const std::string &content_type) {
+#ifdef _WIN32
+  auto fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+  auto fd = ::open(path.c_str(), O_RDONLY);
+#endif
+  if (fd < 0) { return false; }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+    return false;
+  }
+
+  if (st.st_size == 0) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+    set_content(std::string(), content_type);
+    return true;
+  }
+
+  set_content_provider(
+      static_cast<size_t>(st.st_size), content_type,
+      [fd](size_t offset, size_t length, DataSink &sink) {
+        return send_file_range(fd, offset, length, sink);
+      },
+      [fd](bool /*success*/) {
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+      });
+  return true;
+}
+
+bool send_file_range(int fd, size_t offset, size_t length, DataSink &sink) {
+  length = (std::min)(length, CPPHTTPLIB_SEND_FILE_CHUNK_SIZE);
+  if (length == 0) { return false; }
+  if (sink.send_file) { return sink.send_file(fd, offset, length); }
+
+  std::vector<char> buf((std::min)(length, CPPHTTPLIB_RECV_BUFSIZ));
+#ifdef _WIN32
+  if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+    return false;
+  }
+  auto n = _read(fd, buf.data(), static_cast<unsigned int>(buf.size()));
+#else
+  auto n = ::pread(fd, buf.data(), buf.size(), static_cast<off_t>(offset));
+#endif
+  if (n <= 0) { return false; }
+  return sink.write(buf.data(), static_cast<size_t>(n));
+}
+
 // Result implementation
 bool Result::has_request_header(const std::string &key) const {
   return request_headers_.find(key) != request_headers_.end();
@@ -3110,6 +3210,7 @@ ssize_t SocketStream::read(char *ptr, size_t size) {
 }
 
 ssize_t SocketStream::write(const char *ptr, size_t size) {
+  if (write_throttle_) { size = write_throttle_(size); }
   if (!is_writable()) { return -1; }
 
 #if defined(_WIN32) && !defined(_WIN64)
@@ -3132,6 +3233,44 @@ void SocketStream::get_local_ip_and_port(std::string &ip,
 
 socket_t SocketStream::socket() const { return sock_; }
 
+bool SocketStream::can_send_file() const {
+#if defined(_WIN32) || defined(CPPHTTPLIB_NO_SENDFILE)
+  return false;
+#else
+  return true;
+#endif
+}
+
+// Sends file data straight from the page cache, so it is never copied through
+// a user space buffer. Returns the bytes sent, or -1 on error.
+ssize_t SocketStream::send_file(int fd, size_t offset, size_t length) {
+#if defined(_WIN32) || defined(CPPHTTPLIB_NO_SENDFILE)
+  (void)fd;
+  (void)offset;
+  (void)length;
+  return -1;
+#else
+  if (write_throttle_) { length = write_throttle_(length); }
+  while (true) {
+    if (!is_writable()) { return -1; }
+
+#if defined(__linux__)
+    auto off = static_cast<off_t>(offset);
+    auto ret = sendfile(sock_, fd, &off, length);
+    if (ret > 0) { return ret; }
+    if (ret == 0) { return -1; }
+#else
+    off_t sent = 0;
+    auto ret = sendfile(fd, sock_, static_cast<off_t>(offset), length, nullptr,
+                        &sent, 0);
+    if (sent > 0) { return static_cast<ssize_t>(sent); }
+    if (ret == 0) { return -1; }
+#endif
+    if (errno != EINTR && errno != EAGAIN) { return -1; }
+  }
+#endif
+}
+
 // Buffer stream implementation
 bool BufferStream::is_readable() const { return true; }
 
@@ -3472,6 +3611,11 @@ Server &Server::set_payload_max_length(size_t length) {
   return *this;
 }
 
+Server &Server::set_write_throttle(WriteThrottle throttle) {
+  write_throttle_ = std::move(throttle);
+  return *this;
+}
+
 bool Server::bind_to_port(const std::string &host, int port,
                                  int socket_flags) {
   if (bind_internal(host, port, socket_flags) < 0) return false;
@@ -3826,10 +3970,13 @@ bool Server::handle_file_request(const Request &req, Response &res,
         if (path.back() == '/') { path += "index.html"; }
 
         if (detail::is_file(path)) {
-          detail::read_file(path, res.body);
           auto type =
               detail::find_content_type(path, file_extension_and_mimetype_map_);
-          if (type) { res.set_header("Content-Type", type); }
+          // Served from the file descriptor, the file is not read into memory
+          if (!res.set_file_content(path, type ? type : "text/plain")) {
+            detail::read_file(path, res.body);
+            if (type) { res.set_header("Content-Type", type); }
+          }
           for (const auto &kv : entry.headers) {
             res.set_header(kv.first.c_str(), kv.second);
           }
@@ -3887,6 +4034,42 @@ int Server::bind_internal(const std::string &host, int port,
   }
 }
 
+void Server::configure_accepted_socket(socket_t sock) {
+  {
+#ifdef _WIN32
+    auto timeout = static_cast<uint32_t>(read_timeout_sec_ * 1000 +
+                                         read_timeout_usec_ / 1000);
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO,
+               reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+#else
+    timeval tv;
+    tv.tv_sec = static_cast<long>(read_timeout_sec_);
+    tv.tv_usec = static_cast<decltype(tv.tv_usec)>(read_timeout_usec_);
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO,
+               reinterpret_cast<const void *>(&tv), sizeof(tv));
+#endif
+  }
+  {
+
+#ifdef _WIN32
+    auto timeout = static_cast<uint32_t>(write_timeout_sec_ * 1000 +
+                                         write_timeout_usec_ / 1000);
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO,
+               reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+#else
+    timeval tv;
+    tv.tv_sec = static_cast<long>(write_timeout_sec_);
+    tv.tv_usec = static_cast<decltype(tv.tv_usec)>(write_timeout_usec_);
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO,
+               reinterpret_cast<const void *>(&tv), sizeof(tv));
+#endif
+  }
+
+  int const size = 1048576;
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+}
+
 bool Server::listen_internal() {
   auto ret = true;
   is_running_ = true;
@@ -3895,6 +4078,24 @@ bool Server::listen_internal() {
   {
     std::unique_ptr<TaskQueue> task_queue(new_task_queue());
 
+#ifndef _WIN32
+    if (parks_idle_connections() && pipe(wake_fds_) == 0) {
+      fcntl(wake_fds_[0], F_SETFL, O_NONBLOCK);
+      fcntl(wake_fds_[1], F_SETFL, O_NONBLOCK);
+      ret = run_event_loop(*task_queue);
+      task_queue->shutdown();
+      for (auto &p : parked_) {
+        detail::shutdown_socket(p.sock);
+        detail::close_socket(p.sock);
+      }
+      parked_.clear();
+      close(wake_fds_[0]);
+      close(wake_fds_[1]);
+      wake_fds_[0] = wake_fds_[1] = -1;
+      return ret;
+    }
+#endif
+
     while (svr_sock_ != INVALID_SOCKET) {
 #ifndef _WIN32
       if (idle_interval_sec_ > 0 || idle_interval_usec_ > 0) {
@@ -3928,40 +4129,7 @@ bool Server::listen_internal() {
         break;
       }
 
-      {
-#ifdef _WIN32
-        auto timeout = static_cast<uint32_t>(read_timeout_sec_ * 1000 +
-                                             read_timeout_usec_ / 1000);
-        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO,
-                   reinterpret_cast<const char *>(&timeout), sizeof(timeout));
-#else
-        timeval tv;
-        tv.tv_sec = static_cast<long>(read_timeout_sec_);
-        tv.tv_usec = static_cast<decltype(tv.tv_usec)>(read_timeout_usec_);
-        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO,
-                   reinterpret_cast<const void *>(&tv), sizeof(tv));
-#endif
-      }
-      {
-
-#ifdef _WIN32
-        auto timeout = static_cast<uint32_t>(write_timeout_sec_ * 1000 +
-                                             write_timeout_usec_ / 1000);
-        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO,
-                   reinterpret_cast<const char *>(&timeout), sizeof(timeout));
-#else
-        timeval tv;
-        tv.tv_sec = static_cast<long>(write_timeout_sec_);
-        tv.tv_usec = static_cast<decltype(tv.tv_usec)>(write_timeout_usec_);
-        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO,
-                   reinterpret_cast<const void *>(&tv), sizeof(tv));
-#endif
-      }
-
-      int const size = 1048576;
-      setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
-      setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
-
+      configure_accepted_socket(sock);
       task_queue->enqueue([this, sock]() { process_and_close_socket(sock); });
     }
 
@@ -4323,6 +4491,159 @@ Server::process_request(Stream &strm, bool close_connection,
 
 bool Server::is_valid() const { return true; }
 
+#ifndef _WIN32
+// Accepts a pending connection and adds it to the polled ones, it is queued
+// once its first request arrives. Returns false when the listening socket
+// failed, closed is set when it was stopped.
+bool Server::accept_one(std::vector<ParkedSocket> &idle, bool &closed) {
+  socket_t sock = accept(svr_sock_, nullptr, nullptr);
+  if (sock == INVALID_SOCKET) {
+    if (errno == EMFILE) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      return true;
+    } else if (errno == EINTR || errno == EAGAIN) {
+      return true;
+    }
+    closed = true;
+    if (svr_sock_ != INVALID_SOCKET) {
+      detail::close_socket(svr_sock_);
+      return false;
+    }
+    return true;
+  }
+
+  configure_accepted_socket(sock);
+  idle.push_back({sock, keep_alive_max_count_,
+                  std::chrono::steady_clock::now() +
+                      std::chrono::seconds(read_timeout_sec_) +
+                      std::chrono::microseconds(read_timeout_usec_)});
+  return true;
+}
+
+// The request line of a readable connection, read without consuming it
+static std::string peek_request_line(socket_t sock) {
+  char buf[512];
+  auto n = recv(sock, buf, sizeof(buf), MSG_PEEK);
+  if (n <= 0) { return std::string(); }
+  auto len = static_cast<size_t>(n);
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] == '\r' || buf[i] == '\n') { return std::string(buf, i); }
+  }
+  return std::string(buf, len);
+}
+
+// Polls the listening socket and the idle keep-alive connections. A worker
+// thread is only taken once a request arrives, so connections sitting
+// between requests cost a pollfd rather than a thread and its stack.
+bool Server::run_event_loop(TaskQueue &task_queue) {
+  std::vector<ParkedSocket> idle;
+  std::vector<struct pollfd> pfds;
+  auto ret = true;
+
+  while (svr_sock_ != INVALID_SOCKET) {
+    {
+      std::lock_guard<std::mutex> guard(parked_mutex_);
+      idle.insert(idle.end(), parked_.begin(), parked_.end());
+      parked_.clear();
+    }
+
+    pfds.clear();
+    pfds.push_back({svr_sock_, POLLIN, 0});
+    pfds.push_back({wake_fds_[0], POLLIN, 0});
+    for (const auto &p : idle) {
+      pfds.push_back({p.sock, POLLIN, 0});
+    }
+
+    auto val = poll(pfds.data(), static_cast<nfds_t>(pfds.size()), 100);
+    if (val < 0) {
+      if (errno == EINTR) { continue; }
+      break;
+    }
+    if (val == 0) { task_queue.on_idle(); }
+
+    if (pfds[0].revents & (POLLERR | POLLNVAL)) { break; }
+    if (pfds[0].revents & POLLIN) {
+      auto closed = false;
+      if (!accept_one(idle, closed)) {
+        ret = false;
+        break;
+      }
+      if (closed) { break; }
+    }
+
+    if (pfds[1].revents & POLLIN) {
+      char buf[64];
+      while (read(wake_fds_[0], buf, sizeof(buf)) > 0) {}
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    size_t n = 0;
+    for (size_t i = 0; i < idle.size(); i++) {
+      auto p = idle[i];
+      // A connection accepted in this round is not polled yet
+      auto revents = i + 2 < pfds.size() ? pfds[i + 2].revents : 0;
+      if (revents & POLLIN) {
+        task_queue.enqueue_request(
+            [this, p]() { process_and_park_socket(p.sock, p.count); },
+            peek_request_line(p.sock));
+      } else if (revents || now >= p.deadline) {
+        detail::shutdown_socket(p.sock);
+        detail::close_socket(p.sock);
+      } else {
+        idle[n++] = p;
+      }
+    }
+    idle.resize(n);
+  }
+
+  for (auto &p : idle) {
+    detail::shutdown_socket(p.sock);
+    detail::close_socket(p.sock);
+  }
+  return ret;
+}
+
+// Serves one request, then hands a kept alive connection back to the event
+// loop instead of waiting on it here. Pipelined requests already read into
+// the stream buffer would be lost once it is gone, they are served first.
+void Server::process_and_park_socket(socket_t sock, size_t count) {
+  auto close_connection = count == 1;
+  auto connection_closed = false;
+  auto ret = false;
+  {
+    detail::SocketStream strm(sock, read_timeout_sec_, read_timeout_usec_,
+                              write_timeout_sec_, write_timeout_usec_);
+    strm.set_write_throttle(write_throttle_);
+    ret = process_request(strm, close_connection, connection_closed, nullptr);
+    while (ret && !connection_closed && count > 1 &&
+           strm.has_buffered_data()) {
+      count--;
+      close_connection = count == 1;
+      ret = process_request(strm, close_connection, connection_closed,
+                            nullptr);
+    }
+  }
+
+  if (ret && !connection_closed && count > 1 &&
+      svr_sock_ != INVALID_SOCKET) {
+    {
+      std::lock_guard<std::mutex> guard(parked_mutex_);
+      parked_.push_back({sock, count - 1,
+                         std::chrono::steady_clock::now() +
+                             std::chrono::seconds(keep_alive_timeout_sec_)});
+    }
+    char c = 0;
+    if (write(wake_fds_[1], &c, 1) < 0) {}
+    return;
+  }
+
+  detail::shutdown_socket(sock);
+  detail::close_socket(sock);
+}
+#endif
+
+bool Server::parks_idle_connections() const { return true; }
+
 bool Server::process_and_close_socket(socket_t sock) {
   auto ret = detail::process_server_socket(
       svr_sock_, sock, keep_alive_max_count_, keep_alive_timeout_sec_,
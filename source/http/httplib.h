@@ -105,6 +105,10 @@
 #define CPPHTTPLIB_RECV_FLAGS 0
 #endif
 
+#ifndef CPPHTTPLIB_SEND_FILE_CHUNK_SIZE
+#define CPPHTTPLIB_SEND_FILE_CHUNK_SIZE size_t(4194304u)
+#endif
+
 #ifndef CPPHTTPLIB_SEND_FLAGS
 #define CPPHTTPLIB_SEND_FLAGS 0
 #endif
@@ -382,6 +386,8 @@ public:
   DataSink &operator=(DataSink &&) = delete;
 
   std::function<bool(const char *data, size_t data_len)> write;
+  // Set when the connection can take file data with sendfile, bypassing write
+  std::function<bool(int fd, size_t offset, size_t length)> send_file;
   std::function<void()> done;
   std::function<void(const Headers &trailer)> done_with_trailer;
   std::ostream os;
@@ -509,6 +515,10 @@ struct Request {
   size_t authorization_count_ = 0;
 };
 
+// Writes up to CPPHTTPLIB_SEND_FILE_CHUNK_SIZE bytes of fd at offset to the sink,
+// with sendfile when the connection allows it
+bool send_file_range(int fd, size_t offset, size_t length, DataSink &sink);
+
 struct Response {
   std::string version;
   int status = -1;
@@ -540,6 +550,9 @@ struct Response {
       const std::string &content_type, ContentProviderWithoutLength provider,
       ContentProviderResourceReleaser resource_releaser = nullptr);
 
+  bool set_file_content(const std::string &path,
+                        const std::string &content_type);
+
   Response() = default;
   Response(const Response &) = default;
   Response &operator=(const Response &) = default;
@@ -571,6 +584,11 @@ public:
   virtual void get_remote_ip_and_port(std::string &ip, int &port) const = 0;
   virtual void get_local_ip_and_port(std::string &ip, int &port) const = 0;
   virtual socket_t socket() const = 0;
+  virtual bool can_send_file() const { return false; }
+  virtual ssize_t send_file(int /*fd*/, size_t /*offset*/,
+                            size_t /*length*/) {
+    return -1;
+  }
 
   template <typename... Args>
   ssize_t write_format(const char *fmt, const Args &...args);
@@ -586,6 +604,13 @@ public:
   virtual void enqueue(std::function<void()> fn) = 0;
   virtual void shutdown() = 0;
 
+  // Used when the request line of the connection is already known, so a
+  // queue can schedule by route
+  virtual void enqueue_request(std::function<void()> fn,
+                               const std::string & /*request_line*/) {
+    enqueue(std::move(fn));
+  }
+
   virtual void on_idle() {}
 };
 
@@ -666,6 +691,10 @@ using Logger = std::function<void(const Request &, const Response &)>;
 
 using SocketOptions = std::function<void(socket_t sock)>;
 
+// Given the size of a pending socket write, may wait and returns how much of
+// it can be sent now
+using WriteThrottle = std::function<size_t(size_t size)>;
+
 void default_socket_options(socket_t sock);
 
 namespace detail {
@@ -816,6 +845,8 @@ public:
 
   Server &set_payload_max_length(size_t length);
 
+  Server &set_write_throttle(WriteThrottle throttle);
+
   bool bind_to_port(const std::string &host, int port, int socket_flags = 0);
   int bind_to_any_port(const std::string &host, int socket_flags = 0);
   bool listen_after_bind();
@@ -843,6 +874,7 @@ protected:
   time_t idle_interval_sec_ = CPPHTTPLIB_IDLE_INTERVAL_SECOND;
   time_t idle_interval_usec_ = CPPHTTPLIB_IDLE_INTERVAL_USECOND;
   size_t payload_max_length_ = CPPHTTPLIB_PAYLOAD_MAX_LENGTH;
+  WriteThrottle write_throttle_;
 
 private:
   using Handlers =
@@ -894,6 +926,24 @@ private:
                          ContentReceiver multipart_receiver);
 
   virtual bool process_and_close_socket(socket_t sock);
+  virtual bool parks_idle_connections() const;
+
+  // Connections waiting for their next request. Workers hand them back here
+  // and the event loop polls them instead of a thread blocking on each one.
+  struct ParkedSocket {
+    socket_t sock;
+    size_t count;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  void configure_accepted_socket(socket_t sock);
+  bool accept_one(std::vector<ParkedSocket> &idle, bool &closed);
+  bool run_event_loop(TaskQueue &task_queue);
+  void process_and_park_socket(socket_t sock, size_t count);
+
+  std::mutex parked_mutex_;
+  std::vector<ParkedSocket> parked_;
+  int wake_fds_[2] = {-1, -1};
 
   std::atomic<bool> is_running_{false};
   std::atomic<bool> done_{false};
@@ -1628,6 +1678,7 @@ public:
 
 private:
   bool process_and_close_socket(socket_t sock) override;
+  bool parks_idle_connections() const override { return false; }
 
   SSL_CTX *ctx_;
   std::mutex ctx_mutex_;
@@ -257,12 +257,20 @@ namespace INSTALLER
 	void *CleanArchivePkgDataThread(void *argp)
 	{
 		ArchivePkgInstallData *archive_pkg_data = (ArchivePkgInstallData*)argp;
+		if (archive_pkg_data->direct)
+		{
+			archive_pkg_data->remote_client->Quit();
+			delete (archive_pkg_data->remote_client);
+			pthread_mutex_destroy(&archive_pkg_data->client_lock);
+			delete archive_pkg_data;
+			return nullptr;
+		}
 		archive_pkg_data->stop_write_thread = true;
 		if (!archive_pkg_data->split_file->IsClosed())
 			archive_pkg_data->split_file->Close();
 		pthread_join(archive_pkg_data->thread, NULL);
 		delete (archive_pkg_data->split_file);
-		free(archive_pkg_data);
+		delete archive_pkg_data;
 		return nullptr;
 	}
 
@@ -666,7 +674,20 @@ namespace INSTALLER
 	{
 		int ret = 0;
 		pkg_header header;
-		pkg_data->split_file->Read((char *)&header, sizeof(pkg_header), 0);
+		memset(&header, 0, sizeof(header));
+		if (pkg_data->direct)
+		{
+			// A short read leaves the header zeroed past the data, the magic catches it
+			if (pkg_data->size < sizeof(pkg_header) ||
+				pkg_data->remote_client->GetRange(pkg_data->path, (char *)&header, sizeof(pkg_header), pkg_data->data_offset) != 1 ||
+				BE32(header.pkg_magic) != PS4_PKG_MAGIC)
+			{
+				pthread_create(&bk_clean_thid, NULL, CleanArchivePkgDataThread, pkg_data);
+				return false;
+			}
+		}
+		else
+			pkg_data->split_file->Read((char *)&header, sizeof(pkg_header), 0);
 
 		std::string cid = std::string((char *)header.pkg_content_id);
 		cid = cid.substr(cid.find_first_of("-") + 1, 9);
@@ -739,7 +760,7 @@ namespace INSTALLER
 		}
 		ret = 1;
 	finish:
-		ret = pthread_create(&bk_clean_thid, NULL, CleanArchivePkgDataThread, pkg_data);
+		pthread_create(&bk_clean_thid, NULL, CleanArchivePkgDataThread, pkg_data);
 		RemoveArchivePkgInstallData(hash);
 		return ret;
 	}
@@ -1135,21 +1156,21 @@ namespace INSTALLER
 
         if (settings->type == CLIENT_TYPE_HTTP_SERVER)
         {
-            if (strcmp(remote_settings->http_server_type, HTTP_SERVER_APACHE) == 0)
+            if (strcmp(settings->http_server_type, HTTP_SERVER_APACHE) == 0)
                 tmp_client = new ApacheClient();
-            else if (strcmp(remote_settings->http_server_type, HTTP_SERVER_MS_IIS) == 0)
+            else if (strcmp(settings->http_server_type, HTTP_SERVER_MS_IIS) == 0)
                 tmp_client = new IISClient();
-            else if (strcmp(remote_settings->http_server_type, HTTP_SERVER_NGINX) == 0)
+            else if (strcmp(settings->http_server_type, HTTP_SERVER_NGINX) == 0)
                 tmp_client = new NginxClient();
-            else if (strcmp(remote_settings->http_server_type, HTTP_SERVER_NPX_SERVE) == 0)
+            else if (strcmp(settings->http_server_type, HTTP_SERVER_NPX_SERVE) == 0)
                 tmp_client = new NpxServeClient();
-            else if (strcmp(remote_settings->http_server_type, HTTP_SERVER_RCLONE) == 0)
+            else if (strcmp(settings->http_server_type, HTTP_SERVER_RCLONE) == 0)
                 tmp_client = new RCloneClient();
-            else if (strcmp(remote_settings->http_server_type, HTTP_SERVER_ARCHIVEORG) == 0)
+            else if (strcmp(settings->http_server_type, HTTP_SERVER_ARCHIVEORG) == 0)
                 tmp_client = new ArchiveOrgClient();
-            else if (strcmp(remote_settings->http_server_type, HTTP_SERVER_GITHUB) == 0)
+            else if (strcmp(settings->http_server_type, HTTP_SERVER_GITHUB) == 0)
                 tmp_client = new GithubClient();
-            else if (strcmp(remote_settings->http_server_type, HTTP_SERVER_MYRIENT) == 0)
+            else if (strcmp(settings->http_server_type, HTTP_SERVER_MYRIENT) == 0)
                 tmp_client = new MyrientClient();
         }
         else if (settings->type == CLIENT_TYPE_WEBDAV)
@@ -1175,6 +1196,9 @@ namespace INSTALLER
             tmp_client = new NfsClient();
         }
 
+        if (tmp_client == nullptr)
+            return nullptr;
+
         tmp_client->Connect(settings->server, settings->username, settings->password, false);
 
         return tmp_client;
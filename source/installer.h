@@ -129,6 +129,13 @@ struct ArchivePkgInstallData
     ArchiveEntry *archive_entry;
     pthread_t thread;
     bool stop_write_thread;
+    // STORED zip entries are served straight from the archive, no split file
+    bool direct;
+    RemoteClient *remote_client;
+    pthread_mutex_t client_lock;
+    std::string path;
+    uint64_t data_offset;
+    uint64_t size;
 };
 
 struct SplitPkgInstallData
@@ -189,6 +189,25 @@ char lang_strings[LANG_STRINGS_NUM][LANG_STR_SIZE] = {
 	"Minimum background file size (bytes)",                                                           // STR_BG_DOWNLOAD_MIN_SIZE
 	"Background Download Progress",                                                                   // STR_BG_DOWNLOAD_PROGRESS
 	"Show Background Download Progress",                                                              // STR_SHOW_BG_DOWNLOAD_PROGRESS
+	"Parallel Transfers",                                                                             // STR_PARALLEL_TRANSFERS
+	"Transfer Order",                                                                                 // STR_TRANSFER_ORDER
+	"As Listed",                                                                                      // STR_ORDER_AS_LISTED
+	"Largest First",                                                                                  // STR_LARGEST_FIRST
+	"Smallest First",                                                                                 // STR_SMALLEST_FIRST
+	"Send to Site",                                                                                   // STR_SEND_TO_SITE
+	"Deflated",                                                                                       // STR_DEFLATED
+	"Stored",                                                                                         // STR_STORED
+	"Saved",                                                                                          // STR_SAVED
+	"Fetched",                                                                                        // STR_FETCHED
+	"Read",                                                                                           // STR_READ
+	"Decompress",                                                                                     // STR_DECOMPRESS
+	"Write",                                                                                          // STR_WRITE
+	"Skipped",                                                                                        // STR_SKIPPED
+	"Upload as Zip",                                                                                  // STR_UPLOAD_ZIP
+	"Search in files",                                                                                // STR_SEARCH_IN_FILES
+	"Searching",                                                                                      // STR_SEARCHING
+	"Largest items",                                                                                  // STR_LARGEST_ITEMS
+	"Scanning",                                                                                       // STR_SCANNING
 };
 
 bool needs_extended_font = false;
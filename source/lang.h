@@ -183,6 +183,25 @@
 	FUNC(STR_BG_DOWNLOAD_MIN_SIZE)          \
 	FUNC(STR_BG_DOWNLOAD_PROGRESS)          \
 	FUNC(STR_SHOW_BG_DOWNLOAD_PROGRESS)     \
+	FUNC(STR_PARALLEL_TRANSFERS)            \
+	FUNC(STR_TRANSFER_ORDER)                \
+	FUNC(STR_ORDER_AS_LISTED)               \
+	FUNC(STR_LARGEST_FIRST)                 \
+	FUNC(STR_SMALLEST_FIRST)                \
+	FUNC(STR_SEND_TO_SITE)                  \
+	FUNC(STR_DEFLATED)                      \
+	FUNC(STR_STORED)                        \
+	FUNC(STR_SAVED)                         \
+	FUNC(STR_FETCHED)                       \
+	FUNC(STR_READ)                          \
+	FUNC(STR_DECOMPRESS)                    \
+	FUNC(STR_WRITE)                         \
+	FUNC(STR_SKIPPED)                       \
+	FUNC(STR_UPLOAD_ZIP)                    \
+	FUNC(STR_SEARCH_IN_FILES)               \
+	FUNC(STR_SEARCHING)                     \
+	FUNC(STR_LARGEST_ITEMS)                 \
+	FUNC(STR_SCANNING)                      \
 
 #define GET_VALUE(x) x,
 #define GET_STRING(x) #x,
@@ -192,7 +211,7 @@ enum
 	FOREACH_STR(GET_VALUE)
 };
 
-#define LANG_STRINGS_NUM 179
+#define LANG_STRINGS_NUM 198
 #define LANG_ID_SIZE 64
 #define LANG_STR_SIZE 384
 extern char lang_identifiers[LANG_STRINGS_NUM][LANG_ID_SIZE];
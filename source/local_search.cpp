@@ -0,0 +1,360 @@
+#include <ctype.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "local_search.h"
+
+#define LOCAL_SEARCH_BINARY_PROBE 4096
+
+static uint64_t CountLines(const char *data, size_t len)
+{
+    uint64_t lines = 0;
+    const char *end = data + len;
+    while (data < end && (data = (const char *)memchr(data, '\n', end - data)) != nullptr)
+    {
+        lines++;
+        data++;
+    }
+    return lines;
+}
+
+SubstringScanner::SubstringScanner(const std::string &pattern, bool ignore_case)
+{
+    this->ignore_case = ignore_case;
+    this->pattern = pattern;
+    if (ignore_case)
+        std::transform(this->pattern.begin(), this->pattern.end(), this->pattern.begin(), [](unsigned char c) { return tolower(c); });
+
+    unsigned char first = this->pattern.empty() ? 0 : this->pattern.front();
+    unsigned char last = this->pattern.empty() ? 0 : this->pattern.back();
+    this->first_lower = first;
+    this->last_lower = last;
+    this->first_upper = ignore_case ? toupper(first) : first;
+    this->last_upper = ignore_case ? toupper(last) : last;
+}
+
+bool SubstringScanner::Equals(const char *data) const
+{
+    if (!this->ignore_case)
+        return memcmp(data, this->pattern.data(), this->pattern.size()) == 0;
+
+    for (size_t i = 0; i < this->pattern.size(); i++)
+    {
+        if (tolower((unsigned char)data[i]) != (unsigned char)this->pattern[i])
+            return false;
+    }
+    return true;
+}
+
+const char *SubstringScanner::Find(const char *data, size_t len) const
+{
+    size_t n = this->pattern.size();
+    if (n == 0)
+        return data;
+    if (len < n)
+        return nullptr;
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i first_lower = _mm_set1_epi8(this->first_lower);
+    const __m128i first_upper = _mm_set1_epi8(this->first_upper);
+    const __m128i last_lower = _mm_set1_epi8(this->last_lower);
+    const __m128i last_upper = _mm_set1_epi8(this->last_upper);
+    for (; i + n - 1 + 16 <= len; i += 16)
+    {
+        __m128i block_first = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i *)(data + i + n - 1));
+        __m128i eq_first = _mm_or_si128(_mm_cmpeq_epi8(block_first, first_lower), _mm_cmpeq_epi8(block_first, first_upper));
+        __m128i eq_last = _mm_or_si128(_mm_cmpeq_epi8(block_last, last_lower), _mm_cmpeq_epi8(block_last, last_upper));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last));
+        while (mask != 0)
+        {
+            size_t pos = i + __builtin_ctz(mask);
+            if (Equals(data + pos))
+                return data + pos;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i + n <= len; i++)
+    {
+        unsigned char c = data[i];
+        if ((c == this->first_lower || c == this->first_upper) && Equals(data + i))
+            return data + i;
+    }
+    return nullptr;
+}
+
+LocalSearch::LocalSearch(const SearchQuery &query) : scanner(query.pattern, query.ignore_case)
+{
+    this->query = query;
+    if (this->query.limit == 0)
+        this->query.limit = LOCAL_SEARCH_DEFAULT_LIMIT;
+    this->query.limit = std::min<size_t>(this->query.limit, LOCAL_SEARCH_MAX_LIMIT);
+    this->thread_count = 0;
+    this->running = 0;
+    this->busy = 0;
+    this->found = 0;
+    this->stopped = false;
+    this->truncated = false;
+}
+
+LocalSearch::~LocalSearch()
+{
+    Stop();
+    for (int i = 0; i < this->thread_count; i++)
+        pthread_join(this->threads[i], NULL);
+}
+
+int LocalSearch::Start()
+{
+    if (this->query.pattern.empty())
+        return 0;
+
+    std::string root = this->query.root;
+    while (root.size() > 1 && root.back() == '/')
+        root.pop_back();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    this->dirs.push_back(root);
+    for (int i = 0; i < LOCAL_SEARCH_THREADS; i++)
+    {
+        if (pthread_create(&this->threads[this->thread_count], NULL, WorkerThread, this) == 0)
+        {
+            this->thread_count++;
+            this->running++;
+        }
+    }
+    return this->thread_count > 0;
+}
+
+void LocalSearch::Stop()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    this->stopped = true;
+    this->dirs_cond.notify_all();
+    this->matches_cond.notify_all();
+}
+
+int LocalSearch::Next(SearchMatch &match, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    this->matches_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                [this] { return !this->matches.empty() || this->running == 0; });
+    if (!this->matches.empty())
+    {
+        match = std::move(this->matches.front());
+        this->matches.pop_front();
+        return 1;
+    }
+    return this->running == 0 ? 0 : -1;
+}
+
+bool LocalSearch::Truncated()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->truncated;
+}
+
+void *LocalSearch::WorkerThread(void *argp)
+{
+    LocalSearch *search = (LocalSearch *)argp;
+    search->Work();
+    return NULL;
+}
+
+void LocalSearch::Work()
+{
+    std::string buffer;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        // Out of folders with nobody walking one means the whole tree is done
+        this->dirs_cond.wait(lock, [this] { return this->stopped || !this->dirs.empty() || this->busy == 0; });
+        if (this->stopped || this->dirs.empty())
+            break;
+
+        std::string dir = this->dirs.front();
+        this->dirs.pop_front();
+        this->busy++;
+        lock.unlock();
+        ScanDir(dir, buffer);
+        lock.lock();
+        this->busy--;
+        if (this->busy == 0 && this->dirs.empty())
+            this->dirs_cond.notify_all();
+    }
+
+    this->running--;
+    if (this->running == 0)
+        this->matches_cond.notify_all();
+}
+
+void LocalSearch::ScanDir(const std::string &dir, std::string &buffer)
+{
+    DIR *fd = opendir(dir.c_str());
+    if (fd == NULL)
+        return;
+
+    struct dirent *dirent;
+    while (!this->stopped && (dirent = readdir(fd)) != NULL)
+    {
+        if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0)
+            continue;
+
+        std::string path = dir + (dir.back() == '/' ? "" : "/") + dirent->d_name;
+        // Links are not followed so a loop of them can't keep the walk going
+        struct stat file_stat;
+        if (lstat(path.c_str(), &file_stat) != 0)
+            continue;
+
+        bool is_dir = S_ISDIR(file_stat.st_mode);
+        if (this->scanner.Find(dirent->d_name, strlen(dirent->d_name)) != nullptr)
+        {
+            SearchMatch match;
+            match.type = SEARCH_MATCH_NAME;
+            match.path = path;
+            match.is_dir = is_dir;
+            match.size = is_dir ? 0 : file_stat.st_size;
+            match.modified = file_stat.st_mtime;
+            match.line = 0;
+            if (!Emit(match))
+                break;
+        }
+
+        if (is_dir)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            this->dirs.push_back(path);
+            this->dirs_cond.notify_one();
+        }
+        else if (this->query.contents && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0)
+        {
+            ScanFile(path, file_stat, buffer);
+        }
+    }
+    closedir(fd);
+}
+
+/*
+ * Scans a file a block at a time. The last bytes of a block are carried over
+ * to the next one so a match across the boundary is still found. Text files
+ * give one match per matching line, files with a zero byte near the start
+ * are taken as binary and only reported once.
+ */
+void LocalSearch::ScanFile(const std::string &path, const struct stat &file_stat, std::string &buffer)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    size_t keep = this->query.pattern.size() - 1;
+    buffer.resize(LOCAL_SEARCH_BLOCK_SIZE + keep);
+    char *buf = &buffer[0];
+    size_t carry = 0;
+    uint64_t line = 1;
+    bool first_block = true;
+    bool binary = false;
+
+    SearchMatch match;
+    match.path = path;
+    match.is_dir = false;
+    match.size = file_stat.st_size;
+    match.modified = file_stat.st_mtime;
+
+    while (!this->stopped)
+    {
+        ssize_t read_len = read(fd, buf + carry, LOCAL_SEARCH_BLOCK_SIZE);
+        if (read_len <= 0)
+            break;
+
+        size_t avail = carry + read_len;
+        if (first_block)
+        {
+            binary = memchr(buf, 0, std::min<size_t>(avail, LOCAL_SEARCH_BINARY_PROBE)) != nullptr;
+            first_block = false;
+        }
+
+        size_t pos = 0;
+        if (binary)
+        {
+            if (this->scanner.Find(buf, avail) != nullptr)
+            {
+                match.type = SEARCH_MATCH_BINARY;
+                match.line = 0;
+                Emit(match);
+                break;
+            }
+        }
+        else
+        {
+            size_t counted = 0;
+            const char *hit;
+            while (pos < avail && (hit = this->scanner.Find(buf + pos, avail - pos)) != nullptr)
+            {
+                size_t at = hit - buf;
+                line += CountLines(buf + counted, at - counted);
+                counted = at;
+
+                size_t line_start = at;
+                while (line_start > 0 && buf[line_start - 1] != '\n' && at - line_start < LOCAL_SEARCH_MAX_LINE / 2)
+                    line_start--;
+                const char *newline = (const char *)memchr(buf + at, '\n', avail - at);
+                size_t line_end = newline != nullptr ? newline - buf : avail;
+                size_t text_len = std::min<size_t>(line_end - line_start, LOCAL_SEARCH_MAX_LINE);
+                if (text_len > 0 && buf[line_start + text_len - 1] == '\r')
+                    text_len--;
+
+                match.type = SEARCH_MATCH_CONTENT;
+                match.line = line;
+                match.text.assign(buf + line_start, text_len);
+                if (!Emit(match))
+                {
+                    close(fd);
+                    return;
+                }
+
+                // One match per line, the rest of it is skipped
+                pos = newline != nullptr ? line_end + 1 : avail;
+            }
+
+            size_t carry_start = std::max(avail - std::min(keep, avail), pos);
+            line += CountLines(buf + counted, carry_start - counted);
+            pos = carry_start;
+        }
+
+        if (binary)
+            pos = avail - std::min(keep, avail);
+        carry = avail - pos;
+        memmove(buf, buf + pos, carry);
+    }
+    close(fd);
+}
+
+/*
+ * Queues a match for the reader. Returns false once the limit is reached,
+ * which also stops the walk.
+ */
+bool LocalSearch::Emit(SearchMatch &match)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (this->stopped)
+        return false;
+
+    this->matches.push_back(match);
+    this->found++;
+    this->matches_cond.notify_one();
+    if (this->found >= this->query.limit)
+    {
+        this->truncated = true;
+        this->stopped = true;
+        this->dirs_cond.notify_all();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+#ifndef EZ_LOCAL_SEARCH_H
+#define EZ_LOCAL_SEARCH_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <string>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#define LOCAL_SEARCH_THREADS 4
+#define LOCAL_SEARCH_BLOCK_SIZE 1048576
+#define LOCAL_SEARCH_MAX_LINE 200
+#define LOCAL_SEARCH_DEFAULT_LIMIT 1000
+#define LOCAL_SEARCH_MAX_LIMIT 10000
+
+enum SearchMatchType
+{
+    SEARCH_MATCH_NAME,
+    SEARCH_MATCH_CONTENT,
+    SEARCH_MATCH_BINARY
+};
+
+struct SearchQuery
+{
+    std::string root;
+    std::string pattern;
+    bool contents;
+    bool ignore_case;
+    size_t limit;
+};
+
+struct SearchMatch
+{
+    SearchMatchType type;
+    std::string path;
+    bool is_dir;
+    uint64_t size;
+    time_t modified;
+    // Line number and text of a content match, the line is cut to LOCAL_SEARCH_MAX_LINE
+    uint64_t line;
+    std::string text;
+};
+
+/*
+ * Finds a fixed string in memory, 16 bytes at a time where SSE2 is there.
+ * Candidates are positions where both the first and the last byte of the
+ * pattern match, only those are compared in full.
+ */
+class SubstringScanner
+{
+public:
+    SubstringScanner(const std::string &pattern, bool ignore_case);
+    const char *Find(const char *data, size_t len) const;
+
+private:
+    std::string pattern;
+    bool ignore_case;
+    unsigned char first_lower, first_upper;
+    unsigned char last_lower, last_upper;
+
+    bool Equals(const char *data) const;
+};
+
+/*
+ * Recursive search of a local folder by file name and optionally contents.
+ * A few threads share a queue of folders to walk, files are read in large
+ * blocks and scanned with SubstringScanner. Matches are handed out through
+ * Next() as they are found, and the search ends on its own once the limit
+ * of results is reached.
+ */
+class LocalSearch
+{
+public:
+    LocalSearch(const SearchQuery &query);
+    ~LocalSearch();
+    int Start();
+    void Stop();
+    // Returns 1 with a match, 0 once the search is over, -1 on timeout
+    int Next(SearchMatch &match, int timeout_ms);
+    bool Truncated();
+
+private:
+    SearchQuery query;
+    SubstringScanner scanner;
+    std::mutex mutex_;
+    std::condition_variable dirs_cond;
+    std::condition_variable matches_cond;
+    std::deque<std::string> dirs;
+    std::deque<SearchMatch> matches;
+    pthread_t threads[LOCAL_SEARCH_THREADS];
+    int thread_count;
+    int running;
+    int busy;
+    size_t found;
+    std::atomic<bool> stopped;
+    bool truncated;
+
+    static void *WorkerThread(void *argp);
+    void Work();
+    void ScanDir(const std::string &dir, std::string &buffer);
+    void ScanFile(const std::string &path, const struct stat &file_stat, std::string &buffer);
+    bool Emit(SearchMatch &match);
+};
+
+#endif
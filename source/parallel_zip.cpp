@@ -0,0 +1,426 @@
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <math.h>
+#include <zlib.h>
+#include "common.h"
+#include "config.h"
+#include "fs.h"
+#include "lang.h"
+#include "windows.h"
+#include "util.h"
+#include "zip_util.h"
+#include "parallel_zip.h"
+
+ParallelZip::ParallelZip(zipFile zf, int level, int threads)
+{
+    this->zf = zf;
+    this->level = level;
+    this->thread_count = MAX(1, threads);
+    this->writer_started = false;
+    this->closed = false;
+    this->failed = false;
+    this->compressed_bytes = 0;
+    this->busy_usec = 0;
+    this->stored_files = 0;
+    this->deflated_files = 0;
+    this->deflated_in = 0;
+    this->deflated_out = 0;
+
+    bytes_transfered = 0;
+    bytes_to_download = 0;
+    prev_tick = Util::GetTick();
+
+    for (int i = 0; i < this->thread_count; i++)
+    {
+        pthread_t thid;
+        if (pthread_create(&thid, NULL, WorkerThread, this) == 0)
+            this->threads.push_back(thid);
+    }
+
+    if (pthread_create(&this->writer_thread, NULL, WriterThread, this) == 0)
+        this->writer_started = true;
+}
+
+ParallelZip::~ParallelZip()
+{
+    Finish();
+}
+
+/*
+ * Waits for every queued block to be compressed and written. The zip itself is
+ * left open for the caller to close.
+ */
+int ParallelZip::Finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->closed = true;
+    }
+    this->todo_cv.notify_all();
+    this->done_cv.notify_all();
+
+    for (int i = 0; i < this->threads.size(); i++)
+    {
+        pthread_join(this->threads[i], NULL);
+    }
+    this->threads.clear();
+
+    if (this->writer_started)
+    {
+        pthread_join(this->writer_thread, NULL);
+        this->writer_started = false;
+    }
+
+    return !this->failed;
+}
+
+void ParallelZip::Submit(ZipBlock *block)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (this->ordered.size() >= PARALLEL_ZIP_MAX_PENDING && this->writer_started)
+    {
+        this->space_cv.wait(lock);
+    }
+
+    this->ordered.push_back(block);
+    if (block->is_dir || this->threads.size() == 0)
+    {
+        if (!block->is_dir)
+            Compress(block);
+        block->done = true;
+    }
+    else
+    {
+        this->todo.push_back(block);
+        this->todo_cv.notify_one();
+    }
+    this->done_cv.notify_all();
+}
+
+int ParallelZip::AddFolder(const std::string &path, int filename_start)
+{
+    struct stat file_stat;
+    memset(&file_stat, 0, sizeof(file_stat));
+    int res = stat(path.c_str(), &file_stat);
+    if (res < 0)
+        return res;
+
+    ZipBlock *block = new ZipBlock();
+    memset(&block->zi, 0, sizeof(zip_fileinfo));
+    ZipUtil::convertToZipTime(file_stat.st_mtim.tv_sec, &block->zi.tmz_date);
+    block->name = path.substr(filename_start);
+    if (block->name[block->name.length() - 1] != '/')
+        block->name = block->name + "/";
+    block->is_dir = true;
+    block->first = true;
+    block->last = true;
+    block->method = 0;
+    block->level = 0;
+    Submit(block);
+
+    return 1;
+}
+
+/*
+ * STORED for known compressed formats and for data that already looks random,
+ * measured as the byte entropy of the start of the file. DEFLATE otherwise.
+ */
+int ParallelZip::ChooseMethod(const std::string &path, const std::vector<uint8_t> &sample)
+{
+    if (this->level == 0)
+        return 0;
+
+    std::string filename = Util::ToLower(path);
+    size_t dot_pos = filename.find_last_of(".");
+    if (dot_pos != std::string::npos && compressed_file_extensions.find(filename.substr(dot_pos)) != compressed_file_extensions.end())
+        return 0;
+
+    size_t len = MIN(sample.size(), PARALLEL_ZIP_ENTROPY_SAMPLE);
+    if (len < 1024)
+        return Z_DEFLATED;
+
+    uint32_t counts[256] = {0};
+    for (size_t i = 0; i < len; i++)
+    {
+        counts[sample[i]]++;
+    }
+
+    double entropy = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        if (counts[i] == 0)
+            continue;
+        double p = (double)counts[i] / len;
+        entropy -= p * log2(p);
+    }
+
+    return entropy >= PARALLEL_ZIP_STORE_ENTROPY ? 0 : Z_DEFLATED;
+}
+
+int ParallelZip::AddFile(const std::string &path, int filename_start)
+{
+    struct stat file_stat;
+    memset(&file_stat, 0, sizeof(file_stat));
+    int res = stat(path.c_str(), &file_stat);
+    if (res < 0)
+        return res;
+
+    FILE *fd = FS::OpenRead(path);
+    if (fd == NULL)
+        return 0;
+
+    zip_fileinfo zi;
+    memset(&zi, 0, sizeof(zip_fileinfo));
+    ZipUtil::convertToZipTime(file_stat.st_mtim.tv_sec, &zi.tmz_date);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bytes_to_download += file_stat.st_size;
+    }
+
+    int ret = 1;
+    int method = 0;
+    bool first = true;
+    bool last = false;
+    uint64_t remaining = file_stat.st_size;
+    std::vector<uint8_t> tail;
+    while (!last)
+    {
+        ZipBlock *block = new ZipBlock();
+        block->name = path.substr(filename_start);
+        block->zi = zi;
+        block->level = this->level;
+        block->zip64 = (file_stat.st_size >= 0xFFFFFFFF);
+        block->first = first;
+        block->dict.swap(tail);
+
+        block->data.resize(MIN(remaining, PARALLEL_ZIP_BLOCK_SIZE));
+        int read = 0;
+        if (block->data.size() > 0)
+            read = FS::Read(fd, block->data.data(), block->data.size());
+        if (read < 0)
+        {
+            ret = read;
+            read = 0;
+        }
+        block->data.resize(read);
+        remaining -= read;
+
+        if (first)
+            method = ChooseMethod(path, block->data);
+        block->method = method;
+
+        // A short read or a cancel ends the entry early so the archive stays valid
+        last = (remaining == 0 || read == 0 || stop_activity);
+        block->last = last;
+        if (!last)
+        {
+            size_t dict_size = MIN(read, PARALLEL_ZIP_DICT_SIZE);
+            tail.assign(block->data.end() - dict_size, block->data.end());
+        }
+
+        Submit(block);
+        first = false;
+    }
+
+    FS::Close(fd);
+    return ret;
+}
+
+int ParallelZip::AddPath(const std::string &path, int filename_start)
+{
+    DIR *dfd = opendir(path.c_str());
+    if (dfd != NULL)
+    {
+        int ret = AddFolder(path, filename_start);
+        if (ret <= 0)
+        {
+            closedir(dfd);
+            return ret;
+        }
+
+        struct dirent *dirent;
+        do
+        {
+            dirent = readdir(dfd);
+            if (stop_activity)
+                break;
+            if (dirent != NULL && strcmp(dirent->d_name, ".") != 0 && strcmp(dirent->d_name, "..") != 0)
+            {
+                std::string new_path = path + (FS::hasEndSlash(path.c_str()) ? "" : "/") + dirent->d_name;
+
+                if (dirent->d_type & DT_DIR)
+                    ret = AddPath(new_path, filename_start);
+                else
+                    ret = AddFile(new_path, filename_start);
+
+                if (ret <= 0)
+                {
+                    closedir(dfd);
+                    return ret;
+                }
+            }
+        } while (dirent != NULL);
+
+        closedir(dfd);
+        return 1;
+    }
+
+    return AddFile(path, filename_start);
+}
+
+void ParallelZip::Compress(ZipBlock *block)
+{
+    block->crc = crc32(0L, block->data.data(), block->data.size());
+    if (block->method == 0)
+        return;
+
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, block->level, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        block->error = true;
+        return;
+    }
+
+    if (block->dict.size() > 0)
+        deflateSetDictionary(&strm, block->dict.data(), block->dict.size());
+
+    // Room for the sync flush marker on top of the worst case
+    block->out.resize(deflateBound(&strm, block->data.size()) + 64);
+    strm.next_in = block->data.data();
+    strm.avail_in = block->data.size();
+    strm.next_out = block->out.data();
+    strm.avail_out = block->out.size();
+
+    int ret = deflate(&strm, block->last ? Z_FINISH : Z_SYNC_FLUSH);
+    block->error = (block->last ? ret != Z_STREAM_END : ret != Z_OK) || strm.avail_in != 0;
+    block->out.resize(strm.total_out);
+    deflateEnd(&strm);
+}
+
+void *ParallelZip::WorkerThread(void *argp)
+{
+    ParallelZip *pz = (ParallelZip *)argp;
+    while (true)
+    {
+        ZipBlock *block;
+        {
+            std::unique_lock<std::mutex> lock(pz->mutex_);
+            while (pz->todo.empty() && !pz->closed)
+            {
+                pz->todo_cv.wait(lock);
+            }
+            if (pz->todo.empty())
+                break;
+            block = pz->todo.front();
+            pz->todo.pop_front();
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Compress(block);
+        uint64_t usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(pz->mutex_);
+            block->done = true;
+            pz->busy_usec += usec;
+            pz->compressed_bytes += block->data.size();
+        }
+        pz->done_cv.notify_all();
+    }
+    return NULL;
+}
+
+void *ParallelZip::WriterThread(void *argp)
+{
+    ParallelZip *pz = (ParallelZip *)argp;
+    pz->Write();
+    return NULL;
+}
+
+void ParallelZip::Write()
+{
+    uLong crc = 0;
+    uint64_t size = 0;
+    while (true)
+    {
+        ZipBlock *block;
+        double per_core = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while ((this->ordered.empty() && !this->closed) || (!this->ordered.empty() && !this->ordered.front()->done))
+            {
+                this->done_cv.wait(lock);
+            }
+            if (this->ordered.empty())
+                break;
+            block = this->ordered.front();
+            this->ordered.pop_front();
+            if (this->busy_usec > 0)
+                per_core = (double)this->compressed_bytes / this->busy_usec * 1000000 / 1048576;
+        }
+        this->space_cv.notify_all();
+
+        if (!this->failed)
+        {
+            if (block->first)
+            {
+                int res = zipOpenNewFileInZip3_64(this->zf, block->name.c_str(), &block->zi,
+                                                  NULL, 0, NULL, 0, NULL,
+                                                  block->method, block->level, 1,
+                                                  -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+                                                  NULL, 0, block->zip64);
+                if (res < 0)
+                    this->failed = true;
+                crc = 0;
+                size = 0;
+                snprintf(activity_message, 1024, "%s %s (%d x %.1f MB/s)", lang_strings[STR_COMPRESSING], block->name.c_str(), this->thread_count, per_core);
+            }
+
+            std::vector<uint8_t> &payload = (block->method == 0) ? block->data : block->out;
+            if (!this->failed && payload.size() > 0 && zipWriteInFileInZip(this->zf, payload.data(), payload.size()) < 0)
+                this->failed = true;
+            if (block->error)
+                this->failed = true;
+
+            crc = crc32_combine(crc, block->crc, block->data.size());
+            size += block->data.size();
+            bytes_transfered += block->data.size();
+
+            if (block->method == 0)
+            {
+                if (block->last && !block->is_dir)
+                    this->stored_files++;
+            }
+            else
+            {
+                this->deflated_in += block->data.size();
+                this->deflated_out += block->out.size();
+                if (block->last)
+                    this->deflated_files++;
+            }
+
+            if (block->last && !block->is_dir)
+                zipCloseFileInZipRaw64(this->zf, size, crc);
+            else if (block->is_dir)
+                zipCloseFileInZip(this->zf);
+        }
+
+        delete block;
+    }
+}
+
+std::string ParallelZip::Summary()
+{
+    DirEntry saved;
+    saved.file_size = this->deflated_in > this->deflated_out ? this->deflated_in - this->deflated_out : 0;
+    DirEntry::SetDisplaySize(&saved);
+
+    char summary[256];
+    snprintf(summary, sizeof(summary), "%s: %d (%s %s), %s: %d", lang_strings[STR_DEFLATED], this->deflated_files,
+             lang_strings[STR_SAVED], saved.display_size, lang_strings[STR_STORED], this->stored_files);
+    return std::string(summary);
+}
@@ -0,0 +1,89 @@
+#ifndef EZ_PARALLEL_ZIP_H
+#define EZ_PARALLEL_ZIP_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+#include <minizip/zip.h>
+
+#define PARALLEL_ZIP_THREADS 4
+#define PARALLEL_ZIP_BLOCK_SIZE 1048576
+#define PARALLEL_ZIP_DICT_SIZE 32768
+#define PARALLEL_ZIP_MAX_PENDING 16
+#define PARALLEL_ZIP_ENTROPY_SAMPLE 65536
+#define PARALLEL_ZIP_STORE_ENTROPY 7.5
+
+struct ZipBlock
+{
+    std::string name;
+    bool is_dir;
+    bool first;
+    bool last;
+    bool done;
+    bool error;
+    int method;
+    int level;
+    int zip64;
+    zip_fileinfo zi;
+    std::vector<uint8_t> dict;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> out;
+    uLong crc;
+};
+
+/*
+ * Builds a zip with the deflate work spread over a pool of threads, pigz style.
+ * Files are cut into blocks that are deflated independently, each primed with the
+ * tail of the previous block as dictionary and ended with a sync flush, so the
+ * concatenated blocks form one ordinary deflate stream. A writer thread stores them
+ * in order through minizip's raw mode with the combined crc, so the result is a
+ * standard zip/zip64 archive. Small files are single blocks, which spreads separate
+ * files over the pool as well.
+ * Known compressed formats and files whose first block samples as near random are
+ * STORED instead of deflated, Summary() reports both counts and the bytes saved.
+ */
+class ParallelZip
+{
+public:
+    ParallelZip(zipFile zf, int level, int threads = PARALLEL_ZIP_THREADS);
+    ~ParallelZip();
+    int AddPath(const std::string &path, int filename_start);
+    int Finish();
+    std::string Summary();
+
+private:
+    zipFile zf;
+    int level;
+    int thread_count;
+    std::vector<pthread_t> threads;
+    pthread_t writer_thread;
+    bool writer_started;
+    std::deque<ZipBlock *> ordered;
+    std::deque<ZipBlock *> todo;
+    bool closed;
+    bool failed;
+    uint64_t compressed_bytes;
+    uint64_t busy_usec;
+    int stored_files;
+    int deflated_files;
+    uint64_t deflated_in;
+    uint64_t deflated_out;
+    std::mutex mutex_;
+    std::condition_variable todo_cv;
+    std::condition_variable done_cv;
+    std::condition_variable space_cv;
+
+    int ChooseMethod(const std::string &path, const std::vector<uint8_t> &sample);
+    int AddFile(const std::string &path, int filename_start);
+    int AddFolder(const std::string &path, int filename_start);
+    void Submit(ZipBlock *block);
+    static void *WorkerThread(void *argp);
+    static void *WriterThread(void *argp);
+    static void Compress(ZipBlock *block);
+    void Write();
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include <pthread.h>
+#include <unistd.h>
+#include <map>
+#include <json-c/json.h>
+#include "httpclient/HTTPClient.h"
+#include "server/http_server.h"
+#include "config.h"
+#include "util.h"
+#include "windows.h"
+#include "progress_bus.h"
+
+#define PROGRESS_BUS_CLAIMED 0xFFFFFFFF
+#define BRIDGE_POLL_INTERVAL 1000000
+#define BRIDGE_KEEP_ALIVE 5000000
+
+namespace ProgressBus
+{
+    static ProgressSlot slots[PROGRESS_BUS_SLOTS];
+    static std::atomic<uint32_t> next_serial(1);
+    static std::atomic<uint64_t> version(0);
+    static std::atomic<uint64_t> activity_seen_at(0);
+
+    static std::atomic<int> subscribers(0);
+    static std::atomic<uint64_t> bridge_keep_until(0);
+    static std::atomic<bool> bridge_running(false);
+
+    static ProgressSlot *Slot(uint32_t job_id)
+    {
+        if (job_id == 0 || job_id == PROGRESS_BUS_CLAIMED)
+            return nullptr;
+        ProgressSlot *slot = &slots[job_id & (PROGRESS_BUS_SLOTS - 1)];
+        if (slot->job_id.load(std::memory_order_acquire) != job_id)
+            return nullptr;
+        return slot;
+    }
+
+    /*
+     * Takes a free slot, or the one of a job that ended long enough ago for
+     * every reader to have seen its last state. Returns 0 when all are busy.
+     */
+    uint32_t Begin(const char *kind, const std::string &name, uint64_t total, time_t timestamp)
+    {
+        uint64_t now = Util::GetTick();
+        for (uint32_t i = 0; i < PROGRESS_BUS_SLOTS; i++)
+        {
+            ProgressSlot *slot = &slots[i];
+            uint32_t id = slot->job_id.load(std::memory_order_acquire);
+            if (id == PROGRESS_BUS_CLAIMED)
+                continue;
+            if (id != 0)
+            {
+                uint64_t finished_at = slot->finished_at.load(std::memory_order_relaxed);
+                if (finished_at == 0 || now - finished_at < PROGRESS_BUS_FINISHED_KEEP)
+                    continue;
+            }
+            if (!slot->job_id.compare_exchange_strong(id, PROGRESS_BUS_CLAIMED))
+                continue;
+
+            slot->seq.fetch_add(1, std::memory_order_acq_rel);
+            snprintf(slot->kind, sizeof(slot->kind), "%s", kind);
+            snprintf(slot->name, sizeof(slot->name), "%s", name.c_str());
+            slot->bytes.store(0, std::memory_order_relaxed);
+            slot->total.store(total, std::memory_order_relaxed);
+            slot->state.store(STATE_PENDING, std::memory_order_relaxed);
+            slot->timestamp.store(timestamp != 0 ? timestamp : time(NULL), std::memory_order_relaxed);
+            slot->finished_at.store(0, std::memory_order_relaxed);
+
+            uint32_t serial = next_serial.fetch_add(1) % ((PROGRESS_BUS_CLAIMED >> PROGRESS_BUS_SLOT_BITS) - 1);
+            uint32_t job_id = ((serial + 1) << PROGRESS_BUS_SLOT_BITS) | i;
+            slot->job_id.store(job_id, std::memory_order_release);
+            slot->seq.fetch_add(1, std::memory_order_release);
+            version++;
+            return job_id;
+        }
+        return 0;
+    }
+
+    void Update(uint32_t job_id, uint64_t bytes, uint64_t total, int state)
+    {
+        ProgressSlot *slot = Slot(job_id);
+        if (slot == nullptr)
+            return;
+
+        slot->seq.fetch_add(1, std::memory_order_acq_rel);
+        slot->bytes.store(bytes, std::memory_order_relaxed);
+        slot->total.store(total, std::memory_order_relaxed);
+        slot->state.store(state, std::memory_order_relaxed);
+        slot->seq.fetch_add(1, std::memory_order_release);
+        version++;
+    }
+
+    void End(uint32_t job_id, int state)
+    {
+        ProgressSlot *slot = Slot(job_id);
+        if (slot == nullptr)
+            return;
+
+        slot->seq.fetch_add(1, std::memory_order_acq_rel);
+        slot->state.store(state, std::memory_order_relaxed);
+        slot->finished_at.store(Util::GetTick(), std::memory_order_relaxed);
+        slot->seq.fetch_add(1, std::memory_order_release);
+        version++;
+    }
+
+    uint64_t Version()
+    {
+        return version.load();
+    }
+
+    void Snapshot(std::vector<ProgressEvent> &events)
+    {
+        uint64_t now = Util::GetTick();
+        events.clear();
+
+        // The foreground activity, still published through the progress globals
+        if (activity_inprogess)
+            activity_seen_at = now;
+        if (activity_inprogess || now - activity_seen_at.load() < PROGRESS_BUS_FINISHED_KEEP)
+        {
+            ProgressEvent event;
+            event.job_id = PROGRESS_BUS_ACTIVITY_JOB;
+            event.kind = "activity";
+            event.name = activity_message;
+            event.bytes = bytes_transfered;
+            event.total = bytes_to_download;
+            event.state = activity_inprogess ? STATE_DOWNLOADING : (stop_activity ? STATE_FAILED : STATE_SUCCESS);
+            event.timestamp = 0;
+            events.push_back(event);
+        }
+
+        for (uint32_t i = 0; i < PROGRESS_BUS_SLOTS; i++)
+        {
+            ProgressSlot *slot = &slots[i];
+            while (true)
+            {
+                uint32_t seq = slot->seq.load(std::memory_order_acquire);
+                if (seq & 1)
+                    continue;
+
+                uint32_t id = slot->job_id.load(std::memory_order_acquire);
+                if (id == 0 || id == PROGRESS_BUS_CLAIMED)
+                    break;
+
+                ProgressEvent event;
+                event.job_id = id;
+                event.kind = slot->kind;
+                event.name = slot->name;
+                event.bytes = slot->bytes.load(std::memory_order_relaxed);
+                event.total = slot->total.load(std::memory_order_relaxed);
+                event.state = slot->state.load(std::memory_order_relaxed);
+                event.timestamp = slot->timestamp.load(std::memory_order_relaxed);
+                uint64_t finished_at = slot->finished_at.load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot->seq.load(std::memory_order_relaxed) != seq)
+                    continue;
+
+                if (finished_at == 0 || now - finished_at < PROGRESS_BUS_FINISHED_KEEP)
+                    events.push_back(event);
+                break;
+            }
+        }
+    }
+
+    /*
+     * Mirrors the download list of the ezremote server into the bus. Entries
+     * stay published while the bridge runs so the full list can be shown,
+     * entries the server dropped are ended.
+     */
+    static void *BackgroundBridgeThread(void *argp)
+    {
+        std::map<std::string, std::pair<uint32_t, int>> jobs;
+
+        do
+        {
+            while (subscribers.load() > 0 || Util::GetTick() < bridge_keep_until.load())
+            {
+                CHTTPClient::HttpResponse res;
+                CHTTPClient::HeadersMap headers;
+                CHTTPClient tmp_client([](const std::string &log) {});
+                tmp_client.InitSession(true, CHTTPClient::SettingsFlag::NO_FLAGS);
+                tmp_client.SetCertificateFile(CACERT_FILE);
+                tmp_client.SetTimeout(1);
+
+                if (tmp_client.Get("http://localhost:" + std::to_string(http_int_server_port) + "/get_download_state", headers, res) &&
+                    HTTP_SUCCESS(res.iCode))
+                {
+                    json_object *jobj = json_tokener_parse(res.strBody.data());
+                    if (jobj != nullptr && json_object_get_type(jobj) == json_type_array)
+                    {
+                        std::map<std::string, std::pair<uint32_t, int>> seen;
+                        size_t count = json_object_array_length(jobj);
+                        for (size_t idx = 0; idx < count; ++idx)
+                        {
+                            json_object *progress_obj = json_object_array_get_idx(jobj, idx);
+                            const char *path = json_object_get_string(json_object_object_get(progress_obj, "path"));
+                            if (path == nullptr)
+                                continue;
+                            uint64_t bytes = json_object_get_uint64(json_object_object_get(progress_obj, "bytes_transfered"));
+                            uint64_t size = json_object_get_uint64(json_object_object_get(progress_obj, "file_size"));
+                            int state = json_object_get_int(json_object_object_get(progress_obj, "state"));
+                            time_t timestamp = json_object_get_uint64(json_object_object_get(progress_obj, "timestamp"));
+                            if (state < STATE_PENDING || state > STATE_SUCCESS)
+                                state = STATE_PENDING;
+
+                            std::map<std::string, std::pair<uint32_t, int>>::iterator it = jobs.find(path);
+                            uint32_t job_id = (it != jobs.end()) ? it->second.first : Begin("background", path, size, timestamp);
+                            if (job_id == 0)
+                                continue;
+                            Update(job_id, bytes, size, state);
+                            seen[path] = std::make_pair(job_id, state);
+                            if (it != jobs.end())
+                                jobs.erase(it);
+                        }
+
+                        for (std::map<std::string, std::pair<uint32_t, int>>::iterator it = jobs.begin(); it != jobs.end(); it++)
+                            End(it->second.first, it->second.second);
+                        jobs.swap(seen);
+                    }
+                    if (jobj != nullptr)
+                        json_object_put(jobj);
+                }
+
+                usleep(BRIDGE_POLL_INTERVAL);
+            }
+
+            for (std::map<std::string, std::pair<uint32_t, int>>::iterator it = jobs.begin(); it != jobs.end(); it++)
+                End(it->second.first, it->second.second);
+            jobs.clear();
+
+            bridge_running = false;
+            // Someone may have started watching while the loop was ending
+        } while ((subscribers.load() > 0 || Util::GetTick() < bridge_keep_until.load()) && !bridge_running.exchange(true));
+
+        return NULL;
+    }
+
+    static void StartBackgroundBridge()
+    {
+        if (bridge_running.exchange(true))
+            return;
+
+        pthread_t thid;
+        if (pthread_create(&thid, NULL, BackgroundBridgeThread, NULL) != 0)
+        {
+            bridge_running = false;
+            return;
+        }
+        pthread_detach(thid);
+    }
+
+    void Subscribe()
+    {
+        subscribers++;
+        StartBackgroundBridge();
+    }
+
+    void Unsubscribe()
+    {
+        subscribers--;
+    }
+
+    /*
+     * Keeps the bridge going for a few seconds, for the native dialog which
+     * refreshes from the bus while it is open.
+     */
+    void KeepBackgroundBridge()
+    {
+        bridge_keep_until = Util::GetTick() + BRIDGE_KEEP_ALIVE;
+        StartBackgroundBridge();
+    }
+}
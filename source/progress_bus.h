@@ -0,0 +1,65 @@
+#ifndef EZ_PROGRESS_BUS_H
+#define EZ_PROGRESS_BUS_H
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "common.h"
+
+#define PROGRESS_BUS_SLOTS 256
+#define PROGRESS_BUS_SLOT_BITS 8
+#define PROGRESS_BUS_ACTIVITY_JOB 0
+#define PROGRESS_BUS_FINISHED_KEEP 10000000
+
+struct ProgressEvent
+{
+    uint32_t job_id;
+    std::string kind;
+    std::string name;
+    uint64_t bytes;
+    uint64_t total;
+    int state;
+    time_t timestamp;
+};
+
+struct ProgressSlot
+{
+    // Odd while the owner is changing the slot
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> job_id;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> total;
+    std::atomic<int> state;
+    std::atomic<int64_t> timestamp;
+    std::atomic<uint64_t> finished_at;
+    char kind[16];
+    char name[256];
+};
+
+/*
+ * Central table of running jobs and their progress, read by the web UI through
+ * /__local__/events and by the native UI.
+ * A job owns its slot from Begin to End and is the only writer of it, so
+ * Update is a few atomic stores under a per slot sequence count and never
+ * takes a lock. Readers copy a slot and retry if its count moved meanwhile.
+ * The foreground activity keeps publishing through the bytes_transfered and
+ * bytes_to_download globals as before, it shows up as job 0. Files of the
+ * transfer pool and the items of install and extract runs are jobs of their own.
+ * Background downloads live in the ezremote server, one bridge thread polls it
+ * while anyone is watching and publishes them as "background" jobs.
+ */
+namespace ProgressBus
+{
+    uint32_t Begin(const char *kind, const std::string &name, uint64_t total, time_t timestamp = 0);
+    void Update(uint32_t job_id, uint64_t bytes, uint64_t total, int state = STATE_DOWNLOADING);
+    void End(uint32_t job_id, int state);
+    uint64_t Version();
+    void Snapshot(std::vector<ProgressEvent> &events);
+    void Subscribe();
+    void Unsubscribe();
+    void KeepBackgroundBridge();
+}
+
+#endif
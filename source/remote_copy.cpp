@@ -0,0 +1,173 @@
+#include <pthread.h>
+#include "installer.h"
+#include "windows.h"
+#include "remote_copy.h"
+
+RemoteCopy::RemoteCopy(RemoteSettings *settings, RemoteClient *client, RemoteSettings *dest_settings)
+{
+    this->settings = settings;
+    this->client = client;
+    this->dest_settings = dest_settings != nullptr ? dest_settings : settings;
+    this->writer = nullptr;
+    this->native_copy = dest_settings == nullptr;
+    this->resume = dest_settings != nullptr;
+    this->progress = &bytes_transfered;
+    this->size = 0;
+    this->offset = 0;
+    this->read_result = 0;
+    this->received = 0;
+    this->read_done = false;
+    this->write_failed = false;
+    this->buffered = 0;
+}
+
+RemoteCopy::~RemoteCopy()
+{
+    if (this->writer != nullptr)
+    {
+        this->writer->Quit();
+        delete this->writer;
+    }
+}
+
+void RemoteCopy::SetProgressCounter(std::atomic<uint64_t> *counter)
+{
+    this->progress = counter;
+}
+
+int RemoteCopy::Copy(const std::string &src, const std::string &dest, uint64_t size)
+{
+    if (this->native_copy)
+    {
+        if (this->client->Copy(src, dest))
+            return 1;
+
+        // Server refused or can't copy, stream this and every remaining file
+        this->native_copy = false;
+    }
+
+    return StreamCopy(src, dest, size);
+}
+
+void *RemoteCopy::ReaderThread(void *argp)
+{
+    RemoteCopy *copy = (RemoteCopy *)argp;
+
+    DataSink sink;
+    sink.write = [copy](const char *data, size_t len) -> bool
+    {
+        std::unique_lock<std::mutex> lock(copy->mutex_);
+        while (copy->buffered >= REMOTE_COPY_MAX_BUFFERED && !copy->write_failed)
+        {
+            copy->chunks_cv.wait(lock);
+        }
+
+        if (copy->write_failed || stop_activity)
+            return false;
+
+        copy->chunks.emplace_back(data, data + len);
+        copy->buffered += len;
+        copy->received += len;
+        copy->chunks_cv.notify_all();
+        return true;
+    };
+
+    int ret = copy->client->GetRange(copy->src, sink, copy->size - copy->offset, copy->offset);
+
+    {
+        std::lock_guard<std::mutex> lock(copy->mutex_);
+        copy->read_result = ret;
+        copy->read_done = true;
+    }
+    copy->chunks_cv.notify_all();
+    return NULL;
+}
+
+int RemoteCopy::StreamCopy(const std::string &src, const std::string &dest, uint64_t size)
+{
+    if (this->writer == nullptr)
+    {
+        this->writer = INSTALLER::GetRemoteClient(this->dest_settings);
+        if (this->writer == nullptr)
+            return 0;
+        if (!this->writer->IsConnected())
+        {
+            delete this->writer;
+            this->writer = nullptr;
+            return 0;
+        }
+    }
+
+    uint64_t offset = 0;
+    if (this->resume)
+    {
+        uint64_t existing = 0;
+        if (this->writer->Size(dest, &existing) && existing <= size)
+            offset = existing;
+        if (offset == size && size > 0)
+        {
+            *this->progress += size;
+            return 1;
+        }
+    }
+
+    void *out = this->writer->OpenWrite(dest, offset);
+    if (out == nullptr)
+        return 0;
+
+    *this->progress += offset;
+    this->src = src;
+    this->size = size;
+    this->offset = offset;
+    this->read_result = 0;
+    this->received = 0;
+    this->read_done = false;
+    this->write_failed = false;
+    this->buffered = 0;
+    this->chunks.clear();
+
+    pthread_t thid;
+    if (pthread_create(&thid, NULL, ReaderThread, this) != 0)
+    {
+        this->writer->CloseWrite(out);
+        return 0;
+    }
+
+    bool success = true;
+    while (true)
+    {
+        std::vector<char> chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (this->chunks.empty() && !this->read_done)
+            {
+                this->chunks_cv.wait(lock);
+            }
+
+            if (this->chunks.empty())
+                break;
+
+            chunk.swap(this->chunks.front());
+            this->chunks.pop_front();
+            this->buffered -= chunk.size();
+        }
+        this->chunks_cv.notify_all();
+
+        if (stop_activity || !this->writer->Write(out, chunk.data(), chunk.size()))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            this->write_failed = true;
+            this->chunks_cv.notify_all();
+            success = false;
+            break;
+        }
+        *this->progress += chunk.size();
+    }
+
+    pthread_join(thid, NULL);
+    if (!this->writer->CloseWrite(out))
+        success = false;
+
+    // A read cut short still leaves a file behind, it is only a copy if all of it came through
+    return success && this->read_result > 0 && this->offset + this->received == size;
+}
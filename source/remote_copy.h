@@ -0,0 +1,57 @@
+#ifndef EZ_REMOTE_COPY_H
+#define EZ_REMOTE_COPY_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "clients/remote_client.h"
+#include "config.h"
+
+#define REMOTE_COPY_MAX_BUFFERED 8388608
+
+/*
+ * Copies files within one site, or to another site when dest_settings is given.
+ * Within a site the server side copy of the client is tried first, otherwise the
+ * file is read on the caller's session and written on a second one opened on first
+ * use, with a bounded queue between the two so both run at once and nothing is
+ * staged on the local disk.
+ * Copies to another site resume: a shorter destination file is continued from its
+ * end and one of the same size is left alone.
+ */
+class RemoteCopy
+{
+public:
+    RemoteCopy(RemoteSettings *settings, RemoteClient *client, RemoteSettings *dest_settings = nullptr);
+    ~RemoteCopy();
+    int Copy(const std::string &src, const std::string &dest, uint64_t size);
+    void SetProgressCounter(std::atomic<uint64_t> *counter);
+
+private:
+    RemoteSettings *settings;
+    RemoteClient *client;
+    RemoteSettings *dest_settings;
+    RemoteClient *writer;
+    bool native_copy;
+    bool resume;
+    std::atomic<uint64_t> *progress;
+    std::string src;
+    uint64_t size;
+    uint64_t offset;
+    int read_result;
+    // Bytes the reader got from GetRange, which succeeds on short reads too
+    uint64_t received;
+    bool read_done;
+    bool write_failed;
+    uint64_t buffered;
+    std::deque<std::vector<char>> chunks;
+    std::mutex mutex_;
+    std::condition_variable chunks_cv;
+
+    static void *ReaderThread(void *argp);
+    int StreamCopy(const std::string &src, const std::string &dest, uint64_t size);
+};
+
+#endif
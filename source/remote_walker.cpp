@@ -0,0 +1,219 @@
+#include <string.h>
+#include "installer.h"
+#include "fs.h"
+#include "remote_walker.h"
+
+typedef struct
+{
+    RemoteWalker *walker;
+    RemoteClient *session;
+} WalkerWorkerArgs;
+
+RemoteWalker::RemoteWalker(RemoteSettings *settings, RemoteClient *client, int max_sessions)
+{
+    this->settings = settings;
+    this->client = client;
+    this->max_sessions = max_sessions;
+    this->busy_workers = 0;
+    this->total_bytes = 0;
+    this->total_files = 0;
+    this->complete = false;
+    this->stopped = false;
+}
+
+RemoteWalker::~RemoteWalker()
+{
+    Stop();
+    for (int i = 0; i < this->threads.size(); i++)
+    {
+        pthread_join(this->threads[i], NULL);
+    }
+    for (int i = 0; i < this->sessions.size(); i++)
+    {
+        this->sessions[i]->Quit();
+        delete this->sessions[i];
+    }
+}
+
+void RemoteWalker::Start(const std::string &path, const std::string &dest)
+{
+    WalkItem root;
+    root.path = path;
+    root.dest = dest;
+    root.size = 0;
+    root.isDir = true;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->pending_dirs.push_back(root);
+        this->items.push_back(root);
+        this->directories.push_back(path);
+    }
+
+    // The main client stays with the caller for transfers, so listings run over extra sessions
+    for (int i = 0; i < this->max_sessions; i++)
+    {
+        RemoteClient *session = INSTALLER::GetRemoteClient(this->settings);
+        if (session == nullptr)
+            break;
+        if (!session->IsConnected())
+        {
+            delete session;
+            break;
+        }
+        this->sessions.push_back(session);
+    }
+
+    if (this->sessions.size() == 0)
+    {
+        // No extra session available, walk the whole tree up front on the caller's client
+        Walk(this->client);
+        return;
+    }
+
+    for (int i = 0; i < this->sessions.size(); i++)
+    {
+        WalkerWorkerArgs *args = (WalkerWorkerArgs *)malloc(sizeof(WalkerWorkerArgs));
+        args->walker = this;
+        args->session = this->sessions[i];
+
+        pthread_t thid;
+        if (pthread_create(&thid, NULL, WorkerThread, args) == 0)
+            this->threads.push_back(thid);
+        else
+            free(args);
+    }
+
+    if (this->threads.size() == 0)
+        Walk(this->client);
+}
+
+void *RemoteWalker::WorkerThread(void *argp)
+{
+    WalkerWorkerArgs *args = (WalkerWorkerArgs *)argp;
+    args->walker->Walk(args->session);
+    free(args);
+    return NULL;
+}
+
+void RemoteWalker::Walk(RemoteClient *session)
+{
+    while (true)
+    {
+        WalkItem dir;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (this->pending_dirs.empty() && this->busy_workers > 0 && !this->stopped)
+            {
+                this->dirs_cv.wait(lock);
+            }
+
+            if (this->stopped || (this->pending_dirs.empty() && this->busy_workers == 0))
+            {
+                this->complete = true;
+                this->dirs_cv.notify_all();
+                this->items_cv.notify_all();
+                return;
+            }
+
+            dir = this->pending_dirs.front();
+            this->pending_dirs.pop_front();
+            this->busy_workers++;
+        }
+
+        std::vector<DirEntry> entries = session->ListDir(dir.path);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int i = 0; i < entries.size(); i++)
+            {
+                if (strcmp(entries[i].name, "..") == 0)
+                    continue;
+
+                WalkItem item;
+                item.path = entries[i].path;
+                item.dest = dir.dest + (FS::hasEndSlash(dir.dest.c_str()) ? "" : "/") + entries[i].name;
+                item.isDir = entries[i].isDir;
+                item.size = entries[i].isDir ? 0 : entries[i].file_size;
+
+                if (item.isDir)
+                {
+                    this->pending_dirs.push_back(item);
+                    this->directories.push_back(item.path);
+                }
+                else
+                {
+                    this->total_bytes += item.size;
+                    this->total_files++;
+                }
+                this->items.push_back(item);
+            }
+            this->busy_workers--;
+        }
+        this->dirs_cv.notify_all();
+        this->items_cv.notify_all();
+    }
+}
+
+bool RemoteWalker::Next(WalkItem *item)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (this->items.empty() && !this->complete && !this->stopped)
+    {
+        this->items_cv.wait(lock);
+    }
+
+    if (this->items.empty() || this->stopped)
+        return false;
+
+    *item = this->items.front();
+    this->items.pop_front();
+    return true;
+}
+
+void RemoteWalker::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->stopped = true;
+    }
+    this->dirs_cv.notify_all();
+    this->items_cv.notify_all();
+}
+
+void RemoteWalker::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!this->complete && !this->stopped)
+    {
+        this->items_cv.wait(lock);
+    }
+}
+
+bool RemoteWalker::IsComplete()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->complete;
+}
+
+uint64_t RemoteWalker::TotalBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->total_bytes;
+}
+
+uint64_t RemoteWalker::TotalFiles()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->total_files;
+}
+
+/*
+ * Folders in discovery order, parents before children. Walk it backwards to
+ * remove a tree bottom-up.
+ */
+std::vector<std::string> RemoteWalker::Directories()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->directories;
+}
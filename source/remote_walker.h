@@ -0,0 +1,65 @@
+#ifndef EZ_REMOTE_WALKER_H
+#define EZ_REMOTE_WALKER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+#include "clients/remote_client.h"
+#include "config.h"
+
+#define REMOTE_WALKER_MAX_SESSIONS 4
+
+typedef struct
+{
+    std::string path;
+    std::string dest;
+    uint64_t size;
+    bool isDir;
+} WalkItem;
+
+/*
+ * Walks a remote directory tree with several ListDir calls in flight, each worker
+ * using its own session. Discovered folders and files are queued as soon as their
+ * parent is listed, so the caller can start transferring while the walk continues.
+ * A folder is always queued before any of its children.
+ */
+class RemoteWalker
+{
+public:
+    RemoteWalker(RemoteSettings *settings, RemoteClient *client, int max_sessions = REMOTE_WALKER_MAX_SESSIONS);
+    ~RemoteWalker();
+    void Start(const std::string &path, const std::string &dest);
+    bool Next(WalkItem *item);
+    void Stop();
+    void Wait();
+    bool IsComplete();
+    uint64_t TotalBytes();
+    uint64_t TotalFiles();
+    std::vector<std::string> Directories();
+
+private:
+    RemoteSettings *settings;
+    RemoteClient *client;
+    int max_sessions;
+    std::vector<RemoteClient *> sessions;
+    std::vector<pthread_t> threads;
+    std::deque<WalkItem> pending_dirs;
+    std::deque<WalkItem> items;
+    std::vector<std::string> directories;
+    int busy_workers;
+    uint64_t total_bytes;
+    uint64_t total_files;
+    bool complete;
+    bool stopped;
+    std::mutex mutex_;
+    std::condition_variable dirs_cv;
+    std::condition_variable items_cv;
+
+    static void *WorkerThread(void *argp);
+    void Walk(RemoteClient *session);
+};
+
+#endif
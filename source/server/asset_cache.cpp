@@ -0,0 +1,204 @@
+#include <sys/stat.h>
+#include <string.h>
+#include "fs.h"
+#include "server/asset_cache.h"
+
+std::mutex AssetCache::mutex_;
+std::map<std::string, std::shared_ptr<const CachedAsset>> AssetCache::assets;
+size_t AssetCache::total_size = 0;
+
+static const char *ContentType(const std::string &path, bool *compressible)
+{
+    static const struct
+    {
+        const char *ext;
+        const char *type;
+        bool compressible;
+    } types[] = {
+        {".html", "text/html", true},
+        {".js", "application/javascript", true},
+        {".css", "text/css", true},
+        {".json", "application/json", true},
+        {".svg", "image/svg+xml", true},
+        {".txt", "text/plain", true},
+        {".ico", "image/vnd.microsoft.icon", true},
+        {".ttf", "font/ttf", true},
+        {".eot", "application/vnd.ms-fontobject", true},
+        {".woff", "font/woff", false},
+        {".woff2", "font/woff2", false},
+        {".png", "image/png", false},
+        {".jpg", "image/jpeg", false},
+    };
+
+    size_t dot = path.find_last_of('.');
+    std::string ext = dot != std::string::npos ? path.substr(dot) : "";
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        if (strcasecmp(ext.c_str(), types[i].ext) == 0)
+        {
+            *compressible = types[i].compressible;
+            return types[i].type;
+        }
+    }
+    *compressible = false;
+    return "application/octet-stream";
+}
+
+bool AssetCache::AcceptsGzip(const httplib::Request &req)
+{
+    return req.get_header_value("Accept-Encoding").find("gzip") != std::string::npos;
+}
+
+bool AssetCache::Gzip(const char *data, size_t len, std::string &out)
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    // 31 is a deflate window with a gzip header
+    if (deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+
+    out.resize(deflateBound(&strm, len) + 32);
+    strm.next_in = (Bytef *)data;
+    strm.avail_in = len;
+    strm.next_out = (Bytef *)&out[0];
+    strm.avail_out = out.size();
+    int ret = deflate(&strm, Z_FINISH);
+    out.resize(strm.total_out);
+    deflateEnd(&strm);
+    return ret == Z_STREAM_END;
+}
+
+/*
+ * The cached copy of an asset, read again when the file changed. Returns
+ * nullptr for files that are missing or too large to keep.
+ */
+std::shared_ptr<const CachedAsset> AssetCache::Load(const std::string &path)
+{
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size > ASSET_CACHE_MAX_FILE)
+        return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<std::string, std::shared_ptr<const CachedAsset>>::iterator it = assets.find(path);
+        if (it != assets.end())
+        {
+            if (it->second->modified == file_stat.st_mtime && it->second->size == (size_t)file_stat.st_size)
+                return it->second;
+            total_size -= it->second->body.size() + it->second->gzip_body.size();
+            assets.erase(it);
+        }
+    }
+
+    std::vector<char> content = FS::Load(path);
+    if (content.empty())
+        return nullptr;
+
+    // FS::Load ends the data with a terminating zero
+    std::shared_ptr<CachedAsset> asset = std::make_shared<CachedAsset>();
+    asset->body.assign(content.data(), content.size() - 1);
+    asset->modified = file_stat.st_mtime;
+    asset->size = file_stat.st_size;
+
+    bool fits;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fits = total_size + asset->body.size() <= ASSET_CACHE_MAX_TOTAL;
+    }
+
+    bool compressible;
+    asset->content_type = ContentType(path, &compressible);
+    // Only worth keeping when it saves a good part of the transfer
+    if (fits && compressible && asset->body.size() >= GZIP_MIN_SIZE &&
+        (!Gzip(asset->body.data(), asset->body.size(), asset->gzip_body) || asset->gzip_body.size() > asset->body.size() * 9 / 10))
+        asset->gzip_body.clear();
+
+    char etag[64];
+    snprintf(etag, sizeof(etag), "%lx-%zx-%lx", crc32(0L, (const Bytef *)asset->body.data(), asset->body.size()),
+             asset->size, (unsigned long)asset->modified);
+    asset->etag = std::string("\"") + etag + "\"";
+    asset->gzip_etag = std::string("\"") + etag + "-gz\"";
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (total_size + asset->body.size() + asset->gzip_body.size() > ASSET_CACHE_MAX_TOTAL)
+        asset->gzip_body.clear();
+    size_t asset_size = asset->body.size() + asset->gzip_body.size();
+    if (total_size + asset_size <= ASSET_CACHE_MAX_TOTAL)
+    {
+        assets[path] = asset;
+        total_size += asset_size;
+    }
+    return asset;
+}
+
+/*
+ * Answers a GET of an asset from memory. Returns false when the request is
+ * left to the regular file handler, for ranges and files not cached.
+ */
+bool AssetCache::Serve(const httplib::Request &req, httplib::Response &res, const std::string &path)
+{
+    if (req.has_header("Range"))
+        return false;
+
+    std::shared_ptr<const CachedAsset> asset = Load(path);
+    if (asset == nullptr)
+        return false;
+
+    bool gzip = !asset->gzip_body.empty() && AcceptsGzip(req);
+    const std::string &etag = gzip ? asset->gzip_etag : asset->etag;
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", "no-cache");
+    if (!asset->gzip_body.empty())
+        res.set_header("Vary", "Accept-Encoding");
+
+    if (req.get_header_value("If-None-Match") == etag)
+    {
+        res.status = 304;
+        return true;
+    }
+
+    res.status = 200;
+    if (gzip)
+    {
+        res.set_header("Content-Encoding", "gzip");
+        res.set_content(asset->gzip_body, asset->content_type);
+    }
+    else
+    {
+        res.set_content(asset->body, asset->content_type);
+    }
+    return true;
+}
+
+GzipStream::GzipStream()
+{
+    memset(&this->strm, 0, sizeof(this->strm));
+    this->strm_init = (deflateInit2(&this->strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+}
+
+GzipStream::~GzipStream()
+{
+    if (this->strm_init)
+        deflateEnd(&this->strm);
+}
+
+int GzipStream::Write(const std::string &in, std::string &out, bool finish)
+{
+    if (!this->strm_init)
+        return 0;
+
+    char buf[16384];
+    this->strm.next_in = (Bytef *)in.data();
+    this->strm.avail_in = in.size();
+    int ret;
+    do
+    {
+        this->strm.next_out = (Bytef *)buf;
+        this->strm.avail_out = sizeof(buf);
+        ret = deflate(&this->strm, finish ? Z_FINISH : Z_NO_FLUSH);
+        if (ret == Z_STREAM_ERROR)
+            return 0;
+        out.append(buf, sizeof(buf) - this->strm.avail_out);
+    } while (this->strm.avail_out == 0 || (finish && ret != Z_STREAM_END));
+    return 1;
+}
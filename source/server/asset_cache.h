@@ -0,0 +1,65 @@
+#ifndef EZ_ASSET_CACHE_H
+#define EZ_ASSET_CACHE_H
+
+#include <time.h>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <zlib.h>
+#include "http/httplib.h"
+
+#define ASSETS_PATH "/data/homebrew/ezremote-client/assets"
+#define ASSET_CACHE_MAX_FILE 4194304
+#define ASSET_CACHE_MAX_TOTAL 16777216
+#define GZIP_MIN_SIZE 1024
+
+struct CachedAsset
+{
+    std::string body;
+    std::string gzip_body;
+    std::string etag;
+    std::string gzip_etag;
+    std::string content_type;
+    time_t modified;
+    size_t size;
+};
+
+/*
+ * Web UI assets kept in memory. A file is read once and served from memory
+ * until its size or mtime changes on disk, with an ETag so browsers
+ * revalidate with If-None-Match and get a 304 instead of the file again.
+ * Text like assets also keep a gzip copy made at load, sent to clients that
+ * accept it under an ETag of its own. Assets that don't fit in the cache are
+ * sent uncompressed rather than compressed again on every request.
+ */
+class AssetCache
+{
+public:
+    static bool Serve(const httplib::Request &req, httplib::Response &res, const std::string &path);
+    static bool AcceptsGzip(const httplib::Request &req);
+    static bool Gzip(const char *data, size_t len, std::string &out);
+
+private:
+    static std::shared_ptr<const CachedAsset> Load(const std::string &path);
+    static std::mutex mutex_;
+    static std::map<std::string, std::shared_ptr<const CachedAsset>> assets;
+    static size_t total_size;
+};
+
+/*
+ * gzip of a response produced piece by piece, for streamed JSON.
+ */
+class GzipStream
+{
+public:
+    GzipStream();
+    ~GzipStream();
+    int Write(const std::string &in, std::string &out, bool finish);
+
+private:
+    z_stream strm;
+    bool strm_init;
+};
+
+#endif
@@ -0,0 +1,287 @@
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "util.h"
+#include "server/dir_listing.h"
+
+std::mutex DirListing::cache_mutex;
+std::list<CachedListing> DirListing::cache;
+
+static std::string JoinPath(const std::string &dir, const std::string &name)
+{
+    if (!dir.empty() && dir.back() == '/')
+        return dir + name;
+    return dir + "/" + name;
+}
+
+static void AppendJsonString(std::string &out, const char *s)
+{
+    out += '"';
+    for (; *s != 0; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c < 0x20)
+        {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+static bool ContainsNoCase(const std::string &haystack, const std::string &needle)
+{
+    return std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(),
+                       [](char a, char b) { return tolower((unsigned char)a) == tolower((unsigned char)b); }) != haystack.end();
+}
+
+DirListing::DirListing(const ListingQuery &query)
+{
+    this->query = query;
+    this->dir = nullptr;
+    this->pos = 0;
+    this->written = 0;
+    this->started = false;
+    this->finished = false;
+}
+
+DirListing::~DirListing()
+{
+    if (this->dir != nullptr)
+        closedir(this->dir);
+}
+
+int DirListing::Open()
+{
+    if (this->query.sort == LISTING_SORT_NONE)
+    {
+        this->dir = opendir(this->query.path.c_str());
+        if (this->dir == nullptr)
+            return 0;
+
+        // readdir order is the cursor, entries before it are skipped unseen
+        ListingEntry entry;
+        for (size_t skipped = 0; skipped < this->query.cursor;)
+        {
+            if (!ReadEntry(entry))
+                break;
+            if (Matches(entry))
+                skipped++;
+        }
+        return 1;
+    }
+
+    int err = 0;
+    this->entries = Load(this->query, &err);
+    if (err)
+        return 0;
+    this->pos = std::min(this->query.cursor, this->entries->size());
+    return 1;
+}
+
+bool DirListing::Matches(const ListingEntry &entry)
+{
+    if (this->query.only_folders && !entry.is_dir)
+        return false;
+    return this->query.filter.empty() || ContainsNoCase(entry.name, this->query.filter);
+}
+
+int DirListing::ReadEntry(ListingEntry &entry)
+{
+    while (true)
+    {
+        struct dirent *dirent = readdir(this->dir);
+        if (dirent == nullptr)
+            return 0;
+        if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0)
+            continue;
+
+        struct stat file_stat = {0};
+        stat(JoinPath(this->query.path, dirent->d_name).c_str(), &file_stat);
+        entry.name = dirent->d_name;
+        entry.is_dir = S_ISDIR(file_stat.st_mode);
+        entry.size = entry.is_dir ? 0 : file_stat.st_size;
+        entry.modified = file_stat.st_mtime;
+        return 1;
+    }
+}
+
+void DirListing::WriteEntry(std::string &out, const ListingEntry &entry)
+{
+    char display_date[32];
+    struct tm tm;
+    localtime_r(&entry.modified, &tm);
+    snprintf(display_date, sizeof(display_date), "%04d-%02d-%02d %02d:%02d:%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+    if (this->written > 0)
+        out += ", ";
+    out += "{ \"name\": ";
+    AppendJsonString(out, entry.name.c_str());
+    out += entry.is_dir ? ", \"rights\": \"drwxrwxrwx\"" : ", \"rights\": \"rw-rw-rw-\"";
+    out += ", \"date\": \"";
+    out += display_date;
+    out += "\", \"size\": \"";
+    if (!entry.is_dir)
+        out += std::to_string(entry.size);
+    out += entry.is_dir ? "\", \"type\": \"dir\" }" : "\", \"type\": \"file\" }";
+    this->written++;
+}
+
+void DirListing::WriteEnd(std::string &out, bool more)
+{
+    out += " ]";
+    if (this->entries)
+        out += ", \"total\": " + std::to_string(this->entries->size());
+    if (more)
+        out += ", \"nextCursor\": \"" + std::to_string(this->query.cursor + this->written) + "\"";
+    else
+        out += ", \"nextCursor\": null";
+    out += " }";
+    this->finished = true;
+}
+
+int DirListing::Next(std::string &out)
+{
+    if (this->finished)
+        return 0;
+
+    if (!this->started)
+    {
+        out += "{ \"result\": [ ";
+        this->started = true;
+    }
+
+    size_t limit = this->query.limit > 0 ? this->query.limit : SIZE_MAX;
+    while (out.size() < DIR_LISTING_WRITE_SIZE)
+    {
+        if (this->entries)
+        {
+            if (this->pos >= this->entries->size())
+            {
+                WriteEnd(out, false);
+                break;
+            }
+            if (this->written >= limit)
+            {
+                WriteEnd(out, true);
+                break;
+            }
+            WriteEntry(out, (*this->entries)[this->pos++]);
+        }
+        else
+        {
+            ListingEntry entry;
+            bool found = false;
+            while (ReadEntry(entry))
+            {
+                if (Matches(entry))
+                {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found)
+            {
+                WriteEnd(out, false);
+                break;
+            }
+            // One entry past the page is read to tell if there is more
+            if (this->written >= limit)
+            {
+                WriteEnd(out, true);
+                break;
+            }
+            WriteEntry(out, entry);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Sorted and filtered entries of a folder, from the cache while the folder
+ * is unchanged. Folders always come before files, as in the native browser.
+ */
+std::shared_ptr<const std::vector<ListingEntry>> DirListing::Load(const ListingQuery &query, int *err)
+{
+    *err = 0;
+    struct stat dir_stat;
+    if (stat(query.path.c_str(), &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode))
+    {
+        *err = 1;
+        return nullptr;
+    }
+
+    std::string key = query.path + "|" + (query.only_folders ? "1" : "0") + "|" + query.filter + "|" +
+                      std::to_string(query.sort) + "|" + (query.descending ? "1" : "0");
+    uint64_t now = Util::GetTick();
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        for (std::list<CachedListing>::iterator it = cache.begin(); it != cache.end(); it++)
+        {
+            if (it->key != key)
+                continue;
+            if (it->dir_modified == dir_stat.st_mtime && now - it->created < DIR_LISTING_CACHE_TTL)
+            {
+                cache.splice(cache.begin(), cache, it);
+                return cache.front().entries;
+            }
+            cache.erase(it);
+            break;
+        }
+    }
+
+    DirListing listing(query);
+    listing.dir = opendir(query.path.c_str());
+    if (listing.dir == nullptr)
+    {
+        *err = 1;
+        return nullptr;
+    }
+
+    std::shared_ptr<std::vector<ListingEntry>> entries = std::make_shared<std::vector<ListingEntry>>();
+    ListingEntry entry;
+    while (listing.ReadEntry(entry))
+    {
+        if (listing.Matches(entry))
+            entries->push_back(entry);
+    }
+
+    ListingSort sort = query.sort;
+    bool descending = query.descending;
+    std::sort(entries->begin(), entries->end(), [sort, descending](const ListingEntry &a, const ListingEntry &b) {
+        if (a.is_dir != b.is_dir)
+            return a.is_dir;
+        int cmp = 0;
+        if (sort == LISTING_SORT_SIZE && a.size != b.size)
+            cmp = a.size < b.size ? -1 : 1;
+        else if (sort == LISTING_SORT_DATE && a.modified != b.modified)
+            cmp = a.modified < b.modified ? -1 : 1;
+        else
+            cmp = strcasecmp(a.name.c_str(), b.name.c_str());
+        return descending ? cmp > 0 : cmp < 0;
+    });
+
+    CachedListing cached;
+    cached.key = key;
+    cached.dir_modified = dir_stat.st_mtime;
+    cached.created = now;
+    cached.entries = entries;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cache.push_front(cached);
+    if (cache.size() > DIR_LISTING_CACHE_SIZE)
+        cache.pop_back();
+    return entries;
+}
@@ -0,0 +1,88 @@
+#ifndef EZ_DIR_LISTING_H
+#define EZ_DIR_LISTING_H
+
+#include <stdint.h>
+#include <time.h>
+#include <dirent.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+
+#define DIR_LISTING_CACHE_SIZE 4
+#define DIR_LISTING_CACHE_TTL 60000000
+#define DIR_LISTING_WRITE_SIZE 65536
+
+enum ListingSort
+{
+    LISTING_SORT_NONE,
+    LISTING_SORT_NAME,
+    LISTING_SORT_SIZE,
+    LISTING_SORT_DATE
+};
+
+struct ListingQuery
+{
+    std::string path;
+    bool only_folders;
+    std::string filter;
+    ListingSort sort;
+    bool descending;
+    size_t cursor;
+    size_t limit;
+};
+
+struct ListingEntry
+{
+    std::string name;
+    uint64_t size;
+    time_t modified;
+    bool is_dir;
+};
+
+struct CachedListing
+{
+    std::string key;
+    time_t dir_modified;
+    uint64_t created;
+    std::shared_ptr<const std::vector<ListingEntry>> entries;
+};
+
+/*
+ * Folder listing of /__local__/list written out as JSON a piece at a time.
+ * Entries only keep what the web file manager shows, and sorted listings are
+ * cached for a short while keyed by query and folder mtime so later pages of
+ * a cursor walk don't scan the folder again. Unsorted listings come straight
+ * from readdir and hold no list at all, so the first entries of a huge folder
+ * go out at once.
+ */
+class DirListing
+{
+public:
+    DirListing(const ListingQuery &query);
+    ~DirListing();
+    int Open();
+    // Appends the next part of the response, returns 0 once it is complete
+    int Next(std::string &out);
+
+private:
+    ListingQuery query;
+    std::shared_ptr<const std::vector<ListingEntry>> entries;
+    DIR *dir;
+    size_t pos;
+    size_t written;
+    bool started;
+    bool finished;
+
+    bool Matches(const ListingEntry &entry);
+    int ReadEntry(ListingEntry &entry);
+    void WriteEntry(std::string &out, const ListingEntry &entry);
+    void WriteEnd(std::string &out, bool more);
+
+    static std::shared_ptr<const std::vector<ListingEntry>> Load(const ListingQuery &query, int *err);
+    static std::mutex cache_mutex;
+    static std::list<CachedListing> cache;
+};
+
+#endif
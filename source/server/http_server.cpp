@@ -23,12 +23,26 @@
 #include "windows.h"
 #include "lang.h"
 #include "zip_util.h"
+#include "parallel_zip.h"
+#include "zip_stream.h"
+#include "server/upload_receiver.h"
+#include "server/request_scheduler.h"
+#include "progress_bus.h"
+#include "server/dir_listing.h"
+#include "server/asset_cache.h"
+#include "local_search.h"
+#include "disk_usage.h"
 #include "util.h"
 
 #define SUCCESS_MSG "{ \"result\": { \"success\": true, \"error\": null } }"
 #define FAILURE_MSG "{ \"result\": { \"success\": false, \"error\": \"%s\" } }"
 #define SUCCESS_MSG_LEN 48
 #define PKG_INITIAL_REQUEST_SIZE 8388608ul
+#define EVENTS_POLL_INTERVAL 250000
+#define EVENTS_KEEP_ALIVE 15000000
+#define EVENTS_MAX_DURATION 300000000
+#define SEARCH_WAIT_INTERVAL 500
+#define SEARCH_WRITE_SIZE 65536
 
 std::shared_mutex mutex_;
 
@@ -37,6 +51,7 @@ using namespace httplib;
 Server *svr;
 int http_server_port = 9090;
 int http_int_server_port = 6701;
+int http_server_workers = 16;
 char compressed_file_path[1024];
 bool web_server_enabled = false;
 
@@ -114,6 +129,23 @@ namespace HttpServer
         return;
     }
 
+    /*
+     * Sets a JSON body, gzipped when the client takes it and it is big enough
+     * to be worth it.
+     */
+    void SetJsonContent(const Request &req, Response &res, const char *json, size_t len)
+    {
+        std::string compressed;
+        if (len >= GZIP_MIN_SIZE && AssetCache::AcceptsGzip(req) && AssetCache::Gzip(json, len, compressed))
+        {
+            res.set_header("Content-Encoding", "gzip");
+            res.set_header("Vary", "Accept-Encoding");
+            res.set_content(compressed, "application/json");
+            return;
+        }
+        res.set_content(json, len, "application/json");
+    }
+
     void success(Response &res)
     {
         res.status = 200;
@@ -196,6 +228,129 @@ namespace HttpServer
         delete tmp_client;
     }
     
+    /*
+     * Sends the next piece of a split file range. Blocks on disk go out with
+     * sendfile when the connection allows it, otherwise through a buffer that is
+     * bounded no matter how large a range the installer asked for.
+     */
+    static bool SendSplitRange(SplitFile *split_file, size_t offset, size_t length, DataSink &sink)
+    {
+        length = std::min(length, CPPHTTPLIB_SEND_FILE_CHUNK_SIZE);
+        if (sink.send_file)
+            return split_file->Send(offset, length, sink.send_file) > 0;
+
+        std::vector<char> buf(length);
+        size_t bytes_read = split_file->Read(buf.data(), length, offset);
+        if (bytes_read == 0 || bytes_read == (size_t)-1)
+            return false;
+        return sink.write(buf.data(), bytes_read);
+    }
+
+    struct SentProgress
+    {
+        uint64_t bytes;
+        uint64_t total;
+        int state;
+        uint64_t tick;
+    };
+
+    struct EventStreamState
+    {
+        std::map<uint32_t, SentProgress> sent;
+        uint64_t started;
+        uint64_t last_write;
+    };
+
+    struct SearchStreamState
+    {
+        std::shared_ptr<LocalSearch> search;
+        bool started;
+        size_t written;
+    };
+
+    /*
+     * One round of /__local__/events: the jobs that changed since the last round
+     * go out as "progress" events with the rate since then, jobs that left the
+     * bus as "remove". The stream ends after a few minutes so a worker is not
+     * held forever, EventSource reconnects on its own.
+     */
+    static bool WriteProgressEvents(EventStreamState &state, DataSink &sink)
+    {
+        uint64_t now = Util::GetTick();
+        if (state.started == 0)
+        {
+            state.started = now;
+            state.last_write = now;
+            if (!sink.write("retry: 2000\n\n", 13))
+                return false;
+        }
+        else
+        {
+            usleep(EVENTS_POLL_INTERVAL);
+            now = Util::GetTick();
+        }
+
+        if (now - state.started > EVENTS_MAX_DURATION)
+        {
+            sink.done();
+            return true;
+        }
+
+        std::vector<ProgressEvent> events;
+        ProgressBus::Snapshot(events);
+
+        std::string out;
+        std::map<uint32_t, SentProgress> sent;
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            const ProgressEvent &event = events[i];
+            std::map<uint32_t, SentProgress>::iterator it = state.sent.find(event.job_id);
+            if (it != state.sent.end() && it->second.bytes == event.bytes && it->second.total == event.total &&
+                it->second.state == event.state)
+            {
+                sent[event.job_id] = it->second;
+                continue;
+            }
+
+            uint64_t rate = 0;
+            if (it != state.sent.end() && event.bytes > it->second.bytes && now > it->second.tick)
+                rate = (event.bytes - it->second.bytes) * 1000000 / (now - it->second.tick);
+
+            json_object *jobj = json_object_new_object();
+            json_object_object_add(jobj, "job", json_object_new_int64(event.job_id));
+            json_object_object_add(jobj, "kind", json_object_new_string(event.kind.c_str()));
+            json_object_object_add(jobj, "name", json_object_new_string(event.name.c_str()));
+            json_object_object_add(jobj, "bytes", json_object_new_int64(event.bytes));
+            json_object_object_add(jobj, "total", json_object_new_int64(event.total));
+            json_object_object_add(jobj, "rate", json_object_new_int64(rate));
+            json_object_object_add(jobj, "state", json_object_new_int(event.state));
+            json_object_object_add(jobj, "stateText", json_object_new_string(state_strings[event.state]));
+            json_object_object_add(jobj, "timestamp", json_object_new_int64(event.timestamp));
+            out += "event: progress\ndata: ";
+            out += json_object_to_json_string_ext(jobj, JSON_C_TO_STRING_PLAIN);
+            out += "\n\n";
+            json_object_put(jobj);
+
+            SentProgress progress = {event.bytes, event.total, event.state, now};
+            sent[event.job_id] = progress;
+        }
+
+        for (std::map<uint32_t, SentProgress>::iterator it = state.sent.begin(); it != state.sent.end(); it++)
+        {
+            if (sent.find(it->first) == sent.end())
+                out += "event: remove\ndata: {\"job\":" + std::to_string(it->first) + "}\n\n";
+        }
+        state.sent.swap(sent);
+
+        if (out.empty() && now - state.last_write > EVENTS_KEEP_ALIVE)
+            out = ": keep-alive\n\n";
+        if (out.empty())
+            return true;
+
+        state.last_write = now;
+        return sink.write(out.data(), out.size());
+    }
+
     void *ServerThread(void *argp)
     {
         svr->Get("/", [&](const Request &req, Response &res)
@@ -203,58 +358,64 @@ namespace HttpServer
 
         svr->Get("/index.html", [&](const Request &req, Response &res)
                  {
-            FILE *in = FS::OpenRead("/data/homebrew/ezremote-client/assets/index.html");
-            size_t size = FS::GetSize("/data/homebrew/ezremote-client/assets/index.html");
-            res.set_content_provider(
-                size, "text/html",
-                [in](size_t offset, size_t length, DataSink &sink) {
-                    size_t size_to_read = std::min(static_cast<size_t>(length), (size_t)1048576);
-                    char buff[size_to_read];
-                    size_t read_len;
-                    FS::Seek(in, offset);
-                    read_len = FS::Read(in, buff, size_to_read);
-                    sink.write(buff, read_len);
-                    return read_len == size_to_read;
-                },
-                [in](bool success) {
-                    FS::Close(in);
-                }); });
+            if (!AssetCache::Serve(req, res, ASSETS_PATH "/index.html") &&
+                !res.set_file_content(ASSETS_PATH "/index.html", "text/html"))
+                res.status = 404; });
 
         svr->Get("/favicon.ico", [&](const Request &req, Response &res)
                  {
-            FILE *in = FS::OpenRead("/data/homebrew/ezremote-client/assets/favicon.ico");
-            size_t size = FS::GetSize("/data/homebrew/ezremote-client/assets/favicon.ico");
-            res.set_content_provider(
-                size, "image/vnd.microsoft.icon",
-                [in](size_t offset, size_t length, DataSink &sink) {
-                    size_t size_to_read = std::min(static_cast<size_t>(length), (size_t)1048576);
-                    char buff[size_to_read];
-                    size_t read_len;
-                    FS::Seek(in, offset);
-                    read_len = FS::Read(in, buff, size_to_read);
-                    sink.write(buff, read_len);
-                    return read_len == size_to_read;
-                },
-                [in](bool success) {
-                    FS::Close(in);
-                }); });
+            if (!AssetCache::Serve(req, res, ASSETS_PATH "/favicon.ico") &&
+                !res.set_file_content(ASSETS_PATH "/favicon.ico", "image/vnd.microsoft.icon"))
+                res.status = 404; });
+
+        // Web UI assets are reached through the "/" mount point, answer them from memory first
+        svr->set_pre_routing_handler([](const Request &req, Response &res)
+        {
+            if (req.method == "GET" && req.path.compare(0, strlen(ASSETS_PATH "/"), ASSETS_PATH "/") == 0 &&
+                req.path.find("..") == std::string::npos && AssetCache::Serve(req, res, req.path))
+                return Server::HandlerResponse::Handled;
+            return Server::HandlerResponse::Unhandled;
+        });
 
         svr->Post("/__local__/list", [&](const Request &req, Response &res)
         {
-            const char *path;
-            bool onlyFolders = false;
+            ListingQuery query;
             json_object *jobj = json_tokener_parse(req.body.c_str());
             if (jobj != nullptr)
             {
-                path = json_object_get_string(json_object_object_get(jobj, "path"));
-                const char *onlyFolders_text = json_object_get_string(json_object_object_get(jobj, "onlyFolders"));
-                if (onlyFolders_text != nullptr && strcasecmp(onlyFolders_text, "true")==0)
-                    onlyFolders = true;
+                const char *path = json_object_get_string(json_object_object_get(jobj, "path"));
                 if (path == nullptr)
                 {
+                    json_object_put(jobj);
                     bad_request(res, "Required path parameter missing");
                     return;
                 }
+                query.path = path;
+
+                const char *onlyFolders_text = json_object_get_string(json_object_object_get(jobj, "onlyFolders"));
+                query.only_folders = (onlyFolders_text != nullptr && strcasecmp(onlyFolders_text, "true")==0);
+
+                const char *filter = json_object_get_string(json_object_object_get(jobj, "filter"));
+                query.filter = filter != nullptr ? filter : "";
+
+                // Sorted by name like before unless asked otherwise, "none" is readdir order
+                const char *sort = json_object_get_string(json_object_object_get(jobj, "sort"));
+                query.sort = LISTING_SORT_NAME;
+                if (sort != nullptr && strcasecmp(sort, "none") == 0)
+                    query.sort = LISTING_SORT_NONE;
+                else if (sort != nullptr && strcasecmp(sort, "size") == 0)
+                    query.sort = LISTING_SORT_SIZE;
+                else if (sort != nullptr && strcasecmp(sort, "date") == 0)
+                    query.sort = LISTING_SORT_DATE;
+
+                const char *order = json_object_get_string(json_object_object_get(jobj, "order"));
+                query.descending = (order != nullptr && strcasecmp(order, "desc") == 0);
+
+                const char *cursor = json_object_get_string(json_object_object_get(jobj, "cursor"));
+                query.cursor = cursor != nullptr ? strtoull(cursor, nullptr, 10) : 0;
+                const char *limit = json_object_get_string(json_object_object_get(jobj, "limit"));
+                query.limit = limit != nullptr ? strtoull(limit, nullptr, 10) : 0;
+                json_object_put(jobj);
             }
             else
             {
@@ -262,32 +423,196 @@ namespace HttpServer
                 return;
             }
 
-            int err;
-            std::vector<DirEntry> files = FS::ListDir(path, &err);
-            DirEntry::Sort(files);
-            json_object *json_files = json_object_new_array();
-            for (std::vector<DirEntry>::iterator it = files.begin(); it != files.end();)
+            std::shared_ptr<DirListing> listing = std::make_shared<DirListing>(query);
+            if (!listing->Open())
+            {
+                res.status = 200;
+                res.set_content("{ \"result\": [ ] }", "application/json");
+                return;
+            }
+
+            // Entries are written as they are read instead of building the whole document first
+            std::shared_ptr<GzipStream> gzip;
+            if (AssetCache::AcceptsGzip(req))
+            {
+                gzip = std::make_shared<GzipStream>();
+                res.set_header("Content-Encoding", "gzip");
+                res.set_header("Vary", "Accept-Encoding");
+            }
+
+            res.status = 200;
+            res.set_chunked_content_provider(
+                "application/json",
+                [listing, gzip](size_t offset, DataSink &sink) {
+                    std::string out;
+                    bool more = listing->Next(out);
+                    if (gzip)
+                    {
+                        std::string zout;
+                        if (!gzip->Write(out, zout, !more))
+                            return false;
+                        out.swap(zout);
+                    }
+                    if (!out.empty() && !sink.write(out.data(), out.size()))
+                        return false;
+                    if (!more)
+                        sink.done();
+                    return true;
+                }); });
+
+        svr->Post("/__local__/search", [&](const Request &req, Response &res)
+        {
+            SearchQuery query;
+            json_object *jobj = json_tokener_parse(req.body.c_str());
+            if (jobj != nullptr)
+            {
+                const char *path = json_object_get_string(json_object_object_get(jobj, "path"));
+                const char *pattern = json_object_get_string(json_object_object_get(jobj, "pattern"));
+                if (path == nullptr || pattern == nullptr || strlen(pattern) == 0)
+                {
+                    json_object_put(jobj);
+                    bad_request(res, "Required path or pattern parameter missing");
+                    return;
+                }
+                query.root = path;
+                query.pattern = pattern;
+
+                const char *contents = json_object_get_string(json_object_object_get(jobj, "contents"));
+                query.contents = (contents != nullptr && strcasecmp(contents, "true") == 0);
+                const char *ignoreCase = json_object_get_string(json_object_object_get(jobj, "ignoreCase"));
+                query.ignore_case = (ignoreCase != nullptr && strcasecmp(ignoreCase, "true") == 0);
+                const char *limit = json_object_get_string(json_object_object_get(jobj, "limit"));
+                query.limit = limit != nullptr ? strtoull(limit, nullptr, 10) : 0;
+                json_object_put(jobj);
+            }
+            else
+            {
+                bad_request(res, "Invalid payload");
+                return;
+            }
+
+            std::shared_ptr<SearchStreamState> state = std::make_shared<SearchStreamState>();
+            state->search = std::make_shared<LocalSearch>(query);
+            state->started = false;
+            state->written = 0;
+            if (!state->search->Start())
+            {
+                failed(res, 200, "Failed to start search");
+                return;
+            }
+
+            // Matches go out as the walk finds them, the search stops with the client
+            res.status = 200;
+            res.set_chunked_content_provider(
+                "application/json",
+                [state](size_t offset, DataSink &sink) {
+                    std::string out;
+                    if (!state->started)
+                    {
+                        out = "{ \"result\": [ ";
+                        state->started = true;
+                    }
+
+                    SearchMatch match;
+                    int ret = state->search->Next(match, SEARCH_WAIT_INTERVAL);
+                    while (ret > 0)
+                    {
+                        json_object *item = json_object_new_object();
+                        json_object_object_add(item, "path", json_object_new_string(match.path.c_str()));
+                        json_object_object_add(item, "type", json_object_new_string(match.is_dir ? "dir" : "file"));
+                        json_object_object_add(item, "size", json_object_new_uint64(match.size));
+                        if (match.type == SEARCH_MATCH_CONTENT)
+                        {
+                            json_object_object_add(item, "line", json_object_new_uint64(match.line));
+                            json_object_object_add(item, "text", json_object_new_string(match.text.c_str()));
+                        }
+                        json_object_object_add(item, "match", json_object_new_string(match.type == SEARCH_MATCH_NAME ? "name" : (match.type == SEARCH_MATCH_CONTENT ? "content" : "binary")));
+                        if (state->written++ > 0)
+                            out += ", ";
+                        out += json_object_to_json_string_ext(item, JSON_C_TO_STRING_PLAIN);
+                        json_object_put(item);
+
+                        if (out.size() >= SEARCH_WRITE_SIZE)
+                            break;
+                        ret = state->search->Next(match, 0);
+                    }
+
+                    if (ret == 0)
+                    {
+                        out += " ], \"truncated\": ";
+                        out += state->search->Truncated() ? "true" : "false";
+                        out += " }";
+                    }
+                    // Whitespace while nothing is found, a client that went away fails the write
+                    if (out.empty())
+                        out = " ";
+                    if (!sink.write(out.data(), out.size()))
+                        return false;
+                    if (ret == 0)
+                        sink.done();
+                    return true;
+                }); });
+
+        svr->Post("/__local__/diskUsage", [&](const Request &req, Response &res)
+        {
+            std::string path;
+            size_t limit = 0;
+            json_object *jobj = json_tokener_parse(req.body.c_str());
+            if (jobj != nullptr)
             {
-                if (((onlyFolders && it->isDir) || !onlyFolders) && strcmp(it->name, "..") != 0)
+                const char *path_text = json_object_get_string(json_object_object_get(jobj, "path"));
+                if (path_text == nullptr)
                 {
-                    json_object *new_file = json_object_new_object();
-                    char display_date[32];
-                    sprintf(display_date, "%04d-%02d-%02d %02d:%02d:%02d", it->modified.year, it->modified.month, it->modified.day, it->modified.hours, it->modified.minutes, it->modified.seconds);
-                    json_object_object_add(new_file, "name", json_object_new_string(it->name));
-                    json_object_object_add(new_file, "rights", json_object_new_string(it->isDir ? "drwxrwxrwx" : "rw-rw-rw-"));
-                    json_object_object_add(new_file, "date", json_object_new_string(display_date));
-                    json_object_object_add(new_file, "size", json_object_new_string(it->isDir ? "" : std::to_string(it->file_size).c_str()));
-                    json_object_object_add(new_file, "type", json_object_new_string(it->isDir ? "dir" : "file"));
-                    json_object_array_add(json_files, new_file);
+                    json_object_put(jobj);
+                    bad_request(res, "Required path parameter missing");
+                    return;
                 }
-                it++;
+                path = path_text;
+                const char *limit_text = json_object_get_string(json_object_object_get(jobj, "limit"));
+                limit = limit_text != nullptr ? strtoull(limit_text, nullptr, 10) : 0;
+                json_object_put(jobj);
+            }
+            else
+            {
+                bad_request(res, "Invalid payload");
+                return;
             }
-            json_object *results = json_object_new_object();
-            json_object_object_add(results, "result", json_files);
-            const char *results_str = json_object_to_json_string(results);
+
+            // The scan goes on in the background, clients ask again until it is done
+            std::shared_ptr<DiskUsage> usage = DiskUsage::Get(path);
+            if (usage == nullptr)
+            {
+                failed(res, 200, "Failed to read folder");
+                return;
+            }
+
+            std::vector<DiskUsageItem> items;
+            DiskUsageStatus status;
+            usage->Snapshot(items, status);
+
+            json_object *result = json_object_new_object();
+            json_object *result_items = json_object_new_array();
+            for (size_t i = 0; i < items.size() && (limit == 0 || i < limit); i++)
+            {
+                json_object *item = json_object_new_object();
+                json_object_object_add(item, "name", json_object_new_string(items[i].name.c_str()));
+                json_object_object_add(item, "path", json_object_new_string(items[i].path.c_str()));
+                json_object_object_add(item, "type", json_object_new_string(items[i].is_dir ? "dir" : "file"));
+                json_object_object_add(item, "size", json_object_new_uint64(items[i].size));
+                json_object_object_add(item, "files", json_object_new_uint64(items[i].files));
+                json_object_array_add(result_items, item);
+            }
+            json_object_object_add(result, "result", result_items);
+            json_object_object_add(result, "size", json_object_new_uint64(status.size));
+            json_object_object_add(result, "files", json_object_new_uint64(status.files));
+            json_object_object_add(result, "dirs", json_object_new_uint64(status.dirs));
+            json_object_object_add(result, "done", json_object_new_boolean(status.done));
+            const char *result_str = json_object_to_json_string(result);
 
             res.status = 200;
-            res.set_content(results_str, strlen(results_str), "application/json"); });
+            SetJsonContent(req, res, result_str, strlen(result_str));
+            json_object_put(result);
+        });
 
         svr->Post("/__local__/rename", [&](const Request &req, Response &res)
         {
@@ -596,11 +921,12 @@ namespace HttpServer
 
             std::vector<char> content = FS::Load(item);
             json_object *result = json_object_new_object();
-            json_object_object_add(result, "result", json_object_new_string(content.data()));
+            json_object_object_add(result, "result", json_object_new_string(content.empty() ? "" : content.data()));
             const char *result_str = json_object_to_json_string(result);
 
             res.status = 200;
-            res.set_content(result_str, strlen(result_str), "application/json");
+            SetJsonContent(req, res, result_str, strlen(result_str));
+            json_object_put(result);
         });
 
         svr->Post("/__local__/createFolder", [&](const Request &req, Response &res)
@@ -665,22 +991,32 @@ namespace HttpServer
             zipFile zf = zipOpen64(zip_file.c_str(), APPEND_STATUS_CREATE);
             if (zf != NULL)
             {
+                ParallelZip pz(zf, Z_DEFAULT_COMPRESSION);
                 size_t len = json_object_array_length(items);
                 for (size_t i=0; i < len; i++)
                 {
                     const char *item = json_object_get_string(json_object_array_get_idx(items, i));
                     std::string src = std::string(item);
                     size_t slash_pos = src.find_last_of("/");
-                    int ret = ZipUtil::ZipAddPath(zf, src, (slash_pos != std::string::npos ? slash_pos + 1 : 1), Z_DEFAULT_COMPRESSION);
+                    int ret = pz.AddPath(src, (slash_pos != std::string::npos ? slash_pos + 1 : 1));
                     if (ret != 1)
                     {
+                        pz.Finish();
                         zipClose(zf, NULL);
                         FS::Rm(zip_file);
                         failed(res, 200, "Failed to create zip");
+                        return;
                     }
                 }
+                int ret = pz.Finish();
                 zipClose(zf, NULL);
-                success(res);
+                if (ret)
+                    success(res);
+                else
+                {
+                    FS::Rm(zip_file);
+                    failed(res, 200, "Failed to create zip");
+                }
             }
             else
             {
@@ -737,79 +1073,64 @@ namespace HttpServer
             std::string destination = req.get_param_value("destination");
             std::string filename = req.get_param_value("filename");
             std::string file_path = destination + "/" + filename;
-            int64_t size = 0;
-            if (FS::FileExists(file_path))
-                size = FS::GetSize(file_path);
+            int64_t size = UploadReceiver::ResumeSize(file_path);
             std::string result_str = "{\"size\":" + std::to_string(size) + "}";
             res.status = 200;
             res.set_content(result_str.c_str(), result_str.length(), "application/json"); });
 
         svr->Post("/__local__/upload", [&](const Request &req, Response &res, const ContentReader &content_reader)
         {
-            MultipartFormDataItems items;
+            // Only the small form fields are kept, file data goes straight to disk
+            std::string field_name;
+            std::string field_value;
             std::string destination;
             size_t chunk_size = 0;
-            size_t chunk_number = -1;
+            int64_t chunk_number = -1;
             size_t total_size = 0;
-            size_t currentChunkSize = 0;
-            FILE *out = nullptr;
-            std::string new_file;
-            content_reader(
+            bool in_file = false;
+            bool write_failed = false;
+            bool complete = false;
+            UploadReceiver receiver;
+            bool received = content_reader(
                 [&](const MultipartFormData &item)
                 {
-                    items.push_back(item);
-                    if (item.name == "file")
-                    {
-                        new_file = destination + "/" + item.filename;
-                        if (out != nullptr)
-                        {
-                            FS::Close(out);
-                        }
-
-                        if (chunk_number == 0)
-                            out = FS::Create(new_file);
-                        else if (chunk_number > 0)
-                            out = FS::Append(new_file);
-                    }
-                    return true;
+                    if (in_file && !receiver.End(&complete))
+                        write_failed = true;
+                    field_name = item.name;
+                    field_value.clear();
+                    in_file = (item.name == "file");
+                    if (in_file && !receiver.Begin(destination + "/" + item.filename, chunk_number, chunk_size, total_size))
+                        write_failed = true;
+                    return !write_failed;
                 },
                 [&](const char *data, size_t data_length)
                 {
-                    items.back().content.append(data, data_length);
-                    if (items.back().name == "destination")
-                    {
-                        destination = items.back().content;
-                    }
-                    else if (items.back().name == "_chunkSize")
-                    {
-                        std::stringstream ss(items.back().content);
-                        ss >> chunk_size;
-                    }
-                    else if (items.back().name == "_chunkNumber")
-                    {
-                        std::stringstream ss(items.back().content);
-                        ss >> chunk_number;
-                    }
-                    else if (items.back().name == "_totalSize")
+                    if (in_file)
                     {
-                        std::stringstream ss(items.back().content);
-                        ss >> total_size;
-                    }
-                    else if (items.back().name == "_currentChunkSize")
-                    {
-                        std::stringstream ss(items.back().content);
-                        ss >> currentChunkSize;
-                    }
-                    else
-                    {
-                        if (out != nullptr)
-                            FS::Write(out, data, data_length);
+                        write_failed = !receiver.Write(data, data_length);
+                        return !write_failed;
                     }
+
+                    if (field_value.length() + data_length > 4096)
+                        return false;
+                    field_value.append(data, data_length);
+                    if (field_name == "destination")
+                        destination = field_value;
+                    else if (field_name == "_chunkSize")
+                        chunk_size = strtoull(field_value.c_str(), NULL, 10);
+                    else if (field_name == "_chunkNumber")
+                        chunk_number = strtoll(field_value.c_str(), NULL, 10);
+                    else if (field_name == "_totalSize")
+                        total_size = strtoull(field_value.c_str(), NULL, 10);
                     return true;
                 });
-            if (out != nullptr)
+            if (in_file && !receiver.End(&complete))
+                write_failed = true;
+
+            if (!received || write_failed)
             {
-                FS::Close(out);
+                failed(res, 500, "Failed to write file");
+                return;
             }
             success(res); });
 
@@ -822,54 +1143,74 @@ namespace HttpServer
                 return;
             }
 
-            if (!FS::FolderExists(compressed_file_path))
-                FS::MkDirs(compressed_file_path);
-
-            std::string toFilename = req.get_param_value("toFilename");
-            std::string zip_file = std::string(compressed_file_path) + "/" + toFilename;
-            zipFile zf = zipOpen64(zip_file.c_str(), APPEND_STATUS_CREATE);
-            if (zf != NULL)
+            // The zip is generated while it is sent, nothing is staged on disk. Entries
+            // are STORED unless compress=1 is asked for, which keeps the length known
+            // up front so clients get a Content-Length and can resume with ranges.
+            bool compress = req.get_param_value("compress") == "1";
+            std::shared_ptr<ZipStream> zs = std::make_shared<ZipStream>(compress);
+            int items_count = req.get_param_value_count("items");
+            for (size_t i=0; i < items_count; i++)
             {
-                int items_count = req.get_param_value_count("items");
-                for (size_t i=0; i < items_count; i++)
+                std::string src = req.get_param_value("items", i);
+                size_t slash_pos = src.find_last_of("/");
+                if (zs->AddPath(src, (slash_pos != std::string::npos ? slash_pos + 1 : 1)) != 1)
                 {
-                    std::string src = req.get_param_value("items", i);
-                    size_t slash_pos = src.find_last_of("/");
-                    int ret = ZipUtil::ZipAddPath(zf, src, (slash_pos != std::string::npos ? slash_pos + 1 : 1), Z_DEFAULT_COMPRESSION);
-                    if (ret != 1)
-                    {
-                        zipClose(zf, NULL);
-                        FS::Rm(zip_file);
-                        failed(res, 200, "Failed to create zip file");
-                        return;
-                    }
+                    failed(res, 200, "Failed to create zip file");
+                    return;
                 }
-                zipClose(zf, NULL);
+            }
 
-                // start stream the zip
-                FILE *in = FS::OpenRead(zip_file);
-                uint64_t size = FS::GetSize(zip_file);
-                res.set_header("Content-Disposition", "attachment; filename=\"" + std::string(toFilename) + "\"");
-                res.set_content_provider(
-                    size, "application/octet-stream",
-                    [in](size_t offset, size_t length, DataSink &sink) {
-                        size_t size_to_read = std::min(static_cast<size_t>(length), (size_t)1048576);
-                        char buff[size_to_read];
-                        size_t read_len;
-                        FS::Seek(in, offset);
-                        read_len = FS::Read(in, buff, size_to_read);
-                        sink.write(buff, read_len);
-                        return read_len == size_to_read;
-                    },
-                    [in, zip_file](bool success) {
-                        FS::Close(in);
-                        FS::Rm(zip_file);
+            std::string toFilename = req.get_param_value("toFilename");
+            res.set_header("Content-Disposition", "attachment; filename=\"" + std::string(toFilename) + "\"");
+            if (compress)
+            {
+                res.set_chunked_content_provider(
+                    "application/zip",
+                    [zs](size_t offset, DataSink &sink) {
+                        std::vector<uint8_t> buff(ZIP_STREAM_CHUNK_SIZE);
+                        int64_t read_len = zs->Read(buff.data(), buff.size());
+                        if (read_len > 0)
+                            return sink.write((const char *)buff.data(), read_len);
+                        sink.done();
+                        return true;
                     });
+                return;
             }
-            else
-            {
-                failed(res, 200, "Failed to create zip");
-            } });
+
+            res.set_content_provider(
+                zs->Size(), "application/zip",
+                [zs](size_t offset, size_t length, DataSink &sink) {
+                    if (!zs->Seek(offset))
+                        return false;
+                    std::vector<uint8_t> buff(std::min(length, (size_t)ZIP_STREAM_CHUNK_SIZE));
+                    int64_t read_len = zs->Read(buff.data(), buff.size());
+                    if (read_len <= 0)
+                        return false;
+                    return sink.write((const char *)buff.data(), read_len);
+                }); });
+
+        svr->Get("/__local__/events", [&](const Request &req, Response &res)
+        {
+            std::shared_ptr<EventStreamState> state = std::make_shared<EventStreamState>();
+            state->started = 0;
+            state->last_write = 0;
+
+            ProgressBus::Subscribe();
+            res.set_header("Cache-Control", "no-cache");
+            res.set_chunked_content_provider(
+                "text/event-stream",
+                [state](size_t offset, DataSink &sink) {
+                    return WriteProgressEvents(*state, sink);
+                },
+                [](bool success) {
+                    ProgressBus::Unsubscribe();
+                });
+        });
+
+        svr->Get("/__local__/scheduler", [&](const Request &req, Response &res)
+        {
+            res.set_content(RequestScheduler::Stats(), "application/json");
+        });
 
         // Download single file
         svr->Get("/__local__/downloadFile", [&](const Request &req, Response &res)
@@ -881,29 +1222,18 @@ namespace HttpServer
                 return;
             }
 
-            int64_t size = FS::GetSize(path);
-            FILE *in = FS::OpenRead(path);
-
             size_t slash_pos = path.find_last_of("/");
             std::string name = path;
             if (slash_pos != std::string::npos)
                 name = path.substr(slash_pos+1);
 
-            res.set_header("Content-Disposition", "attachment; filename=\"" + name + "\"");
-            res.set_content_provider(
-                size, "application/octet-stream",
-                [in](size_t offset, size_t length, DataSink &sink) {
-                    size_t size_to_read = std::min(static_cast<size_t>(length), (size_t)1048576);
-                    char buff[size_to_read];
-                    size_t read_len;
-                    FS::Seek(in, offset);
-                    read_len = FS::Read(in, buff, size_to_read);
-                    sink.write(buff, read_len);
-                    return read_len == size_to_read;
-                },
-                [in](bool success) {
-                    FS::Close(in);
-                }); });
+            // Sent with sendfile straight from the file, see Response::set_file_content
+            if (!res.set_file_content(path, "application/octet-stream"))
+            {
+                bad_request(res, "Failed to download");
+                return;
+            }
+            res.set_header("Content-Disposition", "attachment; filename=\"" + name + "\""); });
 
         svr->Get("/google_auth", [](const Request &req, Response &res)
         {
@@ -999,17 +1329,51 @@ namespace HttpServer
             std::string hash = req.matches[1];
             ArchivePkgInstallData *pkg_data = INSTALLER::GetArchivePkgInstallData(hash);
 
+            if (pkg_data == nullptr)
+            {
+                failed(res, 500, "Cannot resume archive_inst");
+                return;
+            }
+
             res.status = 206;
             size_t range_len = (req.ranges[0].second - req.ranges[0].first) + 1;
             std::pair<ssize_t, ssize_t> range = req.ranges[0];
+            if (pkg_data->direct)
+            {
+                // STORED entry, the range maps onto the archive itself so it must not run past the entry
+                uint64_t first = range.first;
+                uint64_t last = range.second;
+                if (range.first < 0)
+                {
+                    first = pkg_data->size - MIN((uint64_t)range.second, pkg_data->size);
+                    last = pkg_data->size - 1;
+                }
+                else if (range.second < 0 || last >= pkg_data->size)
+                {
+                    last = pkg_data->size - 1;
+                }
+                if (pkg_data->size == 0 || first > last)
+                {
+                    failed(res, 416, "Range not satisfiable");
+                    return;
+                }
+
+                range_len = last - first + 1;
+                res.set_content_provider(
+                    range_len, "application/octet-stream",
+                    [pkg_data, first, range_len](size_t offset, size_t length, DataSink &sink) {
+                        pthread_mutex_lock(&pkg_data->client_lock);
+                        int ret = pkg_data->remote_client->GetRange(pkg_data->path, sink, range_len, pkg_data->data_offset + first);
+                        pthread_mutex_unlock(&pkg_data->client_lock);
+                        return (ret==1);
+                    });
+                return;
+            }
+
             res.set_content_provider(
                 range_len, "application/octet-stream",
-                [pkg_data, range, range_len](size_t offset, size_t length, DataSink &sink) {
-                    char *buf = (char*) malloc(range_len);
-                    size_t bytes_read = pkg_data->split_file->Read(buf, range_len, range.first);
-                    sink.write(buf, bytes_read);
-                    free(buf);
-                    return true;
+                [pkg_data](size_t offset, size_t length, DataSink &sink) {
+                    return SendSplitRange(pkg_data->split_file, offset, length, sink);
                 },
                 [](bool success) {
                     return true;
@@ -1033,12 +1397,8 @@ namespace HttpServer
             std::pair<ssize_t, ssize_t> range = req.ranges[0];
             res.set_content_provider(
                 range_len, "application/octet-stream",
-                [pkg_data, range, range_len](size_t offset, size_t length, DataSink &sink) {
-                    char *buf = (char*) malloc(range_len);
-                    size_t bytes_read = pkg_data->split_file->Read(buf, range_len, range.first);
-                    sink.write(buf, bytes_read);
-                    free(buf);
-                    return true;
+                [pkg_data](size_t offset, size_t length, DataSink &sink) {
+                    return SendSplitRange(pkg_data->split_file, offset, length, sink);
                 },
                 [](bool success) {
                     return true;
@@ -1219,8 +1579,7 @@ namespace HttpServer
                 ArchiveEntry *entry = ZipUtil::GetPackageEntry(path, baseclient);
                 if (entry != nullptr)
                 {
-                    ArchivePkgInstallData *install_data = (ArchivePkgInstallData*) malloc(sizeof(ArchivePkgInstallData));
-                    memset(install_data, 0, sizeof(ArchivePkgInstallData));
+                    ArchivePkgInstallData *install_data = new ArchivePkgInstallData();
 
                     std::string install_pkg_path = std::string(temp_folder) + "/" + entry->filename;
                     SplitFile *sp = new SplitFile(install_pkg_path, INSTALL_ARCHIVE_PKG_SPLIT_SIZE);
@@ -1238,7 +1597,7 @@ namespace HttpServer
                         failed(res, 200, lang_strings[STR_FAIL_INSTALL_FROM_URL_MSG]);
                         activity_inprogess = false;
                         file_transfering = false;
-                        free(install_data);
+                        delete install_data;
                         Windows::SetModalMode(false);
                         return;
                     }
@@ -1394,7 +1753,12 @@ namespace HttpServer
     void Start()
     {
         if (svr == nullptr)
+        {
             svr = new Server();
+            // Installer streams are served ahead of web UI and bulk transfers
+            svr->new_task_queue = [] { return new RequestScheduler(http_server_workers); };
+            svr->set_write_throttle(RequestScheduler::Throttle);
+        }
         if (!svr->is_valid())
         {
             return;
@@ -3,12 +3,15 @@
 
 #include "http/httplib.h"
 
+#define HTTP_SERVER_MAX_WORKERS 64
+
 using namespace httplib;
 extern Server *svr;
 
 static pthread_t http_server_thid;
 extern int http_server_port;
 extern int http_int_server_port;
+extern int http_server_workers;
 extern char compressed_file_path[];
 extern bool web_server_enabled;
 
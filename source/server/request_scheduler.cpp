@@ -0,0 +1,237 @@
+#include <string.h>
+#include <thread>
+#include "server/request_scheduler.h"
+
+#define THROTTLE_SLICE 65536
+
+RequestClassConfig RequestScheduler::class_config[REQUEST_CLASS_COUNT] = {
+    {8, 64, 0},
+    {4, 64, 0},
+    {1, 10, 4194304},
+    {2, 4, 0},
+};
+
+std::mutex RequestScheduler::stats_mutex;
+RequestClassStats RequestScheduler::stats[REQUEST_CLASS_COUNT];
+std::chrono::steady_clock::time_point RequestScheduler::next_send[REQUEST_CLASS_COUNT];
+
+static thread_local int current_class = REQUEST_CLASS_INTERACTIVE;
+
+RequestScheduler::RequestScheduler(size_t workers)
+{
+    this->stopping = false;
+    memset(this->current_weight, 0, sizeof(this->current_weight));
+
+    for (size_t i = 0; i < workers; i++)
+    {
+        pthread_t thid;
+        if (pthread_create(&thid, NULL, WorkerThread, this) == 0)
+            this->threads.push_back(thid);
+    }
+}
+
+RequestScheduler::~RequestScheduler()
+{
+}
+
+void RequestScheduler::enqueue(std::function<void()> fn)
+{
+    Enqueue(REQUEST_CLASS_INTERACTIVE, std::move(fn));
+}
+
+void RequestScheduler::enqueue_request(std::function<void()> fn, const std::string &request_line)
+{
+    Enqueue(Classify(request_line), std::move(fn));
+}
+
+void RequestScheduler::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->stopping = true;
+    }
+    this->jobs_cv.notify_all();
+
+    for (size_t i = 0; i < this->threads.size(); i++)
+    {
+        pthread_join(this->threads[i], NULL);
+    }
+    this->threads.clear();
+}
+
+void RequestScheduler::Enqueue(RequestClass request_class, std::function<void()> fn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ScheduledRequest request;
+        request.fn = std::move(fn);
+        request.queued_at = std::chrono::steady_clock::now();
+        this->queues[request_class].push_back(std::move(request));
+
+        std::lock_guard<std::mutex> stats_lock(stats_mutex);
+        stats[request_class].queued++;
+    }
+    this->jobs_cv.notify_one();
+}
+
+/*
+ * Smooth weighted round robin over the classes that have a request waiting
+ * and a worker to spare. Returns -1 when none can run now.
+ */
+int RequestScheduler::NextClass()
+{
+    int best = -1;
+    int total = 0;
+
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    for (int i = 0; i < REQUEST_CLASS_COUNT; i++)
+    {
+        if (this->queues[i].empty() || stats[i].active >= class_config[i].max_workers)
+            continue;
+        this->current_weight[i] += class_config[i].weight;
+        total += class_config[i].weight;
+        if (best < 0 || this->current_weight[i] > this->current_weight[best])
+            best = i;
+    }
+
+    if (best >= 0)
+    {
+        this->current_weight[best] -= total;
+        stats[best].queued--;
+        stats[best].active++;
+    }
+    return best;
+}
+
+void *RequestScheduler::WorkerThread(void *argp)
+{
+    RequestScheduler *scheduler = (RequestScheduler *)argp;
+    scheduler->Work();
+    return NULL;
+}
+
+void RequestScheduler::Work()
+{
+    while (true)
+    {
+        ScheduledRequest request;
+        int request_class;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while ((request_class = NextClass()) < 0)
+            {
+                if (this->stopping)
+                {
+                    bool empty = true;
+                    for (int i = 0; i < REQUEST_CLASS_COUNT; i++)
+                        empty = empty && this->queues[i].empty();
+                    if (empty)
+                        return;
+                }
+                this->jobs_cv.wait(lock);
+            }
+            request = std::move(this->queues[request_class].front());
+            this->queues[request_class].pop_front();
+        }
+
+        uint64_t delay = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - request.queued_at).count();
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            stats[request_class].dispatched++;
+            stats[request_class].total_delay_us += delay;
+            if (delay > stats[request_class].max_delay_us)
+                stats[request_class].max_delay_us = delay;
+        }
+
+        current_class = request_class;
+        request.fn();
+        current_class = REQUEST_CLASS_INTERACTIVE;
+
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            stats[request_class].active--;
+        }
+        // A worker of a capped class is free again
+        this->jobs_cv.notify_all();
+    }
+}
+
+RequestClass RequestScheduler::Classify(const std::string &request_line)
+{
+    size_t path_start = request_line.find(' ');
+    if (path_start == std::string::npos)
+        return REQUEST_CLASS_INTERACTIVE;
+    std::string method = request_line.substr(0, path_start);
+    path_start++;
+    size_t path_end = request_line.find_first_of(" ?", path_start);
+    std::string path = request_line.substr(path_start, path_end == std::string::npos ? std::string::npos : path_end - path_start);
+
+    if (path.compare(0, 10, "/rmt_inst/") == 0 ||
+        path.compare(0, 14, "/archive_inst/") == 0 ||
+        path.compare(0, 12, "/split_inst/") == 0)
+        return REQUEST_CLASS_INSTALL;
+
+    if (path == "/__local__/downloadFile" || path == "/__local__/downloadMultiple" ||
+        path == "/__local__/compress" || path == "/__local__/extract" || path == "/__local__/upload" ||
+        path == "/__local__/search")
+        return REQUEST_CLASS_BULK;
+
+    if (path == "/__local__/events")
+        return REQUEST_CLASS_STREAM;
+
+    // Anything else read through the "/" mount point is a file download
+    if (method == "GET" && path.compare(0, 11, "/__local__/") != 0 &&
+        path != "/" && path != "/index.html" && path != "/favicon.ico" &&
+        path != "/google_auth" && path != "/stop")
+        return REQUEST_CLASS_BULK;
+
+    return REQUEST_CLASS_INTERACTIVE;
+}
+
+/*
+ * Write throttle of the server sockets. Installer writes always go out as
+ * they come, other classes are paced to their contended rate while install
+ * requests are running or queued.
+ */
+size_t RequestScheduler::Throttle(size_t size)
+{
+    int request_class = current_class;
+    uint64_t rate = class_config[request_class].contended_rate;
+    if (rate == 0)
+        return size;
+
+    std::chrono::steady_clock::time_point start;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        if (request_class == REQUEST_CLASS_INSTALL ||
+            (stats[REQUEST_CLASS_INSTALL].active == 0 && stats[REQUEST_CLASS_INSTALL].queued == 0))
+            return size;
+
+        size = std::min(size, (size_t)THROTTLE_SLICE);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        start = std::max(now, next_send[request_class]);
+        next_send[request_class] = start + std::chrono::microseconds(size * 1000000 / rate);
+    }
+    std::this_thread::sleep_until(start);
+    return size;
+}
+
+std::string RequestScheduler::Stats()
+{
+    static const char *names[REQUEST_CLASS_COUNT] = {"install", "interactive", "bulk", "stream"};
+    std::string json = "{";
+
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    for (int i = 0; i < REQUEST_CLASS_COUNT; i++)
+    {
+        char buf[256];
+        uint64_t avg = stats[i].dispatched > 0 ? stats[i].total_delay_us / stats[i].dispatched : 0;
+        snprintf(buf, sizeof(buf), "%s\"%s\": { \"dispatched\": %llu, \"avgQueueDelayUs\": %llu, \"maxQueueDelayUs\": %llu, \"queued\": %d, \"active\": %d }",
+                 i > 0 ? ", " : "", names[i], (unsigned long long)stats[i].dispatched, (unsigned long long)avg,
+                 (unsigned long long)stats[i].max_delay_us, stats[i].queued, stats[i].active);
+        json += buf;
+    }
+    json += "}";
+    return json;
+}
@@ -0,0 +1,94 @@
+#ifndef EZ_REQUEST_SCHEDULER_H
+#define EZ_REQUEST_SCHEDULER_H
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+#include "http/httplib.h"
+
+enum RequestClass
+{
+    REQUEST_CLASS_INSTALL,
+    REQUEST_CLASS_INTERACTIVE,
+    REQUEST_CLASS_BULK,
+    REQUEST_CLASS_STREAM,
+    REQUEST_CLASS_COUNT
+};
+
+struct RequestClassConfig
+{
+    // Share of dispatches while several classes have requests waiting
+    int weight;
+    // Most workers the class may hold at once
+    int max_workers;
+    // Send rate cap in bytes per second while installs are busy, 0 for none
+    uint64_t contended_rate;
+};
+
+struct RequestClassStats
+{
+    uint64_t dispatched;
+    uint64_t total_delay_us;
+    uint64_t max_delay_us;
+    int queued;
+    int active;
+};
+
+struct ScheduledRequest
+{
+    std::function<void()> fn;
+    std::chrono::steady_clock::time_point queued_at;
+};
+
+/*
+ * Worker pool of the http server that schedules requests by route.
+ * Installer range requests, web UI calls and bulk transfers are queued apart
+ * and free workers take from them by weighted round robin, with a cap on the
+ * workers each class can hold, so a few large browser downloads can't occupy
+ * every worker while the package installer waits. Long lived streams like
+ * /__local__/events hold a worker for minutes and get a class of their own
+ * with a few workers at most.
+ * While installer requests are running or queued, sockets of the other
+ * classes are paced down to their contended rate so the uplink goes to the
+ * install. Time spent queued is kept per class and reported by Stats().
+ */
+class RequestScheduler : public httplib::TaskQueue
+{
+public:
+    RequestScheduler(size_t workers);
+    ~RequestScheduler() override;
+    void enqueue(std::function<void()> fn) override;
+    void enqueue_request(std::function<void()> fn, const std::string &request_line) override;
+    void shutdown() override;
+
+    static RequestClass Classify(const std::string &request_line);
+    static size_t Throttle(size_t size);
+    static std::string Stats();
+
+    static RequestClassConfig class_config[REQUEST_CLASS_COUNT];
+
+private:
+    std::vector<pthread_t> threads;
+    std::deque<ScheduledRequest> queues[REQUEST_CLASS_COUNT];
+    int current_weight[REQUEST_CLASS_COUNT];
+    bool stopping;
+    std::mutex mutex_;
+    std::condition_variable jobs_cv;
+
+    void Enqueue(RequestClass request_class, std::function<void()> fn);
+    int NextClass();
+    static void *WorkerThread(void *argp);
+    void Work();
+
+    static std::mutex stats_mutex;
+    static RequestClassStats stats[REQUEST_CLASS_COUNT];
+    static std::chrono::steady_clock::time_point next_send[REQUEST_CLASS_COUNT];
+};
+
+#endif
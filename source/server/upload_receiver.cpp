@@ -0,0 +1,149 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include "common.h"
+#include "fs.h"
+#include "server/upload_receiver.h"
+
+std::mutex UploadReceiver::uploads_mutex;
+std::map<std::string, UploadProgress> UploadReceiver::uploads;
+
+UploadReceiver::UploadReceiver()
+{
+    this->fd = -1;
+    this->chunk_number = -1;
+    this->chunk_size = 0;
+    this->total_size = 0;
+    this->written = 0;
+    this->failed = false;
+}
+
+UploadReceiver::~UploadReceiver()
+{
+    if (this->fd >= 0)
+        close(this->fd);
+}
+
+int UploadReceiver::Begin(const std::string &path, int64_t chunk_number, uint64_t chunk_size, uint64_t total_size)
+{
+    if (this->fd >= 0)
+        close(this->fd);
+
+    this->path = path;
+    this->chunk_number = chunk_size > 0 ? chunk_number : -1;
+    this->chunk_size = chunk_size;
+    this->total_size = total_size;
+    this->written = 0;
+    this->failed = false;
+
+    if (this->chunk_number < 0)
+    {
+        this->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0777);
+        return this->fd >= 0;
+    }
+
+    // Other chunks may be written at the same time, the file is never truncated here
+    this->fd = open(path.c_str(), O_WRONLY | O_CREAT, 0777);
+    if (this->fd < 0)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(uploads_mutex);
+    std::map<std::string, UploadProgress>::iterator it = uploads.find(path);
+    if (it == uploads.end() || it->second.chunk_size != chunk_size || it->second.total_size != total_size)
+    {
+        UploadProgress progress;
+        progress.chunk_size = chunk_size;
+        progress.total_size = total_size;
+        progress.received = 0;
+        uploads[path] = progress;
+    }
+    return 1;
+}
+
+int UploadReceiver::Write(const char *data, size_t len)
+{
+    if (this->fd < 0 || this->failed)
+        return 0;
+
+    uint64_t offset = (this->chunk_number < 0 ? 0 : this->chunk_number * this->chunk_size) + this->written;
+    while (len > 0)
+    {
+        ssize_t ret = pwrite(this->fd, data, len, offset);
+        if (ret <= 0)
+        {
+            this->failed = true;
+            return 0;
+        }
+        data += ret;
+        len -= ret;
+        offset += ret;
+        this->written += ret;
+    }
+    return 1;
+}
+
+/*
+ * Closes the file and records the chunk. Sets complete when this was the last
+ * piece missing.
+ */
+int UploadReceiver::End(bool *complete)
+{
+    *complete = false;
+    if (this->fd < 0)
+        return 0;
+
+    int ret = !this->failed;
+    if (ret && this->chunk_number < 0)
+    {
+        *complete = true;
+    }
+    else if (ret)
+    {
+        uint64_t start = this->chunk_number * this->chunk_size;
+        uint64_t expected = start < this->total_size ? MIN(this->chunk_size, this->total_size - start) : 0;
+
+        std::lock_guard<std::mutex> lock(uploads_mutex);
+        std::map<std::string, UploadProgress>::iterator it = uploads.find(this->path);
+        // A chunk cut short is not counted, the client sends it again
+        if (it != uploads.end() && this->written >= expected &&
+            it->second.chunks.insert(this->chunk_number).second)
+        {
+            it->second.received += expected;
+            if (it->second.received >= it->second.total_size)
+            {
+                if (ftruncate(this->fd, this->total_size) != 0)
+                    ret = 0;
+                uploads.erase(it);
+                *complete = true;
+            }
+        }
+    }
+
+    close(this->fd);
+    this->fd = -1;
+    return ret;
+}
+
+/*
+ * Bytes the client can resume from: the run of chunks received from the start
+ * while an upload is going on, otherwise the size of the file.
+ */
+uint64_t UploadReceiver::ResumeSize(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(uploads_mutex);
+        std::map<std::string, UploadProgress>::iterator it = uploads.find(path);
+        if (it != uploads.end())
+        {
+            uint64_t chunk = 0;
+            while (it->second.chunks.count(chunk) > 0)
+            {
+                chunk++;
+            }
+            return MIN(chunk * it->second.chunk_size, it->second.total_size);
+        }
+    }
+
+    if (FS::FileExists(path))
+        return FS::GetSize(path);
+    return 0;
+}
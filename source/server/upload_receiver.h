@@ -0,0 +1,49 @@
+#ifndef EZ_UPLOAD_RECEIVER_H
+#define EZ_UPLOAD_RECEIVER_H
+
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <set>
+#include <mutex>
+
+struct UploadProgress
+{
+    uint64_t chunk_size;
+    uint64_t total_size;
+    uint64_t received;
+    std::set<uint64_t> chunks;
+};
+
+/*
+ * Writes the file part of a /__local__/upload request straight to disk.
+ * A chunk is written with pwrite at _chunkNumber * _chunkSize, so chunks of one
+ * file can arrive in any order and on several connections at once. Chunks fully
+ * received are tracked per file, once they cover _totalSize the file is cut to
+ * that size and the upload is done. An upload without chunk fields is written
+ * from the start as a whole.
+ */
+class UploadReceiver
+{
+public:
+    UploadReceiver();
+    ~UploadReceiver();
+    int Begin(const std::string &path, int64_t chunk_number, uint64_t chunk_size, uint64_t total_size);
+    int Write(const char *data, size_t len);
+    int End(bool *complete);
+    static uint64_t ResumeSize(const std::string &path);
+
+private:
+    std::string path;
+    int fd;
+    int64_t chunk_number;
+    uint64_t chunk_size;
+    uint64_t total_size;
+    uint64_t written;
+    bool failed;
+
+    static std::mutex uploads_mutex;
+    static std::map<std::string, UploadProgress> uploads;
+};
+
+#endif
@@ -52,21 +52,14 @@ size_t SplitFile::Read(char *buf, size_t buf_size, size_t offset)
     block_num = first_block_num;
     block_offset = offset % this->block_size;
 
-    while ((block_num >= this->file_blocks.size() && !this->complete) ||
-           (block_num < this->file_blocks.size() && this->file_blocks[block_num]->status == BLOCK_STATUS_NOT_EXISTS))
-    {
-        struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += 2;
-        sem_timedwait(&this->block_ready, &ts);
-    }
+    WaitBlock(block_num);
 
     // If complete and block_num is past the end, the requested offset is beyond EOF
     if (block_num >= this->file_blocks.size())
         return 0;
 
     block = this->file_blocks[block_num];
-    if (block->status == BLOCK_STATUS_DELETED)
+    if (block == nullptr || block->status == BLOCK_STATUS_DELETED)
     {
         return -1;
     }
@@ -123,14 +116,7 @@ size_t SplitFile::Read(char *buf, size_t buf_size, size_t offset)
         block_num++;
         block_offset = 0;
 
-        while ((block_num > this->file_blocks.size() - 1 && !this->complete) ||
-               (block_num < this->file_blocks.size() && this->file_blocks[block_num]->status == BLOCK_STATUS_NOT_EXISTS))
-        {
-            struct timespec ts;
-            clock_gettime(CLOCK_REALTIME, &ts);
-            ts.tv_sec += 2;
-            sem_timedwait(&this->block_ready, &ts);
-        }
+        WaitBlock(block_num);
 
         // If complete and block_num is past the end, no more data
         if (block_num >= this->file_blocks.size())
@@ -139,9 +125,70 @@ size_t SplitFile::Read(char *buf, size_t buf_size, size_t offset)
         block = this->file_blocks[block_num];
     }
 
+    DropBlocksBefore(first_block_num);
+
+    this->read_offset = offset + total_bytes_read;
+    return total_bytes_read;
+}
+
+/*
+ * Hands the bytes from offset to the end of its block to send as a file
+ * descriptor and range, so the data can go out with sendfile instead of
+ * being read into memory. Returns the bytes sent, 0 past the end of the file
+ * and -1 on error.
+ */
+ssize_t SplitFile::Send(size_t offset, size_t length, std::function<bool(int, size_t, size_t)> send)
+{
+    int block_num = offset / this->block_size;
+    size_t block_offset = offset % this->block_size;
+    FileBlock *block;
+
+    WaitBlock(block_num);
+    if (block_num >= this->file_blocks.size())
+        return 0;
+
+    block = this->file_blocks[block_num];
+    if (block == nullptr || block->status == BLOCK_STATUS_DELETED)
+        return -1;
+
+    if (block_offset >= block->size)
+        return 0;
+
+    if (block->fd == nullptr)
+    {
+        block->fd = fopen(block->block_file.c_str(), "rb");
+        if (block->fd == nullptr)
+            return -1;
+    }
+
+    size_t len = MIN(length, block->size - block_offset);
+    if (!send(fileno(block->fd), block_offset, len))
+        return -1;
+
+    DropBlocksBefore(block_num);
+
+    this->read_offset = offset + len;
+    return len;
+}
+
+void SplitFile::WaitBlock(int block_num)
+{
+    while ((block_num >= this->file_blocks.size() && !this->complete) ||
+           (block_num < this->file_blocks.size() && this->file_blocks[block_num] != nullptr &&
+            this->file_blocks[block_num]->status == BLOCK_STATUS_NOT_EXISTS))
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 2;
+        sem_timedwait(&this->block_ready, &ts);
+    }
+}
+
+void SplitFile::DropBlocksBefore(int block_num)
+{
     // delete blocks before the first read offset block. Assumuption, that reads are always
     // forward and won't read previously already read blocks. For safety, keeping only current block and 2 previous blocks
-    for (int j=0; j < first_block_num - 13; j++)
+    for (int j=0; j < block_num - 13; j++)
     {
         if (this->file_blocks[j] != nullptr && this->file_blocks[j]->status == BLOCK_STATUS_CREATED)
         {
@@ -156,9 +203,6 @@ size_t SplitFile::Read(char *buf, size_t buf_size, size_t offset)
             this->file_blocks[j] = nullptr;
         }
     }
-
-    this->read_offset = offset + total_bytes_read;
-    return total_bytes_read;
 }
 
 ssize_t SplitFile::Write(char *buf, size_t buf_size)
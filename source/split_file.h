@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <functional>
 #include <mutex>
 #include <semaphore.h>
 #include <pthread.h>
@@ -30,6 +31,7 @@ public:
     SplitFile(const std::string& path, size_t block_size);
     ~SplitFile();
     size_t Read(char* buf, size_t buf_size, size_t offset);
+    ssize_t Send(size_t offset, size_t length, std::function<bool(int, size_t, size_t)> send);
     ssize_t Write(char* buf, size_t buf_size);
     int Open();
     int Close();
@@ -48,6 +50,8 @@ private:
     std::shared_mutex mutex_;
 
     FileBlock *NewBlock();
+    void WaitBlock(int block_num);
+    void DropBlocksBefore(int block_num);
 };
 
 #endif
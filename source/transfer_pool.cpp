@@ -0,0 +1,489 @@
+#include <string.h>
+#include <unistd.h>
+#include <curl/curl.h>
+#include "clients/baseclient.h"
+#include "clients/ftpclient.h"
+#include "installer.h"
+#include "windows.h"
+#include "lang.h"
+#include "util.h"
+#include "fs.h"
+#include "progress_bus.h"
+#include "transfer_pool.h"
+
+typedef struct
+{
+    CURL *easy;
+    FILE *out;
+    TransferJob job;
+    TransferWorker *worker;
+} CurlTransfer;
+
+static int FtpCallback(int64_t xfered, void *arg)
+{
+    std::atomic<uint64_t> *bytes_transfered = (std::atomic<uint64_t> *)arg;
+    *bytes_transfered = xfered;
+    return 1;
+}
+
+static size_t CurlWriteCallback(void *ptr, size_t size, size_t nmemb, void *userp)
+{
+    CurlTransfer *xfer = (CurlTransfer *)userp;
+    size_t written = fwrite(ptr, size, nmemb, xfer->out);
+    xfer->worker->bytes_transfered += written * size;
+    return written * size;
+}
+
+TransferPool::TransferPool(RemoteSettings *settings, RemoteClient *client, TransferDirection direction, int sessions, int order, RemoteSettings *dest_settings)
+{
+    this->settings = settings;
+    this->dest_settings = dest_settings;
+    this->client = client;
+    this->direction = direction;
+    this->sessions = MAX(1, MIN(sessions, TRANSFER_MAX_SESSIONS));
+    this->order = order;
+    this->monitor_started = false;
+    this->total_bytes = 0;
+    this->done_bytes = 0;
+    this->total_files = 0;
+    this->done_files = 0;
+    this->failed_files = 0;
+    this->active_workers = 0;
+    this->closed = false;
+    this->stopped = false;
+
+    // Github and archive.org need their own request handling, every other http server is a plain GET
+    this->use_curl_multi = direction == TRANSFER_DOWNLOAD &&
+                           (client->clientType() == CLIENT_TYPE_WEBDAV ||
+                            (client->clientType() == CLIENT_TYPE_HTTP_SERVER &&
+                             strcmp(settings->http_server_type, HTTP_SERVER_GITHUB) != 0 &&
+                             strcmp(settings->http_server_type, HTTP_SERVER_ARCHIVEORG) != 0));
+}
+
+TransferPool::~TransferPool()
+{
+    Stop();
+    Wait();
+    for (int i = 0; i < this->workers.size(); i++)
+    {
+        if (this->workers[i]->copy != nullptr)
+            delete this->workers[i]->copy;
+        if (this->workers[i]->session != nullptr)
+        {
+            this->workers[i]->session->Quit();
+            delete this->workers[i]->session;
+        }
+        delete this->workers[i];
+    }
+}
+
+int TransferPool::Start()
+{
+    if (this->use_curl_multi)
+    {
+        // One thread drives all transfers, each worker is just a progress slot
+        for (int i = 0; i < this->sessions; i++)
+        {
+            TransferWorker *worker = new TransferWorker{};
+            worker->pool = this;
+            this->workers.push_back(worker);
+        }
+
+        pthread_t thid;
+        if (pthread_create(&thid, NULL, CurlMultiThread, this) != 0)
+            return 0;
+        this->threads.push_back(thid);
+        this->active_workers = 1;
+    }
+    else
+    {
+        for (int i = 0; i < this->sessions; i++)
+        {
+            RemoteClient *session = INSTALLER::GetRemoteClient(this->settings);
+            if (session == nullptr)
+                break;
+            if (!session->IsConnected())
+            {
+                delete session;
+                break;
+            }
+
+            TransferWorker *worker = new TransferWorker{};
+            worker->pool = this;
+            worker->session = session;
+            session->SetProgressCounters(&worker->bytes_transfered, &worker->bytes_to_download);
+            if (session->clientType() == CLIENT_TYPE_FTP)
+            {
+                FtpClient *ftp_client = (FtpClient *)session;
+                ftp_client->SetConnmode(FtpClient::pasv);
+                ftp_client->SetCallbackBytes(1);
+                ftp_client->SetCallbackArg(&worker->bytes_transfered);
+                ftp_client->SetCallbackXferFunction(FtpCallback);
+            }
+            if (this->direction == TRANSFER_SITE_TO_SITE)
+            {
+                worker->copy = new RemoteCopy(this->settings, session, this->dest_settings);
+                worker->copy->SetProgressCounter(&worker->bytes_transfered);
+            }
+            this->workers.push_back(worker);
+        }
+
+        for (int i = 0; i < this->workers.size(); i++)
+        {
+            pthread_t thid;
+            if (pthread_create(&thid, NULL, WorkerThread, this->workers[i]) == 0)
+            {
+                this->threads.push_back(thid);
+                this->active_workers++;
+            }
+        }
+
+        if (this->threads.size() == 0)
+            return 0;
+    }
+
+    if (pthread_create(&this->monitor_thread, NULL, MonitorThread, this) == 0)
+        this->monitor_started = true;
+
+    return 1;
+}
+
+void TransferPool::Add(const std::string &src, const std::string &dest, uint64_t size)
+{
+    TransferJob job;
+    job.src = src;
+    job.dest = dest;
+    job.size = size;
+    job.offset = 0;
+    job.ranged = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (this->order == TRANSFER_ORDER_LISTED)
+            this->pending.push_back(job);
+        else
+            this->pending_by_size.insert(std::make_pair(size, job));
+        this->total_bytes += size;
+        this->total_files++;
+    }
+    this->jobs_cv.notify_one();
+}
+
+void TransferPool::AddRange(const std::string &src, const std::string &dest, uint64_t offset, uint64_t size)
+{
+    TransferJob job;
+    job.src = src;
+    job.dest = dest;
+    job.size = size;
+    job.offset = offset;
+    job.ranged = true;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->pending.push_back(job);
+        this->total_bytes += size;
+        this->total_files++;
+    }
+    this->jobs_cv.notify_one();
+}
+
+void TransferPool::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->closed = true;
+    }
+    this->jobs_cv.notify_all();
+}
+
+void TransferPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->stopped = true;
+    }
+    this->jobs_cv.notify_all();
+}
+
+int TransferPool::Wait()
+{
+    Close();
+    for (int i = 0; i < this->threads.size(); i++)
+    {
+        pthread_join(this->threads[i], NULL);
+    }
+    this->threads.clear();
+
+    if (this->monitor_started)
+    {
+        this->done_cv.notify_all();
+        pthread_join(this->monitor_thread, NULL);
+        this->monitor_started = false;
+        UpdateProgress();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->failed_files == 0;
+}
+
+int TransferPool::FailedCount()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->failed_files;
+}
+
+bool TransferPool::HasPendingJobs()
+{
+    return !this->pending.empty() || !this->pending_by_size.empty();
+}
+
+bool TransferPool::NextJob(TransferJob *job, bool wait)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (wait && !HasPendingJobs() && !this->closed && !this->stopped && !stop_activity)
+    {
+        this->jobs_cv.wait_for(lock, std::chrono::milliseconds(200));
+    }
+
+    if (this->stopped || stop_activity || !HasPendingJobs())
+        return false;
+
+    if (!this->pending.empty())
+    {
+        *job = this->pending.front();
+        this->pending.pop_front();
+    }
+    else
+    {
+        std::multimap<uint64_t, TransferJob>::iterator it;
+        if (this->order == TRANSFER_ORDER_LARGEST_FIRST)
+            it = std::prev(this->pending_by_size.end());
+        else
+            it = this->pending_by_size.begin();
+        *job = it->second;
+        this->pending_by_size.erase(it);
+    }
+    this->current_file = job->src;
+    return true;
+}
+
+void TransferPool::JobStarted(TransferWorker *worker, const TransferJob &job)
+{
+    const char *kind = "upload";
+    if (this->direction == TRANSFER_DOWNLOAD)
+        kind = "download";
+    else if (this->direction == TRANSFER_SITE_TO_SITE)
+        kind = "copy";
+
+    uint32_t job_id = ProgressBus::Begin(kind, job.src, job.size);
+    ProgressBus::Update(job_id, 0, job.size);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    worker->bytes_transfered = 0;
+    worker->job_id = job_id;
+    worker->job_size = job.size;
+}
+
+void TransferPool::JobDone(TransferWorker *worker, const TransferJob &job, bool success)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ProgressBus::End(worker->job_id, success ? STATE_SUCCESS : STATE_FAILED);
+    worker->job_id = 0;
+    worker->job_size = 0;
+    this->done_bytes += job.size;
+    worker->bytes_transfered = 0;
+    if (success)
+    {
+        this->done_files++;
+    }
+    else
+    {
+        this->failed_files++;
+        const char *msg = lang_strings[STR_FAIL_UPLOAD_MSG];
+        if (this->direction == TRANSFER_DOWNLOAD)
+            msg = lang_strings[STR_FAIL_DOWNLOAD_MSG];
+        else if (this->direction == TRANSFER_SITE_TO_SITE)
+            msg = lang_strings[STR_FAIL_COPY_MSG];
+        sprintf(status_message, "%s %s", msg, job.src.c_str());
+    }
+}
+
+void TransferPool::WorkerExit()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->active_workers--;
+    }
+    this->done_cv.notify_all();
+}
+
+void TransferPool::UpdateProgress()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t in_flight = 0;
+    for (int i = 0; i < this->workers.size(); i++)
+    {
+        in_flight += this->workers[i]->bytes_transfered;
+        if (this->workers[i]->job_id != 0)
+            ProgressBus::Update(this->workers[i]->job_id, this->workers[i]->bytes_transfered, this->workers[i]->job_size);
+    }
+
+    bytes_to_download = this->total_bytes;
+    bytes_transfered = this->done_bytes + in_flight;
+    const char *msg = lang_strings[STR_UPLOADING];
+    if (this->direction == TRANSFER_DOWNLOAD)
+        msg = lang_strings[STR_DOWNLOADING];
+    else if (this->direction == TRANSFER_SITE_TO_SITE)
+        msg = lang_strings[STR_COPYING];
+    snprintf(activity_message, 1024, "%s %s (%d/%d)", msg,
+             this->current_file.c_str(), this->done_files + this->failed_files, this->total_files);
+}
+
+void *TransferPool::MonitorThread(void *argp)
+{
+    TransferPool *pool = (TransferPool *)argp;
+    while (true)
+    {
+        pool->UpdateProgress();
+
+        std::unique_lock<std::mutex> lock(pool->mutex_);
+        if (pool->active_workers == 0)
+            break;
+        pool->done_cv.wait_for(lock, std::chrono::milliseconds(200));
+    }
+    return NULL;
+}
+
+void *TransferPool::WorkerThread(void *argp)
+{
+    TransferWorker *worker = (TransferWorker *)argp;
+    TransferPool *pool = worker->pool;
+    TransferJob job;
+
+    while (pool->NextJob(&job, true))
+    {
+        int ret;
+        pool->JobStarted(worker, job);
+        if (job.ranged)
+            ret = worker->session->PutRange(job.src, job.dest, job.offset, job.size);
+        else if (pool->direction == TRANSFER_SITE_TO_SITE)
+            ret = worker->copy->Copy(job.src, job.dest, job.size);
+        else if (pool->direction == TRANSFER_DOWNLOAD)
+            ret = worker->session->Get(job.dest, job.src);
+        else
+            ret = worker->session->Put(job.src, job.dest);
+        pool->JobDone(worker, job, ret > 0);
+    }
+
+    pool->WorkerExit();
+    return NULL;
+}
+
+void *TransferPool::CurlMultiThread(void *argp)
+{
+    TransferPool *pool = (TransferPool *)argp;
+    BaseClient *base_client = (BaseClient *)pool->client;
+    std::vector<CurlTransfer *> slots(pool->workers.size(), nullptr);
+    CURLM *multi = curl_multi_init();
+    int active = 0;
+
+    while (true)
+    {
+        for (int i = 0; i < slots.size(); i++)
+        {
+            if (slots[i] != nullptr)
+                continue;
+
+            // Only block for new jobs when nothing is in flight
+            TransferJob job;
+            if (!pool->NextJob(&job, active == 0))
+                break;
+
+            CurlTransfer *xfer = new CurlTransfer();
+            xfer->job = job;
+            xfer->worker = pool->workers[i];
+            pool->JobStarted(xfer->worker, job);
+            xfer->out = FS::Create(job.dest);
+            if (xfer->out == nullptr)
+            {
+                pool->JobDone(xfer->worker, job, false);
+                delete xfer;
+                continue;
+            }
+
+            std::string url = base_client->GetUrl(job.src);
+            xfer->easy = curl_easy_init();
+            curl_easy_setopt(xfer->easy, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(xfer->easy, CURLOPT_WRITEFUNCTION, CurlWriteCallback);
+            curl_easy_setopt(xfer->easy, CURLOPT_WRITEDATA, xfer);
+            curl_easy_setopt(xfer->easy, CURLOPT_PRIVATE, xfer);
+            curl_easy_setopt(xfer->easy, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(xfer->easy, CURLOPT_CAINFO, CACERT_FILE);
+            curl_easy_setopt(xfer->easy, CURLOPT_SSL_VERIFYPEER, 0L);
+            curl_easy_setopt(xfer->easy, CURLOPT_SSL_VERIFYHOST, 0L);
+            curl_easy_setopt(xfer->easy, CURLOPT_BUFFERSIZE, 1048576L);
+            if (strlen(pool->settings->username) > 0)
+            {
+                curl_easy_setopt(xfer->easy, CURLOPT_USERNAME, pool->settings->username);
+                curl_easy_setopt(xfer->easy, CURLOPT_PASSWORD, pool->settings->password);
+            }
+            curl_multi_add_handle(multi, xfer->easy);
+            slots[i] = xfer;
+            active++;
+        }
+
+        if (active == 0)
+            break;
+
+        int still_running;
+        curl_multi_perform(multi, &still_running);
+
+        CURLMsg *msg;
+        int msgs_left;
+        while ((msg = curl_multi_info_read(multi, &msgs_left)) != nullptr)
+        {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            CurlTransfer *xfer;
+            long response_code = 0;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&xfer);
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &response_code);
+            bool success = msg->data.result == CURLE_OK && HTTP_SUCCESS(response_code);
+
+            curl_multi_remove_handle(multi, xfer->easy);
+            curl_easy_cleanup(xfer->easy);
+            FS::Close(xfer->out);
+            pool->JobDone(xfer->worker, xfer->job, success);
+
+            for (int i = 0; i < slots.size(); i++)
+            {
+                if (slots[i] == xfer)
+                    slots[i] = nullptr;
+            }
+            delete xfer;
+            active--;
+        }
+
+        if (stop_activity)
+        {
+            for (int i = 0; i < slots.size(); i++)
+            {
+                if (slots[i] == nullptr)
+                    continue;
+                curl_multi_remove_handle(multi, slots[i]->easy);
+                curl_easy_cleanup(slots[i]->easy);
+                FS::Close(slots[i]->out);
+                delete slots[i];
+                slots[i] = nullptr;
+            }
+            break;
+        }
+
+        curl_multi_wait(multi, NULL, 0, 200, NULL);
+    }
+
+    curl_multi_cleanup(multi);
+    pool->WorkerExit();
+    return NULL;
+}
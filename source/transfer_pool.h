@@ -0,0 +1,122 @@
+#ifndef EZ_TRANSFER_POOL_H
+#define EZ_TRANSFER_POOL_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+#include "clients/remote_client.h"
+#include "config.h"
+#include "remote_copy.h"
+
+#define TRANSFER_MAX_SESSIONS 8
+#define TRANSFER_DEFAULT_SESSIONS 4
+#define SEGMENTED_UPLOAD_MIN_SIZE 67108864
+#define SEGMENTED_UPLOAD_CHUNK_SIZE 33554432
+
+enum TransferDirection
+{
+    TRANSFER_DOWNLOAD,
+    TRANSFER_UPLOAD,
+    TRANSFER_SITE_TO_SITE
+};
+
+enum TransferOrder
+{
+    TRANSFER_ORDER_LISTED = 0,
+    TRANSFER_ORDER_LARGEST_FIRST,
+    TRANSFER_ORDER_SMALLEST_FIRST
+};
+
+typedef struct
+{
+    std::string src;
+    std::string dest;
+    uint64_t size;
+    uint64_t offset;
+    bool ranged;
+} TransferJob;
+
+class TransferPool;
+
+typedef struct
+{
+    TransferPool *pool;
+    RemoteClient *session;
+    RemoteCopy *copy;
+    // Written by the worker's transfer, read by the monitor thread
+    std::atomic<uint64_t> bytes_transfered;
+    uint64_t bytes_to_download;
+    // ProgressBus job of the file in flight and its size, 0 when idle
+    uint32_t job_id;
+    uint64_t job_size;
+} TransferWorker;
+
+/*
+ * Runs the files of a multi-file selection over several sessions of the same site.
+ * Jobs can be added while the pool is running, workers pull them from a shared queue
+ * in the configured order. The pool publishes the combined progress of all workers
+ * through the global bytes_transfered/bytes_to_download counters, and each file in
+ * flight as its own ProgressBus job.
+ * Downloads from plain http servers are driven by one curl multi handle instead.
+ * Site to site jobs read on the worker's session and stream into a session of
+ * dest_settings, see RemoteCopy.
+ * Ranged jobs write one segment of a large upload at its offset, they are always
+ * picked before whole-file jobs and in the order they were added.
+ */
+class TransferPool
+{
+public:
+    TransferPool(RemoteSettings *settings, RemoteClient *client, TransferDirection direction, int sessions, int order, RemoteSettings *dest_settings = nullptr);
+    ~TransferPool();
+    int Start();
+    void Add(const std::string &src, const std::string &dest, uint64_t size);
+    void AddRange(const std::string &src, const std::string &dest, uint64_t offset, uint64_t size);
+    void Close();
+    int Wait();
+    void Stop();
+    int FailedCount();
+
+private:
+    RemoteSettings *settings;
+    RemoteSettings *dest_settings;
+    RemoteClient *client;
+    TransferDirection direction;
+    int sessions;
+    int order;
+    bool use_curl_multi;
+    std::vector<TransferWorker *> workers;
+    std::vector<pthread_t> threads;
+    pthread_t monitor_thread;
+    bool monitor_started;
+    std::deque<TransferJob> pending;
+    std::multimap<uint64_t, TransferJob> pending_by_size;
+    uint64_t total_bytes;
+    uint64_t done_bytes;
+    int total_files;
+    int done_files;
+    int failed_files;
+    int active_workers;
+    bool closed;
+    bool stopped;
+    std::string current_file;
+    std::mutex mutex_;
+    std::condition_variable jobs_cv;
+    std::condition_variable done_cv;
+
+    static void *WorkerThread(void *argp);
+    static void *CurlMultiThread(void *argp);
+    static void *MonitorThread(void *argp);
+    bool NextJob(TransferJob *job, bool wait);
+    bool HasPendingJobs();
+    void JobStarted(TransferWorker *worker, const TransferJob &job);
+    void JobDone(TransferWorker *worker, const TransferJob &job, bool success);
+    void WorkerExit();
+    void UpdateProgress();
+};
+
+#endif
@@ -18,9 +18,12 @@
 #include "textures.h"
 #include "sfo.h"
 #include "sceSystemService.h"
+#include "archive_index.h"
+#include "disk_usage.h"
 
 #define MAX_IMAGE_HEIGHT 980
 #define MAX_IMAGE_WIDTH 1820
+#define DISK_USAGE_SHOWN_ITEMS 10
 
 extern "C"
 {
@@ -40,6 +43,8 @@ static ime_callback_t ime_cancelled = nullptr;
 static std::vector<std::string> *ime_multi_field;
 static char *ime_single_field;
 static int ime_field_size;
+static std::shared_ptr<DiskUsage> properties_usage;
+static std::string properties_usage_path;
 static bool show_ezremote_server_warning;
 
 static char txt_http_server_port[6];
@@ -48,9 +53,11 @@ static char txt_bg_download_size[32];
 bool is_server_started = false;
 bool ezremote_server_version_match = true;
 bool handle_updates = false;
-uint64_t bytes_transfered;
+std::atomic<uint64_t> bytes_transfered;
 uint64_t bytes_to_download;
 uint64_t prev_tick;
+uint64_t total_bytes_to_transfer;
+uint64_t total_bytes_transfered;
 
 std::vector<DirEntry> local_files;
 std::vector<DirEntry> remote_files;
@@ -67,6 +74,7 @@ char status_message[1024];
 char local_file_to_select[256];
 char remote_file_to_select[256];
 char local_filter[32];
+char local_search_text[128];
 char remote_filter[32];
 char dialog_editor_text[1024];
 char activity_message[1024];
@@ -81,6 +89,7 @@ bool select_url_inprogress = false;
 int favorite_url_idx = 0;
 char extract_zip_folder[256];
 char zip_file_path[384];
+char send_to_site[32];
 bool show_settings = false;
 bool show_bg_download_progress = false;
 uint64_t refresh_bg_download_time;
@@ -798,11 +807,11 @@ namespace Windows
             if (ImGui::Selectable(item.name, false, ImGuiSelectableFlags_SpanAllColumns, ImVec2(919, 0)))
             {
                 selected_remote_file = item;
-                if (item.isDir)
+                if (item.isDir || ArchiveIndex::IsArchive(item.name))
                 {
                     selected_action = ACTION_CHANGE_REMOTE_DIRECTORY;
                 }
-                else
+                else if (ArchiveIndex::Find(remote_settings->site_name, item.path) == nullptr)
                 {
                     std::string filename = Util::ToLower(selected_remote_file.name);
                     size_t dot_pos = filename.find_last_of(".");
@@ -940,6 +949,16 @@ namespace Windows
         EndGroupPanel();
     }
 
+    /*
+     * Inside an archive opened as a folder only downloads make sense.
+     */
+    uint32_t RemoteSupportedActions()
+    {
+        if (ArchiveIndex::Find(remote_settings->site_name, remote_directory) != nullptr)
+            return REMOTE_ACTION_DOWNLOAD;
+        return remoteclient->SupportedActions();
+    }
+
     int getSelectableFlag(uint32_t remote_action)
     {
         int flag = ImGuiSelectableFlags_Disabled;
@@ -948,7 +967,7 @@ namespace Windows
 
         if ((local_browser_selected && selected_local_file.selectable) ||
             (remote_browser_selected && selected_remote_file.selectable &&
-             remoteclient != nullptr && (remoteclient->SupportedActions() & remote_action)))
+             remoteclient != nullptr && (RemoteSupportedActions() & remote_action)))
         {
             flag = ImGuiSelectableFlags_None;
         }
@@ -1038,7 +1057,7 @@ namespace Windows
             flags = ImGuiSelectableFlags_Disabled;
             if ((local_browser_selected && local_paste_files.size() > 0) ||
                 (remote_browser_selected && remote_paste_files.size() > 0 &&
-                 remoteclient != nullptr && (remoteclient->SupportedActions() | REMOTE_ACTION_PASTE)))
+                 remoteclient != nullptr && (RemoteSupportedActions() | REMOTE_ACTION_PASTE)))
                 flags = ImGuiSelectableFlags_None;
             if (ImGui::Selectable(lang_strings[STR_PASTE], false, flags | ImGuiSelectableFlags_DontClosePopups, ImVec2(220, 0)))
             {
@@ -1115,7 +1134,7 @@ namespace Windows
 
             ImGui::PushID("New Folder##settings");
             flags = ImGuiSelectableFlags_None;
-            if (remote_browser_selected && remoteclient != nullptr && !(remoteclient->SupportedActions() & REMOTE_ACTION_NEW_FOLDER))
+            if (remote_browser_selected && remoteclient != nullptr && !(RemoteSupportedActions() & REMOTE_ACTION_NEW_FOLDER))
             {
                 flags = ImGuiSelectableFlags_Disabled;
             }
@@ -1133,7 +1152,7 @@ namespace Windows
 
             ImGui::PushID("New File##settings");
             flags = ImGuiSelectableFlags_None;
-            if (remote_browser_selected && remoteclient != nullptr && !(remoteclient->SupportedActions() & REMOTE_ACTION_NEW_FILE))
+            if (remote_browser_selected && remoteclient != nullptr && !(RemoteSupportedActions() & REMOTE_ACTION_NEW_FILE))
             {
                 flags = ImGuiSelectableFlags_Disabled;
             }
@@ -1149,9 +1168,28 @@ namespace Windows
             ImGui::PopID();
             ImGui::Separator();
 
+            if (local_browser_selected)
+            {
+                ImGui::PushID("SearchInFiles##settings");
+                if (ImGui::Selectable(lang_strings[STR_SEARCH_IN_FILES], false, ImGuiSelectableFlags_DontClosePopups, ImVec2(220, 0)))
+                {
+                    ResetImeCallbacks();
+                    ime_single_field = local_search_text;
+                    ime_field_size = 127;
+                    ime_callback = SingleValueImeCallback;
+                    ime_after_update = AfterLocalSearchCallback;
+                    Dialog::initImeDialog(lang_strings[STR_SEARCH_IN_FILES], local_search_text, 127, SCE_IME_TYPE_DEFAULT, 410, 350);
+                    gui_mode = GUI_MODE_IME;
+                    SetModalMode(false);
+                    ImGui::CloseCurrentPopup();
+                }
+                ImGui::PopID();
+                ImGui::Separator();
+            }
+
             ImGui::PushID("Edit##settings");
             flags = ImGuiSelectableFlags_None;
-            if ((remote_browser_selected && remoteclient != nullptr && (!(remoteclient->SupportedActions() & REMOTE_ACTION_EDIT) || selected_remote_file.isDir)) ||
+            if ((remote_browser_selected && remoteclient != nullptr && (!(RemoteSupportedActions() & REMOTE_ACTION_EDIT) || selected_remote_file.isDir)) ||
                 (local_browser_selected && selected_local_file.isDir))
             {
                 flags = ImGuiSelectableFlags_Disabled;
@@ -1217,10 +1255,31 @@ namespace Windows
                 ImGui::Separator();
 
                 flags = getSelectableFlag(REMOTE_ACTION_UPLOAD);
-                if (local_browser_selected && remoteclient != nullptr && !(remoteclient->SupportedActions() & REMOTE_ACTION_UPLOAD))
+                if (local_browser_selected && remoteclient != nullptr && !(RemoteSupportedActions() & REMOTE_ACTION_UPLOAD))
                 {
                     flags = ImGuiSelectableFlags_Disabled;
                 }
+                ImGui::PushID("UploadZip##settings");
+                if (ImGui::Selectable(lang_strings[STR_UPLOAD_ZIP], false, flags | ImGuiSelectableFlags_DontClosePopups, ImVec2(220, 0)))
+                {
+                    std::string zipname = getUniqueZipFilename();
+                    zipname = zipname.substr(zipname.find_last_of("/") + 1);
+
+                    ResetImeCallbacks();
+                    sprintf(zip_file_path, "%s%s%s", remote_directory, FS::hasEndSlash(remote_directory) ? "" : "/", zipname.c_str());
+                    ime_single_field = zip_file_path;
+                    ime_field_size = 383;
+                    ime_callback = SingleValueImeCallback;
+                    ime_after_update = AfterUploadZipCallback;
+                    Dialog::initImeDialog(lang_strings[STR_ZIP_FILE_PATH], zip_file_path, 383, SCE_IME_TYPE_DEFAULT, 600, 350);
+                    gui_mode = GUI_MODE_IME;
+                    file_transfering = true;
+                    SetModalMode(false);
+                    ImGui::CloseCurrentPopup();
+                }
+                ImGui::PopID();
+                ImGui::Separator();
+
                 ImGui::PushID("Upload##settings");
                 if (ImGui::Selectable(lang_strings[STR_UPLOAD], false, flags | ImGuiSelectableFlags_DontClosePopups, ImVec2(220, 0)))
                 {
@@ -1258,6 +1317,34 @@ namespace Windows
                     ImGui::CloseCurrentPopup();
                 }
                 ImGui::PopID();
+                ImGui::Separator();
+
+                ImGui::PushID("SendToSite##settings");
+                if (ImGui::BeginMenu(lang_strings[STR_SEND_TO_SITE], getSelectableFlag(REMOTE_ACTION_DOWNLOAD) == ImGuiSelectableFlags_None))
+                {
+                    for (int n = 0; n < sites.size(); n++)
+                    {
+                        RemoteSettings *settings = &site_settings[sites[n]];
+                        // Only backends with a streaming writer can receive files
+                        if (strcmp(sites[n].c_str(), last_site) == 0 ||
+                            (settings->type != CLIENT_TYPE_FTP && settings->type != CLIENT_TYPE_SFTP &&
+                             settings->type != CLIENT_TYPE_SMB && settings->type != CLIENT_TYPE_NFS))
+                            continue;
+
+                        char site_display[300];
+                        sprintf(site_display, "%s %d    %s", lang_strings[STR_SITE], n + 1, settings->server);
+                        if (ImGui::MenuItem(site_display))
+                        {
+                            sprintf(send_to_site, "%s", sites[n].c_str());
+                            selected_action = ACTION_SEND_TO_SITE;
+                            file_transfering = true;
+                            SetModalMode(false);
+                            ImGui::CloseCurrentPopup();
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
+                ImGui::PopID();
                 ImGui::Separator();
 
                  ImGui::PushID("Install##remote");
@@ -1398,8 +1485,24 @@ namespace Windows
         SetModalMode(true);
         ImGui::OpenPopup(lang_strings[STR_PROPERTIES]);
 
-        ImGui::SetNextWindowPos(ImVec2(610, 400));
-        ImGui::SetNextWindowSizeConstraints(ImVec2(700, 80), ImVec2(700, 250), NULL, NULL);
+        // Local folders get their size added up in the background while the dialog is open
+        bool show_usage = selected_action == ACTION_SHOW_LOCAL_PROPERTIES && item.isDir && strcmp(item.name, "..") != 0;
+        if (show_usage && properties_usage_path != item.path)
+        {
+            properties_usage = DiskUsage::Get(item.path);
+            properties_usage_path = item.path;
+        }
+        std::vector<DiskUsageItem> usage_items;
+        DiskUsageStatus usage_status;
+        if (show_usage && properties_usage != nullptr)
+        {
+            properties_usage->Snapshot(usage_items, usage_status);
+            item.file_size = usage_status.size;
+            DirEntry::SetDisplaySize(&item);
+        }
+
+        ImGui::SetNextWindowPos(ImVec2(610, show_usage ? 250 : 400));
+        ImGui::SetNextWindowSizeConstraints(ImVec2(700, 80), ImVec2(700, show_usage ? 700 : 250), NULL, NULL);
         if (ImGui::BeginPopupModal(lang_strings[STR_PROPERTIES], NULL, ImGuiWindowFlags_AlwaysAutoResize))
         {
             ImGui::TextColored(colors[ImGuiCol_ButtonHovered], "%s:", lang_strings[STR_TYPE]);
@@ -1427,6 +1530,28 @@ namespace Windows
                         item.modified.hours, item.modified.minutes, item.modified.seconds);
             ImGui::Separator();
 
+            if (show_usage && properties_usage != nullptr)
+            {
+                ImGui::TextColored(colors[ImGuiCol_ButtonHovered], "%s:", lang_strings[STR_LARGEST_ITEMS]);
+                if (!usage_status.done)
+                {
+                    ImGui::SameLine();
+                    ImGui::Text("%s... (%lu)", lang_strings[STR_SCANNING], usage_status.dirs);
+                }
+                for (size_t i = 0; i < usage_items.size() && i < DISK_USAGE_SHOWN_ITEMS; i++)
+                {
+                    DirEntry usage_entry;
+                    usage_entry.file_size = usage_items[i].size;
+                    DirEntry::SetDisplaySize(&usage_entry);
+                    ImGui::SetCursorPosX(30);
+                    ImGui::Text("%s%s", usage_items[i].name.c_str(), usage_items[i].is_dir ? "/" : "");
+                    ImGui::SameLine();
+                    ImGui::SetCursorPosX(550);
+                    ImGui::Text("%s", usage_entry.display_size);
+                }
+                ImGui::Separator();
+            }
+
             ImGui::SetCursorPosX(ImGui::GetCursorPosX() + 300);
             ImGui::SetCursorPosY(ImGui::GetCursorPosY() + 5);
 
@@ -1434,6 +1559,8 @@ namespace Windows
             sprintf(id, "%s##prodialog", lang_strings[STR_CLOSE]);
             if (ImGui::Button(id, ImVec2(100, 0)))
             {
+                properties_usage = nullptr;
+                properties_usage_path.clear();
                 SetModalMode(false);
                 selected_action = ACTION_NONE;
                 ImGui::CloseCurrentPopup();
@@ -1482,6 +1609,16 @@ namespace Windows
 
                     sprintf(progress_text, "%.2f MB/s", transfer_speed);
                     ImGui::ProgressBar(progress, ImVec2(625, 0), progress_text);
+
+                    if (total_bytes_to_transfer > 0)
+                    {
+                        static float total_progress = 0.0f;
+                        static char total_progress_text[64];
+
+                        total_progress = (total_bytes_transfered + bytes_transfered) * 1.0f / (float)total_bytes_to_transfer;
+                        sprintf(total_progress_text, "%.2f / %.2f MB", (total_bytes_transfered + bytes_transfered) / 1048576.0f, total_bytes_to_transfer / 1048576.0f);
+                        ImGui::ProgressBar(total_progress, ImVec2(625, 0), total_progress_text);
+                    }
                 }
 
                 ImGui::Separator();
@@ -1972,6 +2109,34 @@ namespace Windows
                 ImGui::PopStyleVar();
                 ImGui::Separator();
 
+                ImGui::SetCursorPosX(ImGui::GetCursorPosX() + 15);
+                ImGui::Text("%s", lang_strings[STR_PARALLEL_TRANSFERS]);
+                ImGui::SameLine();
+                ImGui::SetCursorPosX(ImGui::GetCursorPosX() + 15);
+                ImGui::SetNextItemWidth(835 - ImGui::GetCursorPosX());
+                ImGui::SliderInt("##transfer_sessions", &remote_settings->transfer_sessions, 1, TRANSFER_MAX_SESSIONS);
+                ImGui::Separator();
+
+                const char *transfer_orders[] = {lang_strings[STR_ORDER_AS_LISTED], lang_strings[STR_LARGEST_FIRST], lang_strings[STR_SMALLEST_FIRST]};
+                ImGui::SetCursorPosX(ImGui::GetCursorPosX() + 15);
+                ImGui::Text("%s", lang_strings[STR_TRANSFER_ORDER]);
+                ImGui::SameLine();
+                ImGui::SetCursorPosX(ImGui::GetCursorPosX() + 15);
+                ImGui::SetNextItemWidth(835 - ImGui::GetCursorPosX());
+                if (ImGui::BeginCombo("##transfer_order", transfer_orders[transfer_order], ImGuiComboFlags_PopupAlignLeft))
+                {
+                    for (int n = 0; n < 3; n++)
+                    {
+                        const bool is_selected = transfer_order == n;
+                        if (ImGui::Selectable(transfer_orders[n], is_selected))
+                            transfer_order = n;
+                        if (is_selected)
+                            ImGui::SetItemDefaultFocus();
+                    }
+                    ImGui::EndCombo();
+                }
+                ImGui::Separator();
+
                 // Web Server settings
                 ImGui::TextColored(colors[ImGuiCol_ButtonHovered], "%s", lang_strings[STR_WEB_SERVER]);
                 ImGui::Separator();
@@ -2120,6 +2285,7 @@ namespace Windows
                 {
                     show_settings = false;
                     CONFIG::SaveGlobalConfig();
+                    CONFIG::SaveConfig();
                     SetModalMode(false);
                     ImGui::CloseCurrentPopup();
                 }
@@ -2133,6 +2299,7 @@ namespace Windows
                 {
                     show_settings = false;
                     CONFIG::SaveGlobalConfig();
+                    CONFIG::SaveConfig();
                     SetModalMode(false);
                     ImGui::CloseCurrentPopup();
                 }
@@ -2375,6 +2542,15 @@ namespace Windows
             selected_action = ACTION_NONE;
             Actions::ExtractLocalZips();
             break;
+        case ACTION_SEND_TO_SITE:
+            sprintf(status_message, "%s", "");
+            activity_inprogess = true;
+            sprintf(activity_message, "%s", "");
+            stop_activity = false;
+            file_transfering = true;
+            selected_action = ACTION_NONE;
+            Actions::SendToSite();
+            break;
         case ACTION_EXTRACT_REMOTE_ZIP:
             sprintf(status_message, "%s", "");
             activity_inprogess = true;
@@ -2384,6 +2560,18 @@ namespace Windows
             selected_action = ACTION_NONE;
             Actions::ExtractRemoteZips();
             break;
+        case ACTION_SEARCH_LOCAL_FILES:
+            sprintf(status_message, "%s", "");
+            activity_inprogess = true;
+            sprintf(activity_message, "%s", "");
+            stop_activity = false;
+            selected_action = ACTION_NONE;
+            Actions::SearchLocalFiles(local_search_text);
+            break;
+        case ACTION_SHOW_LOCAL_SEARCH_RESULTS:
+            Actions::ShowLocalSearchResults();
+            selected_action = ACTION_NONE;
+            break;
         case ACTION_CREATE_LOCAL_ZIP:
             sprintf(status_message, "%s", "");
             activity_inprogess = true;
@@ -2393,6 +2581,15 @@ namespace Windows
             selected_action = ACTION_NONE;
             Actions::MakeLocalZip();
             break;
+        case ACTION_UPLOAD_ZIP:
+            sprintf(status_message, "%s", "");
+            activity_inprogess = true;
+            sprintf(activity_message, "%s", "");
+            stop_activity = false;
+            file_transfering = true;
+            selected_action = ACTION_NONE;
+            Actions::UploadZip();
+            break;
         case ACTION_RENAME_LOCAL:
             if (gui_mode != GUI_MODE_IME)
             {
@@ -2797,6 +2994,17 @@ namespace Windows
         selected_action = ACTION_CREATE_LOCAL_ZIP;
     }
 
+    void AfterLocalSearchCallback(int ime_result)
+    {
+        if (ime_result == IME_DIALOG_RESULT_FINISHED && strlen(local_search_text) > 0)
+            selected_action = ACTION_SEARCH_LOCAL_FILES;
+    }
+
+    void AfterUploadZipCallback(int ime_result)
+    {
+        selected_action = ACTION_UPLOAD_ZIP;
+    }
+
     void AferServerChangeCallback(int ime_result)
     {
         if (ime_result == IME_DIALOG_RESULT_FINISHED)
@@ -3,6 +3,7 @@
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include <set>
+#include <atomic>
 #include "imgui.h"
 #include "imgui_internal.h"
 #include "common.h"
@@ -14,9 +15,11 @@
 
 extern int view_mode;
 extern bool handle_updates;
-extern uint64_t bytes_transfered;
+extern std::atomic<uint64_t> bytes_transfered;
 extern uint64_t bytes_to_download;
 extern uint64_t prev_tick;;
+extern uint64_t total_bytes_to_transfer;
+extern uint64_t total_bytes_transfered;
 extern std::vector<DirEntry> local_files;
 extern std::vector<DirEntry> remote_files;
 extern std::set<DirEntry> multi_selected_local_files;
@@ -43,6 +46,7 @@ extern ACTIONS action_to_take;
 extern bool file_transfering;
 extern char extract_zip_folder[];
 extern char zip_file_path[];
+extern char send_to_site[];
 extern std::vector<std::string> edit_buffer;
 extern bool is_server_started;
 extern bool ezremote_server_version_match;
@@ -212,6 +216,8 @@ namespace Windows
     void AfterExtractFolderCallback(int ime_result);
     void AfterExtractRemoteFolderCallback(int ime_result);
     void AfterZipFileCallback(int ime_result);
+    void AfterLocalSearchCallback(int ime_result);
+    void AfterUploadZipCallback(int ime_result);
     void AferServerChangeCallback(int ime_result);
     void AfterHttpPortChangeCallback(int ime_result);
     void AfterMinBgDlSizeChangeCallback(int ime_result);
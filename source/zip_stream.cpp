@@ -0,0 +1,546 @@
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "config.h"
+#include "fs.h"
+#include "util.h"
+#include "zip_stream.h"
+
+#define ZIP_LOCAL_HEADER_SIG 0x04034b50
+#define ZIP_DESCRIPTOR_SIG 0x08074b50
+#define ZIP_CENTRAL_HEADER_SIG 0x02014b50
+#define ZIP64_END_SIG 0x06064b50
+#define ZIP64_LOCATOR_SIG 0x07064b50
+#define ZIP_END_SIG 0x06054b50
+#define ZIP_FLAG_DESCRIPTOR 0x0008
+#define ZIP_FLAG_UTF8 0x0800
+
+ZipStream::ZipStream(bool deflate)
+{
+    this->deflate = deflate;
+    this->fd = NULL;
+    this->strm_init = false;
+    Reset();
+}
+
+ZipStream::~ZipStream()
+{
+    if (this->fd != NULL)
+        FS::Close(this->fd);
+    if (this->strm_init)
+        deflateEnd(&this->strm);
+}
+
+/*
+ * Rewinds to the first byte. CRCs computed on an earlier pass are kept, so a
+ * restart only has to read the file data it actually sends again.
+ */
+void ZipStream::Reset()
+{
+    if (this->fd != NULL)
+        FS::Close(this->fd);
+    if (this->strm_init)
+        deflateEnd(&this->strm);
+    this->fd = NULL;
+    this->strm_init = false;
+    this->pending.clear();
+    this->pending_pos = 0;
+    this->position = 0;
+    this->current = 0;
+    this->phase = PHASE_HEADER;
+    this->remaining = 0;
+    this->input_read = 0;
+    this->failed = false;
+}
+
+int ZipStream::AddFile(const std::string &path, int filename_start, bool is_dir)
+{
+    struct stat file_stat;
+    memset(&file_stat, 0, sizeof(file_stat));
+    if (stat(path.c_str(), &file_stat) < 0)
+        return 0;
+
+    ZipStreamEntry entry;
+    entry.path = path;
+    entry.name = path.substr(filename_start);
+    if (is_dir && (entry.name.empty() || entry.name[entry.name.length() - 1] != '/'))
+        entry.name = entry.name + "/";
+    entry.is_dir = is_dir;
+    entry.size = is_dir ? 0 : file_stat.st_size;
+    entry.method = 0;
+    if (this->deflate && !is_dir)
+    {
+        std::string filename = Util::ToLower(path);
+        size_t dot_pos = filename.find_last_of(".");
+        if (dot_pos == std::string::npos || compressed_file_extensions.find(filename.substr(dot_pos)) == compressed_file_extensions.end())
+            entry.method = Z_DEFLATED;
+    }
+    // Decided before the entry is written, deflated entries get some headroom since
+    // their compressed size isn't known yet
+    entry.zip64 = entry.size >= (entry.method == Z_DEFLATED ? 0xF0000000 : 0xFFFFFFFF);
+
+    time_t mtime = file_stat.st_mtim.tv_sec;
+    struct tm tm;
+    localtime_r(&mtime, &tm);
+    entry.dos_time = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+    entry.dos_date = ((MAX(tm.tm_year, 80) - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+    entry.crc = 0;
+    entry.crc_done = is_dir;
+    entry.compressed = 0;
+    entry.offset = 0;
+
+    this->entries.push_back(entry);
+    return 1;
+}
+
+int ZipStream::AddPath(const std::string &path, int filename_start)
+{
+    DIR *dfd = opendir(path.c_str());
+    if (dfd != NULL)
+    {
+        int ret = AddFile(path, filename_start, true);
+        if (ret <= 0)
+        {
+            closedir(dfd);
+            return ret;
+        }
+
+        struct dirent *dirent;
+        do
+        {
+            dirent = readdir(dfd);
+            if (dirent != NULL && strcmp(dirent->d_name, ".") != 0 && strcmp(dirent->d_name, "..") != 0)
+            {
+                std::string new_path = path + (FS::hasEndSlash(path.c_str()) ? "" : "/") + dirent->d_name;
+
+                if (dirent->d_type & DT_DIR)
+                    ret = AddPath(new_path, filename_start);
+                else
+                    ret = AddFile(new_path, filename_start, false);
+
+                if (ret <= 0)
+                {
+                    closedir(dfd);
+                    return ret;
+                }
+            }
+        } while (dirent != NULL);
+
+        closedir(dfd);
+        return 1;
+    }
+
+    return AddFile(path, filename_start, false);
+}
+
+/*
+ * Total length of the archive. Only known up front when nothing is deflated,
+ * returns 0 otherwise.
+ */
+uint64_t ZipStream::Size()
+{
+    if (this->deflate)
+        return 0;
+
+    uint64_t total = 0;
+    uint64_t central = 0;
+    for (int i = 0; i < this->entries.size(); i++)
+    {
+        ZipStreamEntry &entry = this->entries[i];
+        bool zip64 = entry.zip64;
+
+        int central_extra = (zip64 ? 16 : 0) + (total >= 0xFFFFFFFF ? 8 : 0);
+        central += 46 + entry.name.length() + (central_extra > 0 ? central_extra + 4 : 0);
+
+        total += 30 + entry.name.length() + (zip64 ? 20 : 0);
+        if (!entry.is_dir)
+            total += entry.size + (zip64 ? 24 : 16);
+    }
+
+    bool zip64_end = this->entries.size() >= 0xFFFF || total >= 0xFFFFFFFF || central >= 0xFFFFFFFF;
+    return total + central + (zip64_end ? 56 + 20 : 0) + 22;
+}
+
+uint64_t ZipStream::Position()
+{
+    return this->position;
+}
+
+/*
+ * Bytes of file data in the archive, and how much of it has been read so far.
+ * In deflate mode these are what progress can be shown against.
+ */
+uint64_t ZipStream::InputSize()
+{
+    uint64_t total = 0;
+    for (int i = 0; i < this->entries.size(); i++)
+    {
+        total += this->entries[i].size;
+    }
+    return total;
+}
+
+uint64_t ZipStream::InputPosition()
+{
+    return this->input_read;
+}
+
+bool ZipStream::Failed()
+{
+    return this->failed;
+}
+
+void ZipStream::Put16(uint16_t v)
+{
+    this->pending.push_back(v & 0xFF);
+    this->pending.push_back((v >> 8) & 0xFF);
+}
+
+void ZipStream::Put32(uint32_t v)
+{
+    Put16(v & 0xFFFF);
+    Put16((v >> 16) & 0xFFFF);
+}
+
+void ZipStream::Put64(uint64_t v)
+{
+    Put32(v & 0xFFFFFFFF);
+    Put32(v >> 32);
+}
+
+void ZipStream::PutLocalHeader(ZipStreamEntry &entry)
+{
+    bool zip64 = entry.zip64;
+
+    Put32(ZIP_LOCAL_HEADER_SIG);
+    Put16(zip64 ? 45 : 20);
+    Put16(ZIP_FLAG_UTF8 | (entry.is_dir ? 0 : ZIP_FLAG_DESCRIPTOR));
+    Put16(entry.method);
+    Put16(entry.dos_time);
+    Put16(entry.dos_date);
+    // crc and sizes follow the data in the descriptor
+    Put32(0);
+    Put32(zip64 ? 0xFFFFFFFF : 0);
+    Put32(zip64 ? 0xFFFFFFFF : 0);
+    Put16(entry.name.length());
+    Put16(zip64 ? 20 : 0);
+    this->pending.insert(this->pending.end(), entry.name.begin(), entry.name.end());
+    if (zip64)
+    {
+        Put16(0x0001);
+        Put16(16);
+        Put64(0);
+        Put64(0);
+    }
+}
+
+void ZipStream::PutDescriptor(const ZipStreamEntry &entry)
+{
+    Put32(ZIP_DESCRIPTOR_SIG);
+    Put32(entry.crc);
+    if (entry.zip64)
+    {
+        Put64(entry.compressed);
+        Put64(entry.size);
+    }
+    else
+    {
+        Put32(entry.compressed);
+        Put32(entry.size);
+    }
+}
+
+void ZipStream::PutCentral()
+{
+    uint64_t central_offset = this->position;
+    for (int i = 0; i < this->entries.size(); i++)
+    {
+        ZipStreamEntry &entry = this->entries[i];
+        bool zip64 = entry.zip64;
+        bool zip64_offset = entry.offset >= 0xFFFFFFFF;
+        int extra = (zip64 ? 16 : 0) + (zip64_offset ? 8 : 0);
+
+        Put32(ZIP_CENTRAL_HEADER_SIG);
+        Put16(45);
+        Put16(zip64 ? 45 : 20);
+        Put16(ZIP_FLAG_UTF8 | (entry.is_dir ? 0 : ZIP_FLAG_DESCRIPTOR));
+        Put16(entry.method);
+        Put16(entry.dos_time);
+        Put16(entry.dos_date);
+        Put32(entry.crc);
+        Put32(zip64 ? 0xFFFFFFFF : entry.compressed);
+        Put32(zip64 ? 0xFFFFFFFF : entry.size);
+        Put16(entry.name.length());
+        Put16(extra > 0 ? extra + 4 : 0);
+        Put16(0);
+        Put16(0);
+        Put16(0);
+        Put32(entry.is_dir ? 0x10 : 0);
+        Put32(zip64_offset ? 0xFFFFFFFF : entry.offset);
+        this->pending.insert(this->pending.end(), entry.name.begin(), entry.name.end());
+        if (extra > 0)
+        {
+            Put16(0x0001);
+            Put16(extra);
+            if (zip64)
+            {
+                Put64(entry.size);
+                Put64(entry.compressed);
+            }
+            if (zip64_offset)
+                Put64(entry.offset);
+        }
+    }
+
+    uint64_t central_size = this->pending.size();
+    uint64_t count = this->entries.size();
+    if (count >= 0xFFFF || central_offset >= 0xFFFFFFFF || central_size >= 0xFFFFFFFF)
+    {
+        uint64_t end_offset = central_offset + central_size;
+        Put32(ZIP64_END_SIG);
+        Put64(44);
+        Put16(45);
+        Put16(45);
+        Put32(0);
+        Put32(0);
+        Put64(count);
+        Put64(count);
+        Put64(central_size);
+        Put64(central_offset);
+
+        Put32(ZIP64_LOCATOR_SIG);
+        Put32(0);
+        Put64(end_offset);
+        Put32(1);
+    }
+
+    Put32(ZIP_END_SIG);
+    Put16(0);
+    Put16(0);
+    Put16(MIN(count, 0xFFFF));
+    Put16(MIN(count, 0xFFFF));
+    Put32(MIN(central_size, 0xFFFFFFFF));
+    Put32(MIN(central_offset, 0xFFFFFFFF));
+    Put16(0);
+}
+
+void ZipStream::FinishEntry()
+{
+    ZipStreamEntry &entry = this->entries[this->current];
+    if (this->fd != NULL)
+        FS::Close(this->fd);
+    this->fd = NULL;
+    if (this->strm_init)
+        deflateEnd(&this->strm);
+    this->strm_init = false;
+    entry.crc_done = true;
+    this->phase = PHASE_DESCRIPTOR;
+}
+
+/*
+ * Produces the next piece of file data. STORED entries are padded with zeros if
+ * the file got shorter since it was listed, the sizes in the headers were already
+ * promised. Deflated entries just end early and record what was read.
+ */
+void ZipStream::ReadData()
+{
+    ZipStreamEntry &entry = this->entries[this->current];
+    this->in_buf.resize(ZIP_STREAM_CHUNK_SIZE);
+
+    if (entry.method == 0)
+    {
+        size_t len = MIN(this->remaining, ZIP_STREAM_CHUNK_SIZE);
+        int read = 0;
+        if (this->fd != NULL)
+            read = FS::Read(this->fd, this->in_buf.data(), len);
+        if (read < 0)
+            read = 0;
+        if (read < len)
+        {
+            memset(this->in_buf.data() + read, 0, len - read);
+            this->failed = true;
+        }
+
+        if (!entry.crc_done)
+            entry.crc = crc32(entry.crc, this->in_buf.data(), len);
+        this->pending.insert(this->pending.end(), this->in_buf.begin(), this->in_buf.begin() + len);
+        this->remaining -= len;
+        this->input_read += len;
+        entry.compressed += len;
+
+        if (this->remaining == 0)
+            FinishEntry();
+        return;
+    }
+
+    // Keep feeding the deflater until it has something to hand out
+    std::vector<uint8_t> out(ZIP_STREAM_CHUNK_SIZE);
+    while (this->pending.empty())
+    {
+        int flush = Z_NO_FLUSH;
+        if (this->strm.avail_in == 0)
+        {
+            size_t len = MIN(this->remaining, ZIP_STREAM_CHUNK_SIZE);
+            int read = 0;
+            if (len > 0 && this->fd != NULL)
+                read = FS::Read(this->fd, this->in_buf.data(), len);
+            if (read <= 0)
+            {
+                read = 0;
+                if (this->remaining > 0)
+                    this->failed = true;
+                entry.size -= this->remaining;
+                this->remaining = 0;
+            }
+            entry.crc = crc32(entry.crc, this->in_buf.data(), read);
+            this->remaining -= read;
+            this->input_read += read;
+            this->strm.next_in = this->in_buf.data();
+            this->strm.avail_in = read;
+        }
+        if (this->remaining == 0)
+            flush = Z_FINISH;
+
+        this->strm.next_out = out.data();
+        this->strm.avail_out = out.size();
+        int ret = ::deflate(&this->strm, flush);
+        size_t have = out.size() - this->strm.avail_out;
+        this->pending.insert(this->pending.end(), out.begin(), out.begin() + have);
+        entry.compressed += have;
+
+        if (ret == Z_STREAM_END || ret == Z_STREAM_ERROR)
+        {
+            FinishEntry();
+            break;
+        }
+    }
+}
+
+void ZipStream::Next()
+{
+    this->pending.clear();
+    this->pending_pos = 0;
+
+    switch (this->phase)
+    {
+    case PHASE_HEADER:
+    {
+        if (this->current >= this->entries.size())
+        {
+            PutCentral();
+            this->phase = PHASE_CENTRAL;
+            break;
+        }
+
+        ZipStreamEntry &entry = this->entries[this->current];
+        entry.offset = this->position;
+        PutLocalHeader(entry);
+        if (entry.is_dir)
+        {
+            this->current++;
+            break;
+        }
+
+        this->fd = FS::OpenRead(entry.path);
+        if (this->fd == NULL && entry.size > 0)
+            this->failed = true;
+        this->remaining = entry.size;
+        if (!entry.crc_done)
+            entry.crc = crc32(0L, Z_NULL, 0);
+        entry.compressed = 0;
+        if (entry.method == Z_DEFLATED)
+        {
+            memset(&this->strm, 0, sizeof(this->strm));
+            this->strm_init = (deflateInit2(&this->strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+        }
+        this->phase = PHASE_DATA;
+        break;
+    }
+    case PHASE_DATA:
+        ReadData();
+        break;
+    case PHASE_DESCRIPTOR:
+        PutDescriptor(this->entries[this->current]);
+        this->current++;
+        this->phase = PHASE_HEADER;
+        break;
+    case PHASE_CENTRAL:
+    case PHASE_DONE:
+        this->phase = PHASE_DONE;
+        break;
+    }
+}
+
+int64_t ZipStream::Read(uint8_t *buf, size_t len)
+{
+    size_t total = 0;
+    while (total < len)
+    {
+        size_t avail = this->pending.size() - this->pending_pos;
+        if (avail > 0)
+        {
+            size_t n = MIN(avail, len - total);
+            memcpy(buf + total, this->pending.data() + this->pending_pos, n);
+            this->pending_pos += n;
+            this->position += n;
+            total += n;
+            continue;
+        }
+
+        if (this->phase == PHASE_DONE)
+            break;
+        Next();
+    }
+
+    return total;
+}
+
+/*
+ * Moves to offset by regenerating the archive from the start if needed. File data
+ * whose crc is already known is skipped with a seek instead of being read.
+ */
+int ZipStream::Seek(uint64_t offset)
+{
+    if (offset == this->position)
+        return 1;
+    if (this->deflate)
+        return 0;
+    if (offset < this->position)
+        Reset();
+
+    while (this->position < offset)
+    {
+        size_t avail = this->pending.size() - this->pending_pos;
+        if (avail > 0)
+        {
+            size_t n = MIN(avail, offset - this->position);
+            this->pending_pos += n;
+            this->position += n;
+            continue;
+        }
+
+        if (this->phase == PHASE_DONE)
+            return 0;
+
+        ZipStreamEntry &entry = this->entries[MIN(this->current, (int)this->entries.size() - 1)];
+        if (this->phase == PHASE_DATA && entry.crc_done)
+        {
+            uint64_t n = MIN(this->remaining, offset - this->position);
+            if (this->fd != NULL)
+                FS::Seek(this->fd, entry.size - this->remaining + n);
+            this->remaining -= n;
+            this->input_read += n;
+            this->position += n;
+            entry.compressed += n;
+            if (this->remaining == 0)
+                FinishEntry();
+            continue;
+        }
+
+        Next();
+    }
+
+    return 1;
+}
@@ -0,0 +1,89 @@
+#ifndef EZ_ZIP_STREAM_H
+#define EZ_ZIP_STREAM_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#define ZIP_STREAM_CHUNK_SIZE 1048576
+
+struct ZipStreamEntry
+{
+    std::string path;
+    std::string name;
+    uint64_t size;
+    bool is_dir;
+    int method;
+    bool zip64;
+    uint16_t dos_time;
+    uint16_t dos_date;
+    uint32_t crc;
+    bool crc_done;
+    uint64_t compressed;
+    uint64_t offset;
+};
+
+/*
+ * Produces a zip archive of local files as a byte stream, without a temp file.
+ * Entries are written with data descriptors so nothing has to be patched after the
+ * file data, and zip64 records are added where sizes or offsets need them.
+ * In STORED mode the layout only depends on the names and sizes, so Size() is known
+ * before the first byte is produced and Seek() can restart at any offset; in deflate
+ * mode the length is only known at the end and the stream must be read in order.
+ */
+class ZipStream
+{
+public:
+    ZipStream(bool deflate);
+    ~ZipStream();
+    int AddPath(const std::string &path, int filename_start);
+    uint64_t Size();
+    int Seek(uint64_t offset);
+    int64_t Read(uint8_t *buf, size_t len);
+    uint64_t Position();
+    uint64_t InputSize();
+    uint64_t InputPosition();
+    // A source file could not be opened or read in full, its entry is short or zero filled
+    bool Failed();
+
+private:
+    enum Phase
+    {
+        PHASE_HEADER,
+        PHASE_DATA,
+        PHASE_DESCRIPTOR,
+        PHASE_CENTRAL,
+        PHASE_DONE
+    };
+
+    bool deflate;
+    std::vector<ZipStreamEntry> entries;
+    std::vector<uint8_t> pending;
+    size_t pending_pos;
+    uint64_t position;
+    int current;
+    Phase phase;
+    FILE *fd;
+    uint64_t remaining;
+    uint64_t input_read;
+    bool failed;
+    z_stream strm;
+    bool strm_init;
+    std::vector<uint8_t> in_buf;
+
+    void Reset();
+    void Next();
+    void ReadData();
+    void FinishEntry();
+    int AddFile(const std::string &path, int filename_start, bool is_dir);
+    void PutLocalHeader(ZipStreamEntry &entry);
+    void PutDescriptor(const ZipStreamEntry &entry);
+    void PutCentral();
+    void Put16(uint16_t v);
+    void Put32(uint32_t v);
+    void Put64(uint64_t v);
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <pthread.h>
+#include "config.h"
+#include "fs.h"
+#include "util.h"
+#include "windows.h"
+#include "zip_upload.h"
+
+ZipUpload::ZipUpload(RemoteClient *client) : stream(true)
+{
+    this->client = client;
+    this->read_done = false;
+    this->write_failed = false;
+}
+
+ZipUpload::~ZipUpload()
+{
+}
+
+int ZipUpload::AddPath(const std::string &path, int filename_start)
+{
+    return this->stream.AddPath(path, filename_start);
+}
+
+int ZipUpload::Upload(const std::string &dest)
+{
+    bytes_to_download = this->stream.InputSize();
+    bytes_transfered = 0;
+    prev_tick = Util::GetTick();
+
+    void *out = this->client->OpenWrite(dest);
+    int ret = (out != nullptr) ? StreamUpload(out) : StagedUpload(dest);
+
+    // A cut short archive is of no use to anyone
+    if (!ret && this->client->FileExists(dest))
+        this->client->Delete(dest);
+    return ret;
+}
+
+void *ZipUpload::ProducerThread(void *argp)
+{
+    ZipUpload *upload = (ZipUpload *)argp;
+    upload->Produce();
+    return NULL;
+}
+
+void ZipUpload::Produce()
+{
+    while (true)
+    {
+        std::vector<uint8_t> chunk(ZIP_UPLOAD_CHUNK_SIZE);
+        int64_t len = this->stream.Read(chunk.data(), chunk.size());
+        // An unreadable source would leave a member short, the archive is given up
+        if (len <= 0 || stop_activity || this->stream.Failed())
+            break;
+        chunk.resize(len);
+        bytes_transfered = this->stream.InputPosition();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (this->chunks.size() >= ZIP_UPLOAD_MAX_PENDING && !this->write_failed)
+        {
+            this->chunks_cv.wait(lock);
+        }
+        if (this->write_failed)
+            break;
+        this->chunks.push_back(std::move(chunk));
+        this->chunks_cv.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    this->read_done = true;
+    this->chunks_cv.notify_all();
+}
+
+int ZipUpload::StreamUpload(void *out)
+{
+    this->read_done = false;
+    this->write_failed = false;
+    this->chunks.clear();
+
+    pthread_t thid;
+    if (pthread_create(&thid, NULL, ProducerThread, this) != 0)
+    {
+        this->client->CloseWrite(out);
+        return 0;
+    }
+
+    bool success = true;
+    while (true)
+    {
+        std::vector<uint8_t> chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (this->chunks.empty() && !this->read_done)
+            {
+                this->chunks_cv.wait(lock);
+            }
+
+            if (this->chunks.empty())
+                break;
+
+            chunk.swap(this->chunks.front());
+            this->chunks.pop_front();
+        }
+        this->chunks_cv.notify_all();
+
+        if (stop_activity || !this->client->Write(out, chunk.data(), chunk.size()))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            this->write_failed = true;
+            this->chunks_cv.notify_all();
+            success = false;
+            break;
+        }
+    }
+
+    pthread_join(thid, NULL);
+    if (!this->client->CloseWrite(out) || this->stream.Failed())
+        success = false;
+
+    return success && !stop_activity;
+}
+
+int ZipUpload::StagedUpload(const std::string &dest)
+{
+    std::string temp_file = std::string(temp_folder) + "/" + std::to_string(Util::GetTick()) + ".zip";
+    FILE *out = FS::Create(temp_file);
+    if (out == NULL)
+        return 0;
+
+    bool success = true;
+    std::vector<uint8_t> chunk(ZIP_UPLOAD_CHUNK_SIZE);
+    while (!stop_activity)
+    {
+        int64_t len = this->stream.Read(chunk.data(), chunk.size());
+        if (len <= 0)
+            break;
+        bytes_transfered = this->stream.InputPosition();
+        if (this->stream.Failed() || FS::Write(out, chunk.data(), len) != len)
+        {
+            success = false;
+            break;
+        }
+    }
+    FS::Close(out);
+
+    if (success && !stop_activity)
+        success = this->client->Put(temp_file, dest) > 0;
+    FS::Rm(temp_file);
+
+    return success && !stop_activity;
+}
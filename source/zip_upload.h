@@ -0,0 +1,47 @@
+#ifndef EZ_ZIP_UPLOAD_H
+#define EZ_ZIP_UPLOAD_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+#include "clients/remote_client.h"
+#include "zip_stream.h"
+
+#define ZIP_UPLOAD_CHUNK_SIZE 1048576
+#define ZIP_UPLOAD_MAX_PENDING 8
+
+/*
+ * Uploads local files to a remote site as one zip, compressed on the fly.
+ * A thread produces the archive with ZipStream into a bounded queue of chunks and
+ * the caller's thread writes them out with OpenWrite/Write, so deflating and the
+ * network run at the same time and the archive is never staged on the local disk.
+ * Sessions without streaming writes get the archive in a temp file that is then
+ * uploaded with Put, which still saves the separate compress step.
+ */
+class ZipUpload
+{
+public:
+    ZipUpload(RemoteClient *client);
+    ~ZipUpload();
+    int AddPath(const std::string &path, int filename_start);
+    int Upload(const std::string &dest);
+
+private:
+    RemoteClient *client;
+    ZipStream stream;
+    std::deque<std::vector<uint8_t>> chunks;
+    bool read_done;
+    bool write_failed;
+    std::mutex mutex_;
+    std::condition_variable chunks_cv;
+
+    static void *ProducerThread(void *argp);
+    void Produce();
+    int StreamUpload(void *out);
+    int StagedUpload(const std::string &dest);
+};
+
+#endif
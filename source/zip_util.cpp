@@ -20,6 +20,8 @@
 #include "windows.h"
 #include "util.h"
 #include "zip_util.h"
+#include "extract_pipeline.h"
+#include "extract_checkpoint.h"
 
 namespace ZipUtil
 {
@@ -314,53 +316,7 @@ namespace ZipUtil
         return 1;
     }
 
-    /*
-     * Extract a regular file.
-     */
-    static void extract_file(struct archive *a, struct archive_entry *e, const std::string &path)
-    {
-        struct stat sb;
-        int fd;
-        const char *linkname;
-
-        /* look for existing file of same name */
-    recheck:
-        if (lstat(path.c_str(), &sb) == 0)
-        {
-            (void)unlink(path.c_str());
-        }
-
-        /* process symlinks */
-        linkname = archive_entry_symlink(e);
-        if (linkname != NULL)
-        {
-            if (symlink(linkname, path.c_str()) != 0)
-            {
-                sprintf(status_message, "error symlink('%s')", path.c_str());
-                return;
-            }
-
-            /* set access and modification time */
-            return;
-        }
-
-        bytes_to_download = archive_entry_size(e);
-        if ((fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0777)) < 0)
-        {
-            sprintf(status_message, "error open('%s')", path.c_str());
-            return;
-        }
-
-        extract2fd(a, path, fd);
-
-        /* set access and modification time */
-        if (close(fd) != 0)
-        {
-            return;
-        }
-    }
-
-    static void extract(struct archive *a, struct archive_entry *e, const std::string &base_dir)
+    static int extract(struct archive *a, struct archive_entry *e, const std::string &base_dir, ExtractPipeline *pipeline)
     {
         char *pathname, *realpathname;
         mode_t filetype;
@@ -369,7 +325,7 @@ namespace ZipUtil
         if ((pathname = pathdup(original_name)) == NULL)
         {
             archive_read_data_skip(a);
-            return;
+            return 1;
         }
         filetype = archive_entry_filetype(e);
 
@@ -380,7 +336,7 @@ namespace ZipUtil
         {
             archive_read_data_skip(a);
             free(pathname);
-            return;
+            return 1;
         }
 
         /* I don't think this can happen in a zipfile.. */
@@ -388,25 +344,25 @@ namespace ZipUtil
         {
             archive_read_data_skip(a);
             free(pathname);
-            return;
+            return 1;
         }
 
         realpathname = pathcat(base_dir.c_str(), pathname);
 
+        int ret = 1;
         if (S_ISDIR(filetype) || original_name[strlen(original_name)-1] == '/')
             extract_dir(a, e, realpathname);
         else
         {
             snprintf(activity_message, 255, "%s: %s", lang_strings[STR_EXTRACTING], pathname);
-            
-            /* ensure that parent directory exists */
-            FS::MkDirs(realpathname, true);
 
-            extract_file(a, e, realpathname);
+            /* parent directories are created by the writer */
+            ret = pipeline->AddEntry(a, e, original_name, realpathname);
         }
 
         free(realpathname);
         free(pathname);
+        return ret;
     }
 
     /*
@@ -436,12 +392,11 @@ namespace ZipUtil
 
     static RemoteArchiveData *OpenRemoteArchive(const std::string &file, RemoteClient *client)
     {
-        RemoteArchiveData *data;
-
-        data = (RemoteArchiveData *)malloc(sizeof(RemoteArchiveData));
-        memset(data, 0, sizeof(RemoteArchiveData));
+        RemoteArchiveData *data = new RemoteArchiveData();
 
+        data->fp = nullptr;
         data->offset = 0;
+        data->size = 0;
         client->Size(file, &data->size);
         data->client = client;
         data->path = file;
@@ -449,33 +404,20 @@ namespace ZipUtil
         {
             data->fp = client->Open(file, O_RDONLY);
         }
+        data->prefetch = new ArchivePrefetch(client, file, data->fp, data->size);
         return data;
     }
 
     static ssize_t ReadRemoteArchive(struct archive *a, void *client_data, const void **buff)
     {
-        ssize_t to_read;
-        int ret;
-        RemoteArchiveData *data;
-
-        data = (RemoteArchiveData *)client_data;
-        *buff = data->buf;
-
-        to_read = data->size - data->offset;
-        if (to_read == 0)
-            return 0;
-
-        to_read = MIN(to_read, ARCHIVE_TRANSFER_SIZE);
-        if (data->client->SupportedActions() & REMOTE_ACTION_RAW_READ)
-            ret = data->client->GetRange((data->fp), data->buf, to_read, data->offset);
-        else
-            ret = data->client->GetRange(data->path, data->buf, to_read, data->offset);
+        RemoteArchiveData *data = (RemoteArchiveData *)client_data;
 
-        if (ret == 0)
+        ssize_t read = data->prefetch->Read(data->offset, buff);
+        if (read < 0)
             return -1;
-        data->offset = data->offset + to_read;
+        data->offset = data->offset + read;
 
-        return to_read;
+        return read;
     }
 
     static int CloseRemoteArchive(struct archive *a, void *client_data)
@@ -483,9 +425,11 @@ namespace ZipUtil
         if (client_data != nullptr)
         {
             RemoteArchiveData *data = (RemoteArchiveData *)client_data;
+            // Stop the prefetch thread before the handle it reads from goes away
+            delete data->prefetch;
             if (data->client->SupportedActions() & REMOTE_ACTION_RAW_READ)
                 data->client->Close(data->fp);
-            free(client_data);
+            delete data;
         }
         return 0;
     }
@@ -493,22 +437,22 @@ namespace ZipUtil
     int64_t SeekRemoteArchive(struct archive *, void *client_data, int64_t offset, int whence)
     {
         RemoteArchiveData *data = (RemoteArchiveData *)client_data;
+        int64_t new_offset;
 
         if (whence == SEEK_SET)
-        {
-            data->offset = offset;
-        }
+            new_offset = offset;
         else if (whence == SEEK_CUR)
-        {
-            data->offset = data->offset + offset - 1;
-        }
+            new_offset = data->offset + offset;
         else if (whence == SEEK_END)
-        {
-            data->offset = data->size - 1;
-        }
+            new_offset = data->size + offset;
         else
             return ARCHIVE_FATAL;
 
+        if (new_offset < 0)
+            return ARCHIVE_FATAL;
+
+        // Only moves the read position, data already fetched stays with the prefetcher
+        data->offset = new_offset;
         return data->offset;
     }
 
@@ -516,11 +460,54 @@ namespace ZipUtil
     {
         RemoteArchiveData *data = (RemoteArchiveData *)client_data;
 
-        data->offset = data->offset + request - 1;
+        if (request < 0)
+            return 0;
+        if (data->offset + request > data->size)
+            request = data->size > data->offset ? data->size - data->offset : 0;
+        data->offset = data->offset + request;
 
         return request;
     }
 
+    /*
+     * Hands the crc of every entry in the central directory of a zip to the
+     * checkpoint, so records of a different archive with the same name and size
+     * aren't trusted.
+     */
+    static void LoadZipCrcs(const DirEntry &file, RemoteClient *client, ExtractCheckpoint *checkpoint)
+    {
+        if (!Util::EndsWith(Util::ToLower(file.name), ".zip"))
+            return;
+
+        if (client != nullptr)
+        {
+            std::shared_ptr<ArchiveIndex> index = ArchiveIndex::Open(remote_settings->site_name, client, file);
+            if (index == nullptr)
+                return;
+            std::vector<ArchiveIndexEntry> entries = index->ListFiles("");
+            for (std::vector<ArchiveIndexEntry>::iterator it = entries.begin(); it != entries.end(); ++it)
+            {
+                checkpoint->SetExpectedCrc(it->name, it->crc);
+            }
+            return;
+        }
+
+        unzFile zf = unzOpen64(file.path);
+        if (zf == NULL)
+            return;
+
+        char name[1024];
+        unz_file_info64 info;
+        int ret = unzGoToFirstFile(zf);
+        while (ret == UNZ_OK)
+        {
+            if (unzGetCurrentFileInfo64(zf, &info, name, sizeof(name), NULL, 0, NULL, 0) == UNZ_OK)
+                checkpoint->SetExpectedCrc(name, info.crc);
+            ret = unzGoToNextFile(zf);
+        }
+        unzClose(zf);
+    }
+
     /*
      * Main loop: open the zipfile, iterate over its contents and decide what
      * to do with each entry.
@@ -574,6 +561,10 @@ namespace ZipUtil
         }
 
         FS::MkDirs(basepath.c_str());
+        ExtractCheckpoint checkpoint(file.path, file.file_size, basepath);
+        if (checkpoint.HasRecords())
+            LoadZipCrcs(file, client, &checkpoint);
+        ExtractPipeline pipeline(basepath, &checkpoint);
         for (;;)
         {
             if (stop_activity)
@@ -584,6 +575,7 @@ namespace ZipUtil
             if (ret < ARCHIVE_OK)
             {
                 sprintf(status_message, "%s", "archive_read_next_header failed");
+                pipeline.Finish();
                 archive_read_free(a);
                 return 0;
             }
@@ -591,12 +583,16 @@ namespace ZipUtil
             if (ret == ARCHIVE_EOF)
                 break;
 
-            extract(a, e, basepath);
+            if (!extract(a, e, basepath, &pipeline))
+                break;
         }
 
+        ret = pipeline.Finish();
         archive_read_free(a);
+        if (ret && !stop_activity)
+            checkpoint.Remove();
 
-        return 1;
+        return ret;
     }
 
     ArchiveEntry *GetPackageEntry(const std::string &zip_file, RemoteClient *client)
@@ -791,4 +787,114 @@ namespace ZipUtil
 
         return nullptr;
     }
+
+    /*
+     * Opens a remote archive for reading through the prefetching callbacks.
+     */
+    static struct archive *OpenRemoteReader(const std::string &file, RemoteClient *client)
+    {
+        struct archive *a;
+        if ((a = archive_read_new()) == NULL)
+            return nullptr;
+
+        archive_read_support_format_all(a);
+        archive_read_support_filter_all(a);
+        archive_read_set_passphrase_callback(a, NULL, &passphrase_callback);
+
+        RemoteArchiveData *client_data = OpenRemoteArchive(file, client);
+        if (archive_read_set_seek_callback(a, SeekRemoteArchive) < ARCHIVE_OK ||
+            archive_read_open2(a, client_data, NULL, ReadRemoteArchive, SkipRemoteArchive, CloseRemoteArchive) < ARCHIVE_OK)
+        {
+            archive_read_free(a);
+            return nullptr;
+        }
+
+        return a;
+    }
+
+    int ListArchive(const std::string &file, RemoteClient *client, std::vector<ArchiveIndexEntry> &entries)
+    {
+        struct archive *a = OpenRemoteReader(file, client);
+        if (a == nullptr)
+        {
+            sprintf(status_message, "%s", "archive_read_open failed");
+            return 0;
+        }
+
+        struct archive_entry *e;
+        int ret;
+        while ((ret = archive_read_next_header(a, &e)) == ARCHIVE_OK)
+        {
+            const char *pathname = archive_entry_pathname(e);
+            if (pathname == NULL)
+                continue;
+
+            ArchiveIndexEntry entry;
+            entry.name = pathname;
+            entry.is_dir = S_ISDIR(archive_entry_filetype(e)) || (entry.name.length() > 0 && entry.name[entry.name.length() - 1] == '/');
+            while (entry.name.length() > 0 && entry.name[entry.name.length() - 1] == '/')
+                entry.name.pop_back();
+            if (entry.name.empty())
+                continue;
+            entry.size = archive_entry_size(e);
+            entry.compressed = 0;
+            entry.header_offset = 0;
+            entry.crc = 0;
+            entry.method = 0;
+            entry.flags = 0;
+
+            time_t mtime = archive_entry_mtime(e);
+            struct tm tm;
+            localtime_r(&mtime, &tm);
+            memset(&entry.modified, 0, sizeof(DateTime));
+            entry.modified.year = tm.tm_year + 1900;
+            entry.modified.month = tm.tm_mon + 1;
+            entry.modified.day = tm.tm_mday;
+            entry.modified.hours = tm.tm_hour;
+            entry.modified.minutes = tm.tm_min;
+            entry.modified.seconds = tm.tm_sec;
+            entries.push_back(entry);
+        }
+
+        archive_read_free(a);
+        if (ret != ARCHIVE_EOF)
+        {
+            sprintf(status_message, "%s", "archive_read_next_header failed");
+            return 0;
+        }
+        return 1;
+    }
+
+    int ExtractEntry(const std::string &file, RemoteClient *client, const std::string &name, const std::string &dest)
+    {
+        struct archive *a = OpenRemoteReader(file, client);
+        if (a == nullptr)
+        {
+            sprintf(status_message, "%s", "archive_read_open failed");
+            return 0;
+        }
+
+        struct archive_entry *e;
+        int ret = 0;
+        while (!stop_activity && archive_read_next_header(a, &e) == ARCHIVE_OK)
+        {
+            const char *pathname = archive_entry_pathname(e);
+            if (pathname == NULL || name.compare(pathname) != 0)
+                continue;
+
+            bytes_to_download = archive_entry_size(e);
+            int fd = open(dest.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0777);
+            if (fd < 0)
+            {
+                sprintf(status_message, "error open('%s')", dest.c_str());
+                break;
+            }
+            ret = extract2fd(a, dest, fd);
+            close(fd);
+            break;
+        }
+
+        archive_read_free(a);
+        return ret;
+    }
 }
\ No newline at end of file
@@ -9,6 +9,8 @@
 #include <archive_entry.h>
 #include "common.h"
 #include "fs.h"
+#include "archive_prefetch.h"
+#include "archive_index.h"
 
 #define ARCHIVE_TRANSFER_SIZE 20971520
 
@@ -34,7 +36,7 @@ struct RemoteArchiveData
     std::string path;
     uint64_t size;
     uint64_t offset;
-    uint8_t buf[ARCHIVE_TRANSFER_SIZE];
+    ArchivePrefetch *prefetch;
     RemoteClient *client;
 };
 
@@ -49,9 +51,12 @@ struct ArchiveEntry
 
 namespace ZipUtil
 {
+    void convertToZipTime(time_t time, tm_zip *tmzip);
     int ZipAddPath(zipFile zf, const std::string &path, int filename_start, int level);
     int Extract(const DirEntry &file, const std::string &dir, RemoteClient *client = nullptr);
     ArchiveEntry *GetPackageEntry(const std::string &zip_file, RemoteClient *client = nullptr);
     ArchiveEntry *GetNextPackageEntry(ArchiveEntry *archive_entry);
+    int ListArchive(const std::string &file, RemoteClient *client, std::vector<ArchiveIndexEntry> &entries);
+    int ExtractEntry(const std::string &file, RemoteClient *client, const std::string &name, const std::string &dest);
 }
 #endif
\ No newline at end of file